@@ -7,11 +7,44 @@
 #include <syslinux/loadfile.h>
 #include <syslinux/linux.h>
 #include <syslinux/pxe.h>
+#include <syslinux/config.h>
 #include "core.h"
 
 const char *globaldefault = NULL;
 const char *append = NULL;
 
+/*
+ * Over the network, fetch the kernel and its initrds all at once
+ * rather than one after the other.
+ */
+static void prefetch_files(const char *kernel_name, const char *cmdline)
+{
+	const union syslinux_derivative_info *sdi;
+	const char *initrd;
+	char *names, *q;
+
+	sdi = syslinux_derivative_info();
+	if (sdi->c.filesystem != SYSLINUX_FS_PXELINUX)
+		return;
+
+	initrd = strstr(cmdline, "initrd=");
+	if (!initrd)
+		return;		/* Nothing to fetch alongside the kernel */
+
+	names = malloc(strlen(kernel_name) + strlen(initrd) + 2);
+	if (!names)
+		return;
+
+	q = stpcpy(names, kernel_name);
+	*q++ = ' ';
+	for (initrd += 7; *initrd && *initrd != ' '; initrd++)
+		*q++ = (*initrd == ',') ? ' ' : *initrd;
+	*q = '\0';
+
+	pxe_prefetch(names);
+	free(names);
+}
+
 /* Will be called from readconfig.c */
 int new_linux_kernel(char *okernel, char *ocmdline)
 {
@@ -51,6 +84,8 @@ int new_linux_kernel(char *okernel, char *ocmdline)
 	if (strstr(cmdline, "quiet"))
 		opt_quiet = true;
 
+	prefetch_files(kernel_name, cmdline);
+
 	if (!opt_quiet)
 		printf("Loading %s... ", kernel_name);
 
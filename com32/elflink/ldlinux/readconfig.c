@@ -30,6 +30,8 @@
 #include <core.h>
 #include <fs.h>
 #include <syslinux/pxe_api.h>
+#include <syslinux/trace.h>
+#include <sys/module.h>
 
 #include "menu.h"
 #include "config.h"
@@ -873,6 +875,40 @@ put:
     refstr_put(file);
 }
 
+/* Only the BIOS core has these */
+extern unsigned int __weak bios_disk_set_maxtransfer(unsigned int);
+extern unsigned int __weak bios_disk_probe_maxtransfer(void);
+
+/*
+ * MAXTRANSFER sectors|PROBE.  A probed size is kept in the ADV, so
+ * only the first boot pays for the probe.
+ */
+static void do_maxtransfer(char *p)
+{
+    const void *adv;
+    uint16_t sectors;
+    size_t size;
+
+    if (!bios_disk_set_maxtransfer)
+	return;
+
+    if (!looking_at(p, "probe")) {
+	bios_disk_set_maxtransfer(strtoul(p, NULL, 0));
+	return;
+    }
+
+    adv = syslinux_getadv(ADV_MAXTRANSFER, &size);
+    if (adv && size == sizeof sectors) {
+	memcpy(&sectors, adv, sizeof sectors);
+	bios_disk_set_maxtransfer(sectors);
+	return;
+    }
+
+    sectors = bios_disk_probe_maxtransfer();
+    if (sectors && !syslinux_setadv(ADV_MAXTRANSFER, sizeof sectors, &sectors))
+	syslinux_adv_write();
+}
+
 static void parse_config_file(FILE * f)
 {
     char line[MAX_LINE], *p, *ep, ch;
@@ -1419,6 +1455,27 @@ static void parse_config_file(FILE * f)
 	} else if (looking_at(p, "path")) {
 		if (parse_path(skipspace(p + 4)))
 			printf("Failed to parse PATH\n");
+	} else if (looking_at(p, "modulebundle")) {
+		const char *name;
+
+		p = skipspace(p + 12);
+		name = refdup_word(&p);
+		if (module_bundle_load(name))
+			printf("Failed to load module bundle %s\n", name);
+		refstr_put(name);
+	} else if (looking_at(p, "preload")) {
+		const char *name;
+
+		p = skipspace(p + 7);
+		while (*p) {
+			name = refdup_word(&p);
+			if (fs_preload(name))
+				printf("Failed to preload %s\n", name);
+			refstr_put(name);
+			p = skipspace(p);
+		}
+	} else if (looking_at(p, "maxtransfer")) {
+		do_maxtransfer(skipspace(p + 11));
 	} else if (looking_at(p, "sendcookies")) {
 		const union syslinux_derivative_info *sdi;
 
@@ -1429,6 +1486,46 @@ static void parse_config_file(FILE * f)
 			SendCookies = strtoul(skipspace(p), NULL, 10);
 			http_bake_cookies();
 		}
+	} else if (looking_at(p, "tftpmulticast")) {
+		const union syslinux_derivative_info *sdi;
+
+		p += strlen("tftpmulticast");
+		sdi = syslinux_derivative_info();
+
+		if (sdi->c.filesystem == SYSLINUX_FS_PXELINUX)
+			TftpMulticast = !!strtoul(skipspace(p), NULL, 10);
+	} else if (looking_at(p, "httpencoding")) {
+		const union syslinux_derivative_info *sdi;
+
+		p += strlen("httpencoding");
+		sdi = syslinux_derivative_info();
+
+		if (sdi->c.filesystem == SYSLINUX_FS_PXELINUX)
+			HttpEncoding = !!strtoul(skipspace(p), NULL, 10);
+	} else if (looking_at(p, "netcache")) {
+		const union syslinux_derivative_info *sdi;
+
+		p += strlen("netcache");
+		sdi = syslinux_derivative_info();
+
+		if (sdi->c.filesystem == SYSLINUX_FS_PXELINUX)
+			NetCache = strtoul(skipspace(p), NULL, 10);
+	} else if (looking_at(p, "netprefetch")) {
+		const union syslinux_derivative_info *sdi;
+
+		p += strlen("netprefetch");
+		sdi = syslinux_derivative_info();
+
+		if (sdi->c.filesystem == SYSLINUX_FS_PXELINUX)
+			NetPrefetch = !!strtoul(skipspace(p), NULL, 10);
+	} else if (looking_at(p, "dnsprefetch")) {
+		const union syslinux_derivative_info *sdi;
+
+		p += strlen("dnsprefetch");
+		sdi = syslinux_derivative_info();
+
+		if (sdi->c.filesystem == SYSLINUX_FS_PXELINUX)
+			pxe_dns_prefetch(skipspace(p));
 	}
     }
 }
@@ -1495,6 +1592,8 @@ void parse_configs(char **argv)
     struct menu_entry *me;
     dprintf("enter");
 
+    syslinux_trace_begin("parse_configs", argv && *argv ? *argv : NULL, 0);
+
     empty_string = refstrdup("");
 
     /* feng: reset current menu_list and entry list */
@@ -1515,6 +1614,7 @@ void parse_configs(char **argv)
     if (!argv || !*argv) {
 	if (parse_main_config(NULL) < 0) {
 	    printf("WARNING: No configuration file found\n");
+	    syslinux_trace_end("parse_configs", 0);
 	    return;
 	}
     } else {
@@ -1568,4 +1668,6 @@ void parse_configs(char **argv)
 	if (m->onerror)
 	    m->onerror = unlabel(m->onerror);
     }
+
+    syslinux_trace_end("parse_configs", 1);
 }
@@ -84,6 +84,7 @@ typedef void (*module_ctor_t) (void);
  *  the modules currently loaded.
  */
 struct atexit;
+struct module_sym;
 struct elf_module {
 	char				name[MODULE_NAME_SIZE]; 		// The module name
 
@@ -112,12 +113,16 @@ struct elf_module {
 	Elf_Word			syment_size;	// The size of a symbol entry
 	Elf_Word			symtable_size;	// The size of the symbol table
 
+	struct module_sym		*syms;		// Entries in the global symbol index
+	Elf_Word			nr_syms;	// The number of index entries
 
 	union {
 		// Transient - Data available while the module is loading
 		struct {
 			FILE		*_file;		// The file object of the open file
 			Elf_Off	_cr_offset;	// The current offset in the open file
+			const char	*_data;		// The image, if loaded from a bundle
+			size_t		_size;		// The size of the bundled image
 		} l;
 
 		// Process execution data
@@ -155,6 +160,33 @@ extern struct elf_module *unload_modules_since(const char *name);
 
 extern FILE *findpath(char *name);
 
+/**
+ * module_bundle_load - reads in a module bundle.
+ *
+ * @name: the file name of the bundle, looked up along the PATH
+ *
+ * The whole bundle is read with a single sequential read. Modules it
+ * contains are afterwards loaded from memory, matched by file name,
+ * in preference to searching the PATH for them. Loading a bundle that
+ * is already loaded does nothing.
+ *
+ * Returns 0 on success, -ENOMEM if out of memory, or -1 if the bundle
+ * cannot be read or is invalid.
+ */
+extern int module_bundle_load(const char *name);
+
+/**
+ * module_bundle_find - looks up a module in the loaded bundles.
+ *
+ * @name: the module file name, bare or in one of the PATH directories
+ * @data: receives the start of the module image
+ * @size: receives the size of the module image
+ *
+ * Returns 0 if found, -1 otherwise.
+ */
+extern int module_bundle_find(const char *name, const void **data,
+			      size_t *size);
+
 
 /**
  * Names of symbols with special meaning (treated as special cases at linking)
@@ -191,6 +223,25 @@ static inline struct elf_module *module_current(void)
 	return head;
 }
 
+/**
+ * module_list_add - adds a module to the list of loaded modules.
+ * @module: the module descriptor structure.
+ * The module is placed at the head of the module list, and the global and
+ * weak symbols it defines are added to the global symbol index used by
+ * global_find_symbol(). The symbol table of the module must be set up.
+ */
+extern void module_list_add(struct elf_module *module);
+
+/**
+ * module_list_del - removes a module from the list of loaded modules.
+ * @module: the module descriptor structure.
+ * The module and its symbols are removed from the module list and from the
+ * global symbol index. It is safe to call this for a module that is not
+ * on the list.
+ */
+extern void module_list_del(struct elf_module *module);
+
+
 /**
  * modules_init - initialize the module subsystem.
  *
@@ -318,7 +369,9 @@ extern Elf_Sym *module_find_symbol(const char *name, struct elf_module *module);
  * The function search for the given symbol name in all the modules currently
  * loaded in the system, in the reverse module loading order. That is, the most
  * recently loaded module is searched first, followed by the previous one, until
- * the first loaded module is reached.
+ * the first loaded module is reached. A global definition takes precedence over
+ * a weak one. The search is a single probe of the global symbol index, which
+ * holds the definitions of all loaded modules.
  *
  * If no module contains the symbol, NULL is returned, otherwise the return value is
  * a pointer to the symbol descriptor structure. If the module parameter is not NULL,
@@ -0,0 +1,36 @@
+/*
+ * syslinux/iostat.h
+ *
+ * I/O counters kept by the core, since it started.  Rates come from
+ * reading them twice: ms is the time they were read at.
+ */
+
+#ifndef _SYSLINUX_IOSTAT_H
+#define _SYSLINUX_IOSTAT_H
+
+#include <stdint.h>
+
+struct syslinux_iostat {
+    uint32_t ms;		/* ms_timer() when read */
+
+    /* The boot device; all zero when there is none */
+    uint32_t disk_calls;	/* Sector read/write calls */
+    uint32_t disk_errors;	/* Failed firmware requests, retried or not */
+    uint64_t disk_sectors;	/* Sectors transferred */
+    uint32_t sector_size;
+
+    /* Its block cache */
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+    uint32_t cache_evictions;	/* Misses which replaced a cached block */
+
+    /* The network; all zero unless booted from it */
+    uint32_t tftp_timeouts;	/* Waits for a packet which ran out */
+    uint32_t tftp_retransmits;	/* Blocks the server sent again */
+    uint32_t tcp_stall_ms;	/* Time spent waiting for TCP data */
+    uint64_t tcp_bytes;		/* TCP data received */
+};
+
+void syslinux_iostat(struct syslinux_iostat *);
+
+#endif /* _SYSLINUX_IOSTAT_H */
@@ -44,6 +44,7 @@
  */
 struct _DIR_;
 struct dirent;
+struct syslinux_iostat;
 
 struct com32_filedata {
     size_t size;		/* File size */
@@ -77,6 +78,8 @@ struct com32_pmapi {
 
     const int sysappend_count;
     const char * const *sysappend_strings;
+
+    void (*iostat)(struct syslinux_iostat *);
 };
 
 #endif /* _SYSLINUX_PMAPI_H */
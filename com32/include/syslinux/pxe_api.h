@@ -588,8 +588,15 @@ typedef struct s_PXENV_UNLOAD_STACK {
 int __weak pxe_call(int, void *);
 void __weak unload_pxe(uint16_t flags);
 uint32_t __weak pxe_dns(const char *);
+void __weak pxe_dns_prefetch(const char *);
+void __weak pxe_prefetch(const char *);
 
 extern uint32_t __weak SendCookies;
 void __weak http_bake_cookies(void);
 
+extern uint8_t __weak TftpMulticast;
+extern uint8_t __weak HttpEncoding;
+extern uint32_t __weak NetCache;
+extern uint8_t __weak NetPrefetch;
+
 #endif /* _SYSLINUX_PXE_API_H */
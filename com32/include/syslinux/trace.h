@@ -0,0 +1,57 @@
+/*
+ * syslinux/trace.h
+ *
+ * The boot timeline.  The core marks where its phases begin and end,
+ * stamped with the TSC, in a fixed-size ring; when the ring is full
+ * the oldest marks are overwritten.  Modules can add spans of their
+ * own with the same calls.
+ */
+
+#ifndef _SYSLINUX_TRACE_H
+#define _SYSLINUX_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_NAME_LEN		16
+#define TRACE_DETAIL_LEN	32
+
+enum syslinux_trace_type {
+    TRACE_BEGIN = 'B',
+    TRACE_END   = 'E',
+    TRACE_MARK  = 'i',
+};
+
+/* One mark; 64 bytes */
+struct syslinux_trace_event {
+    uint64_t tsc;
+    uint32_t arg;		/* Meaning depends on the name */
+    uint8_t  type;		/* enum syslinux_trace_type */
+    uint8_t  _pad[3];
+    char     name[TRACE_NAME_LEN];
+    char     detail[TRACE_DETAIL_LEN];	/* File name and such; may be "" */
+};
+
+struct syslinux_trace_info {
+    const struct syslinux_trace_event *ring;
+    uint32_t size;		/* Events the ring holds */
+    uint32_t written;		/* Events ever recorded */
+    /* Two points on both clocks, to convert TSC ticks to time */
+    uint64_t start_tsc, now_tsc;
+    uint32_t start_ms, now_ms;
+};
+
+/*
+ * The oldest recorded event is ring[written % size] once the ring
+ * has wrapped, ring[0] before.
+ */
+static inline uint32_t syslinux_trace_first(const struct syslinux_trace_info *ti)
+{
+    return ti->written > ti->size ? ti->written % ti->size : 0;
+}
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg);
+void syslinux_trace_end(const char *name, uint32_t arg);
+void syslinux_trace_mark(const char *name, const char *detail, uint32_t arg);
+int syslinux_trace_info(struct syslinux_trace_info *ti);
+
+#endif /* _SYSLINUX_TRACE_H */
@@ -61,6 +61,436 @@ static int hex_to_int(char *hexa)
     return strtoul(hexa, NULL, 16);
 }
 
+/*
+ * Binary pci.ids / modules.alias index, as made by utils/mkpciidx.
+ *
+ * The index can be used in place of the text files (gzip'd or not);
+ * it is recognized by its magic.  As files can only be read forward,
+ * it is laid out so a lookup reads as little as possible:
+ *
+ *	struct pciidx_header
+ *	class section: struct pciidx_class[nr_classes], then their names
+ *	struct pciidx_page[nr_pages]	page directory
+ *	pages
+ *
+ * Each page holds a uint16_t record count, two bytes of padding, the
+ * sorted records of the page and then the names they refer to, by
+ * offset from the start of the page.  The page directory gives the
+ * vendor:device key of the first record and the size of each page, so
+ * a binary search over it tells which pages can hold a given device.
+ * Only those are parsed, and reading stops after the last one needed.
+ */
+#define PCIIDX_MAGIC	"SLPCIIDX"
+#define PCIIDX_VERSION	1
+
+enum pciidx_type {
+    PCIIDX_PCI_IDS = 1,
+    PCIIDX_MODULES_ALIAS = 2,
+};
+
+/* Record levels for PCIIDX_PCI_IDS */
+enum pciidx_level {
+    PCIIDX_VENDOR = 0,
+    PCIIDX_DEVICE = 1,
+    PCIIDX_SUBSYSTEM = 2,
+};
+
+struct pciidx_header {
+    char magic[8];
+    uint16_t version;
+    uint16_t type;		/* enum pciidx_type */
+    uint32_t class_size;	/* Size of the class section */
+    uint32_t nr_classes;
+    uint32_t nr_pages;
+} __attribute__ ((packed));
+
+struct pciidx_class {
+    uint8_t class;
+    uint8_t sub_class;
+    uint8_t level;		/* 0 = class, 1 = sub class */
+    uint8_t pad;
+    uint32_t name;		/* Offset in the class section */
+} __attribute__ ((packed));
+
+struct pciidx_page {
+    uint32_t key;		/* vendor << 16 | device of the first record */
+    uint32_t size;
+} __attribute__ ((packed));
+
+struct pciidx_rec {
+    uint16_t vendor;
+    uint16_t device;
+    uint16_t sub_vendor;	/* 0xffff = any, for modules.alias */
+    uint16_t sub_device;
+    uint8_t level;		/* enum pciidx_level, 0 for modules.alias */
+    uint8_t pad;
+    uint16_t name;		/* Offset in the page */
+} __attribute__ ((packed));
+
+static int pciidx_skip(FILE *f, uint32_t len)
+{
+    char buf[512];
+    size_t chunk;
+
+    while (len) {
+	chunk = len < sizeof buf ? len : sizeof buf;
+	if (fread(buf, chunk, 1, f) != 1)
+	    return -1;
+	len -= chunk;
+    }
+    return 0;
+}
+
+/*
+ * What pciidx_open() read to tell an index from a text file.  The text
+ * parsers get these bytes back first through pciidx_gets(), so the
+ * file is only opened (and inflated) once.
+ */
+struct pciidx_peek {
+    bool index;			/* An index of the type asked for */
+    size_t len, pos;
+    char buf[sizeof(struct pciidx_header)];
+};
+
+/*
+ * Open @path, and tell whether it is an index of the given type (the
+ * header is then in @hdr) or a text file.  NULL if it can't be opened.
+ */
+static FILE *pciidx_open(const char *path, enum pciidx_type type,
+			 struct pciidx_header *hdr, struct pciidx_peek *peek)
+{
+    FILE *f = zfopen(path, "r");
+
+    if (!f)
+	return NULL;
+
+    peek->len = fread(peek->buf, 1, sizeof peek->buf, f);
+    peek->pos = 0;
+    peek->index = false;
+
+    if (peek->len == sizeof *hdr) {
+	memcpy(hdr, peek->buf, sizeof *hdr);
+	peek->index = !memcmp(hdr->magic, PCIIDX_MAGIC, sizeof hdr->magic) &&
+	    hdr->version == PCIIDX_VERSION && hdr->type == type;
+    }
+
+    return f;
+}
+
+/* fgets() on a text file opened by pciidx_open() */
+static char *pciidx_gets(char *line, int size, FILE *f,
+			 struct pciidx_peek *peek)
+{
+    int n = 0;
+    char c;
+
+    while (peek->pos < peek->len && n < size - 1) {
+	c = peek->buf[peek->pos++];
+	line[n++] = c;
+	if (c == '\n')
+	    break;
+    }
+
+    if (n && (line[n - 1] == '\n' || n == size - 1)) {
+	line[n] = '\0';
+	return line;
+    }
+
+    if (!fgets(line + n, size - n, f)) {
+	if (!n)
+	    return NULL;
+	line[n] = '\0';
+    }
+    return line;
+}
+
+static inline uint32_t pciidx_key(uint16_t vendor, uint16_t device)
+{
+    return ((uint32_t)vendor << 16) | device;
+}
+
+/* Mark the pages which may contain records with the given key */
+static void pciidx_mark_pages(const struct pciidx_page *dir, uint32_t n,
+			      uint32_t key, uint8_t *needed)
+{
+    uint32_t lo = 0, hi = n, first, last;
+
+    /* first = the first page starting at or after key */
+    while (lo < hi) {
+	uint32_t mid = (lo + hi) / 2;
+	if (dir[mid].key < key)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    first = lo;
+
+    /* last = the first page starting after key */
+    hi = n;
+    while (lo < hi) {
+	uint32_t mid = (lo + hi) / 2;
+	if (dir[mid].key <= key)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    last = lo;
+
+    /* Records for key may also begin at the end of the previous page */
+    if (first)
+	first--;
+
+    while (first < last)
+	needed[first++] = 1;
+}
+
+/*
+ * Walk the pages of an index, calling @fn for every page marked in
+ * @needed.  The page is NUL-terminated, so names in it are too.
+ */
+static int pciidx_walk_pages(FILE *f, const struct pciidx_header *hdr,
+			     struct pci_domain *domain,
+			     void (*fn)(struct pci_domain *, const char *,
+					const struct pciidx_rec *, uint16_t))
+{
+    struct pciidx_page *dir;
+    struct pci_device *dev;
+    uint8_t *needed;
+    char *page = NULL;
+    uint32_t i, last = 0, max_size = 0;
+    uint16_t j;
+    int rv = -1;
+
+    dir = malloc(hdr->nr_pages * sizeof *dir);
+    needed = zalloc(hdr->nr_pages + 1);
+    if (!dir || !needed)
+	goto out;
+
+    if (hdr->nr_pages &&
+	fread(dir, hdr->nr_pages * sizeof *dir, 1, f) != 1)
+	goto out;
+
+    for_each_pci_func(dev, domain) {
+	pciidx_mark_pages(dir, hdr->nr_pages,
+			  pciidx_key(dev->vendor, 0), needed);
+	pciidx_mark_pages(dir, hdr->nr_pages,
+			  pciidx_key(dev->vendor, dev->product), needed);
+    }
+
+    for (i = 0; i < hdr->nr_pages; i++) {
+	if (needed[i]) {
+	    last = i + 1;
+	    if (dir[i].size > max_size)
+		max_size = dir[i].size;
+	}
+    }
+
+    page = malloc(max_size + 1);
+    if (!page)
+	goto out;
+
+    for (i = 0; i < last; i++) {
+	uint16_t nr;
+
+	if (!needed[i]) {
+	    if (pciidx_skip(f, dir[i].size))
+		goto out;
+	    continue;
+	}
+
+	if (dir[i].size < 4 || fread(page, dir[i].size, 1, f) != 1)
+	    goto out;
+	page[dir[i].size] = '\0';
+
+	nr = *(uint16_t *)page;
+	if (4 + nr * sizeof(struct pciidx_rec) > dir[i].size)
+	    goto out;
+	for (j = 0; j < nr; j++)
+	    if (((struct pciidx_rec *)(page + 4))[j].name >= dir[i].size)
+		goto out;
+
+	fn(domain, page, (const struct pciidx_rec *)(page + 4), nr);
+    }
+
+    rv = 0;
+out:
+    free(page);
+    free(needed);
+    free(dir);
+    return rv;
+}
+
+/* Compare a record against a key, in the order the index is sorted by */
+static int pciidx_cmp(const struct pciidx_rec *rec, const struct pciidx_rec *key)
+{
+    if (rec->vendor != key->vendor)
+	return rec->vendor < key->vendor ? -1 : 1;
+    if (rec->device != key->device)
+	return rec->device < key->device ? -1 : 1;
+    if (rec->level != key->level)
+	return rec->level < key->level ? -1 : 1;
+    if (rec->sub_vendor != key->sub_vendor)
+	return rec->sub_vendor < key->sub_vendor ? -1 : 1;
+    if (rec->sub_device != key->sub_device)
+	return rec->sub_device < key->sub_device ? -1 : 1;
+    return 0;
+}
+
+/* Binary search a page for the first record not sorting below @key */
+static uint16_t pciidx_lookup(const struct pciidx_rec *recs, uint16_t nr,
+			      const struct pciidx_rec *key)
+{
+    uint16_t lo = 0, hi = nr, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (pciidx_cmp(&recs[mid], key) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return lo;
+}
+
+/* Find the record exactly matching @key in a page */
+static const struct pciidx_rec *pciidx_find(const struct pciidx_rec *recs,
+					    uint16_t nr,
+					    const struct pciidx_rec *key)
+{
+    uint16_t i = pciidx_lookup(recs, nr, key);
+
+    if (i < nr && !pciidx_cmp(&recs[i], key))
+	return &recs[i];
+    return NULL;
+}
+
+static void pciidx_names_page(struct pci_domain *domain, const char *page,
+			      const struct pciidx_rec *recs, uint16_t nr)
+{
+    struct pciidx_rec key;
+    const struct pciidx_rec *rec;
+    struct pci_device *dev;
+
+    memset(&key, 0, sizeof key);
+
+    /* Records are sorted vendor, device, subsystem: assign in that order */
+    for_each_pci_func(dev, domain) {
+	key.vendor = dev->vendor;
+	key.device = 0;
+	key.level = PCIIDX_VENDOR;
+	key.sub_vendor = key.sub_device = 0;
+	rec = pciidx_find(recs, nr, &key);
+	if (rec)
+	    strlcpy(dev->dev_info->vendor_name, page + rec->name,
+		    PCI_VENDOR_NAME_SIZE - 1);
+
+	key.device = dev->product;
+	key.level = PCIIDX_DEVICE;
+	rec = pciidx_find(recs, nr, &key);
+	if (rec)
+	    strlcpy(dev->dev_info->product_name, page + rec->name,
+		    PCI_PRODUCT_NAME_SIZE - 1);
+
+	key.level = PCIIDX_SUBSYSTEM;
+	key.sub_vendor = dev->sub_vendor;
+	key.sub_device = dev->sub_product;
+	rec = pciidx_find(recs, nr, &key);
+	if (rec)
+	    strlcpy(dev->dev_info->product_name, page + rec->name,
+		    PCI_PRODUCT_NAME_SIZE - 1);
+    }
+}
+
+static void pciidx_alias_page(struct pci_domain *domain, const char *page,
+			      const struct pciidx_rec *recs, uint16_t nr)
+{
+    struct pciidx_rec key;
+    struct pci_device *dev;
+    char module_name[21];
+    uint16_t i;
+    int j;
+
+    memset(&key, 0, sizeof key);
+
+    for_each_pci_func(dev, domain) {
+	key.vendor = dev->vendor;
+	key.device = dev->product;
+
+	for (i = pciidx_lookup(recs, nr, &key);
+	     i < nr && recs[i].vendor == dev->vendor &&
+	     recs[i].device == dev->product; i++) {
+	    /* Same matching rule as for the text modules.alias */
+	    if ((recs[i].sub_device & dev->sub_product) != dev->sub_product ||
+		(recs[i].sub_vendor & dev->sub_vendor) != dev->sub_vendor)
+		continue;
+
+	    strlcpy(module_name, page + recs[i].name, sizeof module_name - 1);
+
+	    for (j = 0; j < dev->dev_info->linux_kernel_module_count; j++)
+		if (strstr(dev->dev_info->linux_kernel_module[j], module_name))
+		    break;
+
+	    if (j == dev->dev_info->linux_kernel_module_count &&
+		j < MAX_KERNEL_MODULES_PER_PCI_DEVICE) {
+		strcpy(dev->dev_info->linux_kernel_module[j], module_name);
+		dev->dev_info->linux_kernel_module_count++;
+	    }
+	}
+    }
+}
+
+static int pciidx_get_class_names(struct pci_domain *domain, FILE *f,
+				  const struct pciidx_header *hdr)
+{
+    const struct pciidx_class *classes;
+    struct pci_device *dev;
+    char *section;
+    uint32_t i;
+
+    if ((uint64_t)hdr->nr_classes * sizeof *classes > hdr->class_size)
+	return -ENOPCIIDS;
+
+    section = malloc(hdr->class_size + 1);
+    if (!section)
+	return -1;
+
+    if (hdr->class_size && fread(section, hdr->class_size, 1, f) != 1) {
+	free(section);
+	return -ENOPCIIDS;
+    }
+    section[hdr->class_size] = '\0';
+    classes = (const struct pciidx_class *)section;
+
+    /* Classes come before their sub classes */
+    for (i = 0; i < hdr->nr_classes; i++) {
+	const char *name = section + classes[i].name;
+
+	if (classes[i].name >= hdr->class_size)
+	    continue;
+
+	for_each_pci_func(dev, domain) {
+	    if (classes[i].class != dev->class[2])
+		continue;
+
+	    if (classes[i].level == 0) {
+		strlcpy(dev->dev_info->class_name, name,
+			PCI_CLASS_NAME_SIZE - 1);
+		/* This value is usually the main category */
+		strlcpy(dev->dev_info->category_name,
+			strlen(name) > 4 ? name + 4 : name,
+			PCI_CLASS_NAME_SIZE - 1);
+	    } else if (classes[i].sub_class == dev->class[1]) {
+		strlcpy(dev->dev_info->class_name, name,
+			PCI_CLASS_NAME_SIZE - 1);
+	    }
+	}
+    }
+
+    free(section);
+    return 0;
+}
+
 /* Try to match any pci device to the appropriate kernel module */
 /* it uses the modules.pcimap from the boot device */
 int get_module_name_from_pcimap(struct pci_domain *domain,
@@ -180,6 +610,9 @@ int get_class_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
     FILE *f;
     struct pci_device *dev;
     bool class_mode = false;
+    struct pciidx_header hdr;
+    struct pciidx_peek peek;
+    int rv;
 
     /* Intializing the vendor/product name for each pci device to "unknown" */
     /* adding a dev_info member if needed */
@@ -194,12 +627,19 @@ int get_class_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
     }
 
     /* Opening the pci.ids from the boot device */
-    f = zfopen(pciids_path, "r");
+    f = pciidx_open(pciids_path, PCIIDX_PCI_IDS, &hdr, &peek);
     if (!f)
 	return -ENOPCIIDS;
 
+    /* Use the binary index if that is what we got */
+    if (peek.index) {
+	rv = pciidx_get_class_names(domain, f, &hdr);
+	fclose(f);
+	return rv;
+    }
+
     /* for each line we found in the pci.ids */
-    while (fgets(line, sizeof line, f)) {
+    while (pciidx_gets(line, sizeof line, f, &peek)) {
 	/* Skipping uncessary lines */
 	if ((line[0] == '#') || (line[0] == ' ') || (line[0] == 10))
 	    continue;
@@ -279,6 +719,9 @@ int get_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
     uint16_t int_product_id;
     uint16_t int_sub_product_id;
     uint16_t int_sub_vendor_id;
+    struct pciidx_header hdr;
+    struct pciidx_peek peek;
+    int rv;
 
     /* Intializing the vendor/product name for each pci device to "unknown" */
     /* adding a dev_info member if needed */
@@ -294,17 +737,25 @@ int get_name_from_pci_ids(struct pci_domain *domain, char *pciids_path)
     }
 
     /* Opening the pci.ids from the boot device */
-    f = zfopen(pciids_path, "r");
+    f = pciidx_open(pciids_path, PCIIDX_PCI_IDS, &hdr, &peek);
     if (!f)
 	return -ENOPCIIDS;
 
+    /* Use the binary index if that is what we got */
+    if (peek.index) {
+	rv = pciidx_skip(f, hdr.class_size) ||
+	    pciidx_walk_pages(f, &hdr, domain, pciidx_names_page);
+	fclose(f);
+	return rv ? -ENOPCIIDS : 0;
+    }
+
     strlcpy(vendor_id, "0000", 4);
     strlcpy(product_id, "0000", 4);
     strlcpy(sub_product_id, "0000", 4);
     strlcpy(sub_vendor_id, "0000", 4);
 
     /* for each line we found in the pci.ids */
-    while (fgets(line, sizeof line, f)) {
+    while (pciidx_gets(line, sizeof line, f, &peek)) {
 	/* Skipping uncessary lines */
 	if ((line[0] == '#') || (line[0] == ' ') || (line[0] == 'C') ||
 	    (line[0] == 10))
@@ -604,6 +1055,9 @@ int get_module_name_from_alias(struct pci_domain *domain, char *modules_alias_pa
   FILE *f;
   struct pci_device *dev=NULL;
   int valid_lines=0;
+  struct pciidx_header hdr;
+  struct pciidx_peek peek;
+  int rv;
 
   /* Intializing the linux_kernel_module for each pci device to "unknown" */
   /* adding a dev_info member if needed */
@@ -620,13 +1074,21 @@ int get_module_name_from_alias(struct pci_domain *domain, char *modules_alias_pa
     }
   }
 
-  /* Opening the modules.pcimap (of a linux kernel) from the boot device */
-  f=zfopen(modules_alias_path, "r");
+  /* Opening the modules.alias (of a linux kernel) from the boot device */
+  f=pciidx_open(modules_alias_path, PCIIDX_MODULES_ALIAS, &hdr, &peek);
   if (!f)
     return -ENOMODULESALIAS;
 
+  /* Use the binary index if that is what we got */
+  if (peek.index) {
+    rv = pciidx_skip(f, hdr.class_size) ||
+      pciidx_walk_pages(f, &hdr, domain, pciidx_alias_page);
+    fclose(f);
+    return (rv || !hdr.nr_pages) ? -ENOMODULESALIAS : 0;
+  }
+
   /* for each line we found in the modules.pcimap */
-  while ( fgets(line, sizeof line, f) ) {
+  while ( pciidx_gets(line, sizeof line, f, &peek) ) {
     /* skipping unecessary lines */
     if ((line[0] == '#') || (strstr(line,"alias pci:v")==NULL))
         continue;
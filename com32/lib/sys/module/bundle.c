@@ -0,0 +1,195 @@
+/*
+ * bundle.c - module bundles
+ *
+ * A module bundle is a single file holding several ELF modules, built on
+ * the host by utils/mkmodbundle.  It is read in with one sequential read,
+ * after which modules it contains are loaded from memory instead of being
+ * looked up along the PATH and read file by file.
+ *
+ * Layout (all fields little endian):
+ *
+ *	struct bundle_header
+ *	struct bundle_entry[nr_entries]
+ *	module data, at the offsets given by the entries
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dprintf.h>
+#include <sys/stat.h>
+#include <fs.h>
+
+#include <linux/list.h>
+#include <sys/module.h>
+
+#define BUNDLE_MAGIC		"SLXMODB1"
+#define BUNDLE_NAME_LEN		56
+
+struct bundle_header {
+	char		magic[8];	/* BUNDLE_MAGIC */
+	uint32_t	nr_entries;
+	uint32_t	size;		/* Size of the whole bundle */
+};
+
+struct bundle_entry {
+	uint32_t	offset;		/* From the start of the bundle */
+	uint32_t	size;
+	char		name[BUNDLE_NAME_LEN];	/* Null-terminated file name */
+};
+
+struct module_bundle {
+	struct list_head	list;
+	char			*name;
+	char			*data;
+	const struct bundle_entry *entries;
+	uint32_t		nr_entries;
+};
+
+static LIST_HEAD(bundles_head);
+
+static int bundle_check(const char *data, size_t size)
+{
+	const struct bundle_header *hdr = (const struct bundle_header *)data;
+	const struct bundle_entry *entry;
+	uint32_t i, j;
+
+	if (size < sizeof(*hdr) || memcmp(hdr->magic, BUNDLE_MAGIC, 8) ||
+	    hdr->size != size)
+		return -1;
+
+	if (hdr->nr_entries > (size - sizeof(*hdr)) / sizeof(*entry))
+		return -1;
+
+	entry = (const struct bundle_entry *)(hdr + 1);
+	for (i = 0; i < hdr->nr_entries; i++, entry++) {
+		if (entry->offset > size || entry->size > size - entry->offset)
+			return -1;
+		for (j = 0; j < BUNDLE_NAME_LEN && entry->name[j]; j++)
+			;
+		if (j == BUNDLE_NAME_LEN)
+			return -1;	/* Name not terminated */
+	}
+
+	return 0;
+}
+
+int module_bundle_load(const char *name)
+{
+	struct module_bundle *bundle;
+	struct stat st;
+	FILE *f;
+	char *data;
+
+	list_for_each_entry(bundle, &bundles_head, list) {
+		if (!strcmp(bundle->name, name))
+			return 0;	/* Already loaded */
+	}
+
+	f = findpath((char *)name);
+	if (!f) {
+		dprintf("Could not open module bundle '%s'\n", name);
+		return -1;
+	}
+
+	if (fstat(fileno(f), &st) || !st.st_size) {
+		fclose(f);
+		return -1;
+	}
+
+	data = malloc(st.st_size);
+	bundle = malloc(sizeof(*bundle));
+	if (!data || !bundle)
+		goto err;
+
+	/* The whole bundle in one go */
+	if (fread(data, st.st_size, 1, f) != 1)
+		goto err;
+
+	if (bundle_check(data, st.st_size)) {
+		printf("%s: not a valid module bundle\n", name);
+		goto err;
+	}
+
+	fclose(f);
+
+	bundle->name = strdup(name);
+	if (!bundle->name) {
+		free(bundle);
+		free(data);
+		return -ENOMEM;
+	}
+	bundle->data = data;
+	bundle->entries = (const struct bundle_entry *)
+		(data + sizeof(struct bundle_header));
+	bundle->nr_entries =
+		((const struct bundle_header *)data)->nr_entries;
+
+	/* Bundles loaded later take precedence */
+	list_add(&bundle->list, &bundles_head);
+
+	dprintf("Module bundle %s: %u modules\n", name, bundle->nr_entries);
+	return 0;
+
+err:
+	free(bundle);
+	free(data);
+	fclose(f);
+	return -1;
+}
+
+/*
+ * A bundle stands in for the modules along the PATH, so it answers for
+ * a bare file name, or for a path into one of the PATH directories.
+ * Any other path names a file of its own.  Returns the name to look up,
+ * or NULL.
+ */
+static const char *bundle_member_name(const char *name)
+{
+	struct path_entry *entry;
+	const char *p;
+	size_t len;
+
+	p = strrchr(name, '/');
+	if (!p)
+		return name;
+
+	list_for_each_entry(entry, &PATH, list) {
+		len = strlen(entry->str);
+		while (len && entry->str[len - 1] == '/')
+			len--;
+
+		if (len == (size_t)(p - name) && !strncmp(entry->str, name, len))
+			return p + 1;
+	}
+
+	return NULL;
+}
+
+int module_bundle_find(const char *name, const void **data, size_t *size)
+{
+	struct module_bundle *bundle;
+	uint32_t i;
+
+	/* Members are stored by file name, without any path */
+	name = bundle_member_name(name);
+	if (!name)
+		return -1;
+
+	list_for_each_entry(bundle, &bundles_head, list) {
+		for (i = 0; i < bundle->nr_entries; i++) {
+			const struct bundle_entry *entry = &bundle->entries[i];
+
+			if (strcmp(entry->name, name))
+				continue;
+
+			*data = bundle->data + entry->offset;
+			*size = entry->size;
+			return 0;
+		}
+	}
+
+	return -1;
+}
@@ -21,6 +21,27 @@
  */
 LIST_HEAD(modules_head);
 
+/**
+ * The global symbol index: every global or weak symbol defined by a
+ * loaded module, hashed by name.  Within a chain, the entries of more
+ * recently loaded modules come first, i.e. in module list order, so the
+ * first match is the one a walk of the module list would have found.
+ */
+struct module_sym {
+	struct module_sym	*next;
+	Elf_Word		hash;
+	const char		*name;
+	Elf_Sym			*sym;
+	struct elf_module	*module;
+};
+
+#define SYMHASH_MIN_SIZE	1024
+
+static struct module_sym **symhash;
+static unsigned int symhash_size;	/* Number of buckets, a power of 2 */
+static unsigned int symhash_count;	/* Number of entries */
+static bool symhash_failed;		/* Out of memory, walk the modules */
+
 // User-space debugging routines
 #ifdef ELF_DEBUG
 void print_elf_ehdr(Elf_Ehdr *ehdr) {
@@ -92,6 +113,20 @@ FILE *findpath(char *name)
 
 int image_load(struct elf_module *module)
 {
+	const void *data;
+	size_t size;
+
+	module->u.l._cr_offset = 0;
+
+	if (!module_bundle_find(module->name, &data, &size)) {
+		dprintf("Loading '%s' from a module bundle\n", module->name);
+		module->u.l._file = NULL;
+		module->u.l._data = data;
+		module->u.l._size = size;
+		return 0;
+	}
+
+	module->u.l._data = NULL;
 	module->u.l._file = findpath(module->name);
 
 	if (module->u.l._file == NULL) {
@@ -99,8 +134,6 @@ int image_load(struct elf_module *module)
 		goto error;
 	}
 
-	module->u.l._cr_offset = 0;
-
 	return 0;
 
 error:
@@ -119,13 +152,25 @@ int image_unload(struct elf_module *module) {
 		module->u.l._file = NULL;
 
 	}
+	module->u.l._data = NULL;
 	module->u.l._cr_offset = 0;
 
 	return 0;
 }
 
 int image_read(void *buff, size_t size, struct elf_module *module) {
-	size_t result = fread(buff, size, 1, module->u.l._file);
+	size_t result;
+
+	if (module->u.l._data) {
+		if (size > module->u.l._size - module->u.l._cr_offset)
+			return -1;
+
+		memcpy(buff, module->u.l._data + module->u.l._cr_offset, size);
+		module->u.l._cr_offset += size;
+		return 0;
+	}
+
+	result = fread(buff, size, 1, module->u.l._file);
 
 	if (result < 1)
 		return -1;
@@ -141,6 +186,14 @@ int image_skip(size_t size, struct elf_module *module) {
 	if (size == 0)
 		return 0;
 
+	if (module->u.l._data) {
+		if (size > module->u.l._size - module->u.l._cr_offset)
+			return -1;
+
+		module->u.l._cr_offset += size;
+		return 0;
+	}
+
 	skip_buff = malloc(size);
 	result = fread(skip_buff, size, 1, module->u.l._file);
 	free(skip_buff);
@@ -170,6 +223,160 @@ void modules_term(void) {
 
 }
 
+static void symhash_insert(struct elf_module *module)
+{
+	struct module_sym *e, **bucket;
+	Elf_Word i;
+
+	for (i = 0; i < module->nr_syms; i++) {
+		e = &module->syms[i];
+		bucket = &symhash[e->hash & (symhash_size - 1)];
+		e->next = *bucket;
+		*bucket = e;
+	}
+}
+
+static void symhash_remove(struct elf_module *module)
+{
+	struct module_sym *e, **pp;
+	Elf_Word i;
+
+	for (i = 0; i < module->nr_syms; i++) {
+		e = &module->syms[i];
+		pp = &symhash[e->hash & (symhash_size - 1)];
+		while (*pp != e)
+			pp = &(*pp)->next;
+		*pp = e->next;
+	}
+}
+
+/* Rebuild the index with @size buckets, oldest module first */
+static int symhash_resize(unsigned int size)
+{
+	struct elf_module *crt_module;
+	struct module_sym **new_hash;
+
+	new_hash = calloc(size, sizeof(*new_hash));
+	if (!new_hash)
+		return -1;
+
+	free(symhash);
+	symhash = new_hash;
+	symhash_size = size;
+
+	list_for_each_entry_reverse(crt_module, &modules_head, list)
+		symhash_insert(crt_module);
+
+	return 0;
+}
+
+static void symhash_disable(void)
+{
+	struct elf_module *crt_module;
+
+	dprintf("module: out of memory, symbol index disabled\n");
+
+	for_each_module(crt_module) {
+		free(crt_module->syms);
+		crt_module->syms = NULL;
+		crt_module->nr_syms = 0;
+	}
+
+	free(symhash);
+	symhash = NULL;
+	symhash_size = symhash_count = 0;
+	symhash_failed = true;
+}
+
+/* Collect the symbols @module defines for other modules to use */
+static int module_build_syms(struct elf_module *module)
+{
+	Elf_Word i, nr, count = 0;
+	Elf_Sym *crt_sym;
+	unsigned char bind;
+
+	if (!module->syment_size)
+		return 0;
+
+	nr = module->symtable_size / module->syment_size;
+
+	for (i = 1; i < nr; i++) {
+		crt_sym = symbol_get_entry(module, i);
+		bind = ELF32_ST_BIND(crt_sym->st_info);
+		if (crt_sym->st_shndx != SHN_UNDEF &&
+		    (bind == STB_GLOBAL || bind == STB_WEAK))
+			count++;
+	}
+
+	if (!count)
+		return 0;
+
+	module->syms = malloc(count * sizeof(struct module_sym));
+	if (!module->syms)
+		return -1;
+
+	for (i = 1; i < nr; i++) {
+		struct module_sym *e;
+
+		crt_sym = symbol_get_entry(module, i);
+		bind = ELF32_ST_BIND(crt_sym->st_info);
+		if (crt_sym->st_shndx == SHN_UNDEF ||
+		    (bind != STB_GLOBAL && bind != STB_WEAK))
+			continue;
+
+		e = &module->syms[module->nr_syms++];
+		e->name = module->str_table + crt_sym->st_name;
+		e->hash = elf_gnu_hash((const unsigned char *)e->name);
+		e->sym = crt_sym;
+		e->module = module;
+	}
+
+	return 0;
+}
+
+// Adds a module to the head of the module list and to the symbol index
+void module_list_add(struct elf_module *module)
+{
+	unsigned int size;
+
+	list_add(&module->list, &modules_head);
+
+	if (symhash_failed)
+		return;
+
+	if (module_build_syms(module)) {
+		symhash_disable();
+		return;
+	}
+
+	symhash_count += module->nr_syms;
+
+	if (symhash_count > symhash_size) {
+		size = symhash_size ? symhash_size : SYMHASH_MIN_SIZE;
+		while (size < symhash_count)
+			size <<= 1;
+
+		if (symhash_resize(size))
+			symhash_disable();
+	} else {
+		symhash_insert(module);
+	}
+}
+
+// Removes a module from the module list and from the symbol index
+void module_list_del(struct elf_module *module)
+{
+	if (module->syms) {
+		symhash_remove(module);
+		symhash_count -= module->nr_syms;
+		free(module->syms);
+		module->syms = NULL;
+		module->nr_syms = 0;
+	}
+
+	list_del_init(&module->list);
+}
+
 // Allocates the structure for a new module
 struct elf_module *module_alloc(const char *name) {
 	struct elf_module *result = malloc(sizeof(struct elf_module));
@@ -316,50 +523,28 @@ int check_symbols(struct elf_module *module)
 	unsigned int i;
 	Elf_Sym *crt_sym = NULL, *ref_sym = NULL;
 	char *crt_name;
-	struct elf_module *crt_module;
-
-	int strong_count;
-	int weak_count;
 
 	for (i = 1; i < module->symtable_size/module->syment_size; i++)
 	{
 		crt_sym = symbol_get_entry(module, i);
 		crt_name = module->str_table + crt_sym->st_name;
 
-		strong_count = 0;
-		weak_count = (ELF32_ST_BIND(crt_sym->st_info) == STB_WEAK);
-
-		for_each_module(crt_module)
-		{
-			ref_sym = module_find_symbol(crt_name, crt_module);
-
-			// If we found a definition for our symbol...
-			if (ref_sym != NULL && ref_sym->st_shndx != SHN_UNDEF)
-			{
-				switch (ELF32_ST_BIND(ref_sym->st_info))
-				{
-					case STB_GLOBAL:
-						strong_count++;
-						break;
-					case STB_WEAK:
-						weak_count++;
-						break;
-				}
-			}
-		}
+		ref_sym = global_find_symbol(crt_name, NULL);
 
 		if (crt_sym->st_shndx == SHN_UNDEF)
 		{
 			// We have an undefined symbol
 			//
-			// We use the weak_count to differentiate
-			// between Syslinux-derivative-specific
-			// functions. For example, unload_pxe() is
-			// only provided by PXELINUX, so we mark it as
-			// __weak and replace it with a reference to
-			// undefined_symbol() on SYSLINUX, EXTLINUX,
-			// and ISOLINUX. See perform_relocations().
-			if (strong_count == 0 && weak_count == 0)
+			// A weak reference is allowed to stay
+			// unresolved, to handle Syslinux-derivative-
+			// specific functions. For example,
+			// unload_pxe() is only provided by PXELINUX,
+			// so we mark it as __weak and replace it with
+			// a reference to undefined_symbol() on
+			// SYSLINUX, EXTLINUX, and ISOLINUX. See
+			// perform_relocations().
+			if (ref_sym == NULL &&
+			    ELF32_ST_BIND(crt_sym->st_info) != STB_WEAK)
 			{
 				dprintf("Symbol %s is undefined\n", crt_name);
 				printf("Undef symbol FAIL: %s\n",crt_name);
@@ -368,7 +553,7 @@ int check_symbols(struct elf_module *module)
 		}
 		else
 		{
-			if (strong_count > 0 && ELF32_ST_BIND(ref_sym->st_info) == STB_GLOBAL)
+			if (ref_sym != NULL && ELF32_ST_BIND(ref_sym->st_info) == STB_GLOBAL)
 			{
 				// It's not an error - at relocation, the most recent symbol
 				// will be considered
@@ -404,7 +589,7 @@ int _module_unload(struct elf_module *module) {
 	}
 
 	// Remove the module from the module list
-	list_del_init(&module->list);
+	module_list_del(module);
 
 	// Release the loaded segments or sections
 	if (module->module_addr != NULL) {
@@ -578,7 +763,8 @@ Elf_Sym *module_find_symbol(const char *name, struct elf_module *module) {
 	return result;
 }
 
-Elf_Sym *global_find_symbol(const char *name, struct elf_module **module) {
+static Elf_Sym *global_find_symbol_iterate(const char *name,
+					   struct elf_module **module) {
 	struct elf_module *crt_module;
 	Elf_Sym *crt_sym = NULL;
 	Elf_Sym *result = NULL;
@@ -608,3 +794,35 @@ Elf_Sym *global_find_symbol(const char *name, struct elf_module **module) {
 
 	return result;
 }
+
+Elf_Sym *global_find_symbol(const char *name, struct elf_module **module) {
+	struct module_sym *e, *found = NULL;
+	Elf_Word h;
+
+	if (!symhash)
+		return global_find_symbol_iterate(name, module);
+
+	h = elf_gnu_hash((const unsigned char *)name);
+
+	for (e = symhash[h & (symhash_size - 1)]; e; e = e->next) {
+		if (e->hash != h || strcmp(e->name, name))
+			continue;
+
+		if (ELF32_ST_BIND(e->sym->st_info) == STB_GLOBAL) {
+			found = e;
+			break;
+		}
+
+		// Consider only the first weak symbol
+		if (found == NULL)
+			found = e;
+	}
+
+	if (found == NULL)
+		return NULL;
+
+	if (module != NULL)
+		*module = found->module;
+
+	return found->sym;
+}
@@ -12,10 +12,12 @@
 #include <elf.h>
 #include <dprintf.h>
 #include <core.h>
+#include <sys/times.h>
 
 #include <linux/list.h>
 #include <sys/module.h>
 #include <sys/exec.h>
+#include <syslinux/trace.h>
 
 #include "elfutils.h"
 #include "common.h"
@@ -178,13 +180,13 @@ static int extract_operations(struct elf_module *module) {
 	return 0;
 }
 
-// Loads the module into the system
-int module_load(struct elf_module *module) {
+static int do_module_load(struct elf_module *module) {
 	int res;
 	Elf_Sym *main_sym;
 	Elf_Ehdr elf_hdr;
 	module_ctor_t *ctor;
 	struct elf_module *head = NULL;
+	clock_t t_resolve, t_reloc, t_done;
 
 	// Do not allow duplicate modules
 	if (module_find(module->name) != NULL) {
@@ -255,6 +257,7 @@ int module_load(struct elf_module *module) {
 	}
 
 	// Check the symbols for duplicates / missing definitions
+	t_resolve = times(NULL);
 	CHECKED(res, check_symbols(module), error);
 	//printf("check... 5\n");
 
@@ -266,10 +269,17 @@ int module_load(struct elf_module *module) {
 	//printf("check... 6\n");
 
 	// Add the module at the beginning of the module list
-	list_add(&module->list, &modules_head);
+	module_list_add(module);
 
 	// Perform the relocations
+	t_reloc = times(NULL);
+	syslinux_trace_begin("relocate", module->name, 0);
 	resolve_symbols(module);
+	syslinux_trace_end("relocate", 0);
+	t_done = times(NULL);
+
+	dprintf("%s: symbols checked in %u ms, relocated in %u ms\n",
+		module->name, t_reloc - t_resolve, t_done - t_reloc);
 
 	// Obtain constructors and destructors
 	CHECKED(res, extract_operations(module), error);
@@ -299,7 +309,7 @@ error:
 		unload_modules_since(head->name);
 
 	// Remove the module from the module list (if applicable)
-	list_del_init(&module->list);
+	module_list_del(module);
 
 	if (module->module_addr != NULL) {
 		elf_free(module->module_addr);
@@ -314,3 +324,14 @@ error:
 	return res;
 }
 
+// Loads the module into the system
+int module_load(struct elf_module *module) {
+	int res;
+
+	syslinux_trace_begin("module_load", module->name, 0);
+	res = do_module_load(module);
+	syslinux_trace_end("module_load", res);
+
+	return res;
+}
+
@@ -31,6 +31,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <syslinux/zio.h>
+#include <syslinux/trace.h>
 
 #include "file.h"
 #include "zlib.h"
@@ -80,7 +81,7 @@ static int gzip_file_init(struct file_info *fp)
     return 0;
 }
 
-static ssize_t gzip_file_read(struct file_info *fp, void *ptr, size_t n)
+static ssize_t gzip_file_inflate(struct file_info *fp, void *ptr, size_t n)
 {
     z_streamp zs = fp->i.pvt;
     int rv;
@@ -128,6 +129,17 @@ static ssize_t gzip_file_read(struct file_info *fp, void *ptr, size_t n)
     return nout;
 }
 
+static ssize_t gzip_file_read(struct file_info *fp, void *ptr, size_t n)
+{
+    ssize_t rv;
+
+    syslinux_trace_begin("inflate", NULL, n);
+    rv = gzip_file_inflate(fp, ptr, n);
+    syslinux_trace_end("inflate", rv);
+
+    return rv;
+}
+
 static int gzip_file_close(struct file_info *fp)
 {
     z_streamp zs = fp->i.pvt;
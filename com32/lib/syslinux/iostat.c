@@ -0,0 +1,14 @@
+/*
+ * syslinux/iostat.c
+ *
+ * Read the core's I/O counters
+ */
+
+#include <core.h>
+#include <pmapi.h>
+#include <syslinux/iostat.h>
+
+void syslinux_iostat(struct syslinux_iostat *st)
+{
+    pmapi_iostat(st);
+}
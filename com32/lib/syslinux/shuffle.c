@@ -44,6 +44,7 @@
 #include <syslinux/movebits.h>
 #include <klibc/compiler.h>
 #include <syslinux/boot.h>
+#include <syslinux/trace.h>
 
 struct shuffle_descriptor {
     addr_t dst, src, len;
@@ -75,6 +76,8 @@ int syslinux_do_shuffle(struct syslinux_movelist *fraglist,
     return -1;			/* Not supported at this time*/
 #endif
 
+    syslinux_trace_begin("shuffle", NULL, 0);
+
     descaddr = 0;
     dp = dbuf = NULL;
 
@@ -215,6 +218,9 @@ bail:
     if (rxmap)
 	syslinux_free_memmap(rxmap);
 
+    /* Only the planning is timed; the moves end with the jump */
+    syslinux_trace_end("shuffle", rv ? 0 : np);
+
     if (rv)
 	return rv;
 
@@ -12,6 +12,52 @@
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+/*
+   On x86 unaligned loads and stores are cheap, so matches are copied a word
+   at a time instead of a byte at a time, and the bit buffer is refilled with
+   a single 16-bit load.  A word copy is only used while the distance is at
+   least a word, so every byte it reads has already been written.  Copies
+   never write past out + len: inflate() only guarantees 258 bytes of room.
+ */
+#if (defined(__i386__) || defined(__x86_64__)) && !defined(INFLATE_NO_CHUNK)
+#  define INFLATE_CHUNK_COPY
+#endif
+
+#ifdef INFLATE_CHUNK_COPY
+#include <string.h>
+
+typedef unsigned int chunk_t;
+#  define CHUNK ((unsigned)sizeof(chunk_t))
+#  define CHUNKCOPY(d, s) \
+    (*(chunk_t *)(void *)(d) = *(const chunk_t *)(const void *)(s))
+#  define zmemset(d, c, n) memset(d, c, n)
+#  define WINCOPY(d, s, n) \
+    do { \
+        zmemcpy(d, s, n); \
+        d += n; \
+        s += n; \
+    } while (0)
+#  define PULL2BYTES() \
+    do { \
+        hold += (unsigned long)(*(const unsigned short *)(const void *)in) \
+            << bits; \
+        in += 2; \
+        bits += 16; \
+    } while (0)
+#else
+#  define WINCOPY(d, s, n) \
+    do { \
+        *d++ = *s++; \
+    } while (--n)
+#  define PULL2BYTES() \
+    do { \
+        hold += (unsigned long)(*in++) << bits; \
+        bits += 8; \
+        hold += (unsigned long)(*in++) << bits; \
+        bits += 8; \
+    } while (0)
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -101,12 +147,8 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(*in++) << bits;
-            bits += 8;
-            hold += (unsigned long)(*in++) << bits;
-            bits += 8;
-        }
+        if (bits < 15)
+            PULL2BYTES();
         here = lcode[hold & lmask];
       dolen:
         op = (unsigned)(here.bits);
@@ -132,12 +174,8 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
-            if (bits < 15) {
-                hold += (unsigned long)(*in++) << bits;
-                bits += 8;
-                hold += (unsigned long)(*in++) << bits;
-                bits += 8;
-            }
+            if (bits < 15)
+                PULL2BYTES();
             here = dcode[hold & dmask];
           dodist:
             op = (unsigned)(here.bits);
@@ -201,9 +239,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
@@ -212,16 +248,12 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         op -= wnext;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = window;
                             if (wnext < len) {  /* some from start of window */
                                 op = wnext;
                                 len -= op;
-                                do {
-                                    *out++ = *from++;
-                                } while (--op);
+                                WINCOPY(out, from, op);
                                 from = out - dist;      /* rest from output */
                             }
                         }
@@ -230,12 +262,25 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         from += wnext - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                *out++ = *from++;
-                            } while (--op);
+                            WINCOPY(out, from, op);
                             from = out - dist;  /* rest from output */
                         }
                     }
+#ifdef INFLATE_CHUNK_COPY
+                    if (from != out - dist || dist >= len) {
+                        zmemcpy(out, from, len);  /* window or no overlap */
+                        out += len;
+                        len = 0;
+                    }
+                    else {
+                        while (dist >= CHUNK && len >= CHUNK) {
+                            CHUNKCOPY(out, from);
+                            out += CHUNK;
+                            from += CHUNK;
+                            len -= CHUNK;
+                        }
+                    }
+#endif
                     while (len > 2) {
                         *out++ = *from++;
                         *out++ = *from++;
@@ -250,6 +295,26 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                 }
                 else {
                     from = out - dist;          /* copy direct from output */
+#ifdef INFLATE_CHUNK_COPY
+                    if (dist >= len) {          /* no overlap */
+                        zmemcpy(out, from, len);
+                        out += len;
+                        continue;
+                    }
+                    if (dist == 1) {            /* run of one byte */
+                        zmemset(out, *from, len);
+                        out += len;
+                        continue;
+                    }
+                    while (dist >= CHUNK && len >= CHUNK) {
+                        CHUNKCOPY(out, from);   /* reads behind what */
+                        out += CHUNK;           /* it writes */
+                        from += CHUNK;
+                        len -= CHUNK;
+                    }
+                    while (len--)
+                        *out++ = *from++;
+#else
                     do {                        /* minimum length is three */
                         *out++ = *from++;
                         *out++ = *from++;
@@ -261,6 +326,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
                         if (len > 1)
                             *out++ = *from++;
                     }
+#endif
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -41,6 +41,7 @@
 #include "syslinux/linux.h"
 #include "syslinux/config.h"
 #include "syslinux/reboot.h"
+#include "syslinux/iostat.h"
 
 int __parse_argv(char ***argv, const char *str);
 
@@ -435,6 +436,34 @@ static int sl_KEY_CTRL (lua_State * L)
     return 1;
 }
 
+static void sl_setfield(lua_State * L, const char *name, lua_Number value)
+{
+    lua_pushnumber(L, value);
+    lua_setfield(L, -2, name);
+}
+
+static int sl_iostat(lua_State * L)
+{
+    struct syslinux_iostat st;
+
+    syslinux_iostat(&st);
+
+    lua_newtable(L);
+    sl_setfield(L, "ms", st.ms);
+    sl_setfield(L, "disk_calls", st.disk_calls);
+    sl_setfield(L, "disk_errors", st.disk_errors);
+    sl_setfield(L, "disk_sectors", st.disk_sectors);
+    sl_setfield(L, "sector_size", st.sector_size);
+    sl_setfield(L, "cache_hits", st.cache_hits);
+    sl_setfield(L, "cache_misses", st.cache_misses);
+    sl_setfield(L, "cache_evictions", st.cache_evictions);
+    sl_setfield(L, "tftp_timeouts", st.tftp_timeouts);
+    sl_setfield(L, "tftp_retransmits", st.tftp_retransmits);
+    sl_setfield(L, "tcp_stall_ms", st.tcp_stall_ms);
+    sl_setfield(L, "tcp_bytes", st.tcp_bytes);
+    return 1;
+}
+
 static const luaL_Reg syslinuxlib[] = {
     {"run_command", sl_run_command},
     {"run_default", sl_run_default},
@@ -454,6 +483,7 @@ static const luaL_Reg syslinuxlib[] = {
     {"version", sl_version},
     {"get_key", sl_get_key},
     {"KEY_CTRL", sl_KEY_CTRL},
+    {"iostat", sl_iostat},
     {NULL, NULL}
 };
 
@@ -0,0 +1,106 @@
+/*
+ * iostat.c
+ *
+ * Show the core's disk, cache and network counters, then their rates
+ * every interval until a key is pressed or the count runs out.
+ *
+ * Usage: iostat.c32 [-i seconds] [-n count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <console.h>
+#include <unistd.h>
+#include <sys/times.h>
+#include <getkey.h>
+#include <syslinux/iostat.h>
+
+static void show_totals(const struct syslinux_iostat *st)
+{
+    uint32_t lookups = st->cache_hits + st->cache_misses;
+
+    printf("disk:  %u calls, %llu sectors of %u bytes, %u errors\n",
+	   st->disk_calls, (unsigned long long)st->disk_sectors,
+	   st->sector_size, st->disk_errors);
+    printf("cache: %u hits, %u misses (%u%% hits), %u evictions\n",
+	   st->cache_hits, st->cache_misses,
+	   lookups ? (uint32_t)((uint64_t)st->cache_hits * 100 / lookups) : 0,
+	   st->cache_evictions);
+    printf("tftp:  %u timeouts, %u retransmits\n",
+	   st->tftp_timeouts, st->tftp_retransmits);
+    printf("tcp:   %llu bytes, %u ms stalled\n",
+	   (unsigned long long)st->tcp_bytes, st->tcp_stall_ms);
+}
+
+/* Per second, from the counters at a and b */
+static uint32_t rate(uint64_t a, uint64_t b, uint32_t ms)
+{
+    return ms ? (b - a) * 1000 / ms : 0;
+}
+
+static void show_rates(const struct syslinux_iostat *a,
+		       const struct syslinux_iostat *b)
+{
+    uint32_t ms = b->ms - a->ms;
+    uint32_t hits = b->cache_hits - a->cache_hits;
+    uint32_t lookups = hits + (b->cache_misses - a->cache_misses);
+
+    printf("%8u %8u %10u %5u%% %8u %6u %6u %10u %6u\n",
+	   rate(a->disk_calls, b->disk_calls, ms),
+	   rate(a->disk_sectors, b->disk_sectors, ms),
+	   rate(a->disk_sectors * a->sector_size,
+		b->disk_sectors * b->sector_size, ms) >> 10,
+	   lookups ? (uint32_t)((uint64_t)hits * 100 / lookups) : 0,
+	   rate(a->cache_evictions, b->cache_evictions, ms),
+	   b->tftp_timeouts - a->tftp_timeouts,
+	   b->tftp_retransmits - a->tftp_retransmits,
+	   rate(a->tcp_bytes, b->tcp_bytes, ms) >> 10,
+	   b->tcp_stall_ms - a->tcp_stall_ms);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: iostat.c32 [-i seconds] [-n count]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    struct syslinux_iostat a, b;
+    unsigned int interval = 1;
+    int count = -1;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+	if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+	    interval = strtoul(argv[++i], NULL, 0);
+	} else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+	    count = strtoul(argv[++i], NULL, 0);
+	} else {
+	    usage();
+	    return 1;
+	}
+    }
+    if (!interval)
+	interval = 1;
+
+    syslinux_iostat(&a);
+    show_totals(&a);
+
+    if (!count)
+	return 0;
+
+    printf("\n   calls  sectors       KB/s  cache  evict/s tftpto retran"
+	   "   tcp KB/s  stall\n");
+
+    while (count < 0 || count--) {
+	if (get_key(stdin, interval * CLK_TCK) != KEY_NONE)
+	    break;
+
+	syslinux_iostat(&b);
+	show_rates(&a, &b);
+	a = b;
+    }
+
+    return 0;
+}
@@ -44,6 +44,7 @@ static void dump_all(struct upload_backend *be, const char *argv[])
     dump_cpuid(be);
     dump_pci(be);
     dump_vesa_tables(be);
+    dump_trace(be);
 
     cpio_close(be);
     flush_data(be);
@@ -11,5 +11,6 @@ void dump_acpi(struct upload_backend *);
 void dump_cpuid(struct upload_backend *);
 void dump_pci(struct upload_backend *);
 void dump_vesa_tables(struct upload_backend *);
+void dump_trace(struct upload_backend *);
 
 #endif /* SYSDUMP_H */
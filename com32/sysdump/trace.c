@@ -0,0 +1,124 @@
+/*
+ * Dump the boot timeline, as a trace in the Chrome trace event format
+ * (chrome://tracing, Perfetto and friends read it as is)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <syslinux/trace.h>
+#include "sysdump.h"
+
+#define TRACE_CHUNK 65536
+
+struct jbuf {
+    char *buf;
+    size_t len, alloc;
+    int failed;
+};
+
+static void jprintf(struct jbuf *jb, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (jb->failed)
+	return;
+
+    for (;;) {
+	va_start(ap, fmt);
+	n = vsnprintf(jb->buf + jb->len, jb->alloc - jb->len, fmt, ap);
+	va_end(ap);
+
+	if (n >= 0 && (size_t)n < jb->alloc - jb->len)
+	    break;
+
+	jb->alloc += TRACE_CHUNK;
+	jb->buf = realloc(jb->buf, jb->alloc);
+	if (!jb->buf) {
+	    jb->failed = 1;
+	    return;
+	}
+    }
+    jb->len += n;
+}
+
+/* The names are ours, but the details are file names */
+static void jstring(struct jbuf *jb, const char *s, size_t max)
+{
+    size_t i;
+    unsigned char c;
+
+    jprintf(jb, "\"");
+    for (i = 0; i < max && (c = s[i]); i++) {
+	if (c == '"' || c == '\\')
+	    jprintf(jb, "\\%c", c);
+	else if (c < ' ' || c >= 0x7f)
+	    jprintf(jb, "\\u%04x", c);
+	else
+	    jprintf(jb, "%c", c);
+    }
+    jprintf(jb, "\"");
+}
+
+void dump_trace(struct upload_backend *be)
+{
+    struct syslinux_trace_info ti;
+    const struct syslinux_trace_event *ev;
+    struct jbuf jb;
+    uint64_t ticks_per_ms, us;
+    uint32_t i, n, first, dropped;
+
+    if (syslinux_trace_info(&ti))
+	return;
+
+    printf("Dumping boot trace... ");
+
+    /* The TSC rate, from how far both clocks have run since the start */
+    if (ti.now_ms - ti.start_ms >= 10)
+	ticks_per_ms = (ti.now_tsc - ti.start_tsc) / (ti.now_ms - ti.start_ms);
+    else
+	ticks_per_ms = 0;
+    if (!ticks_per_ms)
+	ticks_per_ms = 1000;	/* Then report the raw ticks */
+
+    n = ti.written < ti.size ? ti.written : ti.size;
+    dropped = ti.written - n;
+    first = syslinux_trace_first(&ti);
+
+    memset(&jb, 0, sizeof jb);
+    jprintf(&jb, "{\"traceEvents\":[\n");
+
+    for (i = 0; i < n; i++) {
+	ev = &ti.ring[(first + i) % ti.size];
+
+	/* The first mark can be stamped just before the start */
+	us = ev->tsc > ti.start_tsc ?
+	    (ev->tsc - ti.start_tsc) * 1000 / ticks_per_ms : 0;
+
+	jprintf(&jb, "%s{\"name\":", i ? ",\n" : "");
+	jstring(&jb, ev->name, sizeof ev->name);
+	jprintf(&jb, ",\"ph\":\"%c\",\"ts\":%llu,\"pid\":0,\"tid\":0",
+		ev->type, (unsigned long long)us);
+	if (ev->type == TRACE_MARK)
+	    jprintf(&jb, ",\"s\":\"g\"");
+	jprintf(&jb, ",\"args\":{");
+	if (ev->detail[0]) {
+	    jprintf(&jb, "\"detail\":");
+	    jstring(&jb, ev->detail, sizeof ev->detail);
+	    jprintf(&jb, ",");
+	}
+	jprintf(&jb, "\"arg\":%u}}", ev->arg);
+    }
+
+    jprintf(&jb, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{"
+	    "\"tsc_per_ms\":\"%llu\",\"events\":\"%u\",\"dropped\":\"%u\"}}\n",
+	    (unsigned long long)ticks_per_ms, ti.written, dropped);
+
+    if (!jb.failed)
+	cpio_writefile(be, "trace.json", jb.buf, jb.len);
+    free(jb.buf);
+
+    printf("done.\n");
+}
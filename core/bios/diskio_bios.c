@@ -2,9 +2,12 @@
 #include <com32.h>
 #include <fs.h>
 #include <ilog2.h>
+#include <x86/cpu.h>
 
 #define RETRY_COUNT 6
 
+static unsigned int hard_max_transfer;	/* What the interface allows */
+
 static inline sector_t chs_max(const struct disk *disk)
 {
     return (sector_t)disk->secpercyl << 10;
@@ -15,8 +18,18 @@ struct edd_rdwr_packet {
     uint16_t blocks;
     far_ptr_t buf;
     uint64_t lba;
+    uint64_t buf64;		/* EDD 3.0, if buf is FFFF:FFFF */
 };
 
+#define EDD_PKT_SIZE	16	/* Without buf64 */
+
+/*
+ * Can the BIOS take a 64-bit flat buffer address, and so read straight
+ * into high memory: 1 = yes, 0 = it says so but we haven't tried yet,
+ * -1 = no.
+ */
+static int8_t edd_flat = -1;
+
 struct edd_disk_params {
     uint16_t  len;
     uint16_t  flags;
@@ -58,6 +71,8 @@ static int chs_rdwr_sectors(struct disk *disk, void *buf,
     int retry;
     uint32_t maxtransfer = disk->maxtransfer;
 
+    disk->io_calls++;
+
     if (lba + disk->part_start >= chs_max(disk))
 	return 0;		/* Impossible CHS request */
 
@@ -119,6 +134,7 @@ static int chs_rdwr_sectors(struct disk *disk, void *buf,
 		    break;
 
 		dprintf("CHS: error AX = %04x\n", oreg.eax.w[0]);
+		disk->io_errors++;
 
 		if (retry--)
 		    continue;
@@ -150,6 +166,7 @@ static int chs_rdwr_sectors(struct disk *disk, void *buf,
 
 	/* If we dropped maxtransfer, it eventually worked, so remember it */
 	disk->maxtransfer = maxtransfer;
+	disk->io_sectors += chunk;
 
 	ptr   += bytes;
 	xlba  += chunk;
@@ -160,6 +177,74 @@ static int chs_rdwr_sectors(struct disk *disk, void *buf,
     return done;
 }
 
+/* Read one sector, to a 64-bit address if flat */
+static bool edd_read_one(struct disk *disk, sector_t lba, void *buf,
+			 bool flat)
+{
+    static __lowmem struct edd_rdwr_packet pkt;
+    com32sys_t ireg, oreg;
+
+    memset(&ireg, 0, sizeof ireg);
+    ireg.eax.b[1] = 0x42;
+    ireg.edx.b[0] = disk->disk_number;
+    ireg.ds       = SEG(&pkt);
+    ireg.esi.w[0] = OFFS(&pkt);
+
+    pkt.blocks = 1;
+    pkt.lba    = lba;
+    if (flat) {
+	pkt.size    = sizeof pkt;
+	pkt.buf.ptr = 0xffffffff;
+	pkt.buf64   = (size_t)buf;
+    } else {
+	pkt.size    = EDD_PKT_SIZE;
+	pkt.buf     = FAR_PTR(buf);
+    }
+
+    __intcall(0x13, &ireg, &oreg);
+
+    return !(oreg.eflags.l & EFLAGS_CF);
+}
+
+/*
+ * Before the first 64-bit transfer, one sector is read to a 64-bit
+ * address and checked against the same sector read through the
+ * bounce buffer.  A BIOS that claims EDD 3.0 but ignores the address
+ * writes to FFFF:FFFF instead, linear 0x10ffef with A20 on, so what
+ * is there is kept aside and put back afterwards.
+ */
+static void edd_flat_probe(struct disk *disk, sector_t lba)
+{
+    size_t size = disk->sector_size;
+    char *trap = (char *)0x10ffef;
+    char *save = core_xfer_buf + size;
+    char *probe;
+    size_t i;
+
+    edd_flat = -1;
+
+    probe = malloc(size);
+    if (!probe)
+	return;
+
+    if (edd_read_one(disk, lba, core_xfer_buf, false)) {
+	/* Every byte starts out wrong, so any the BIOS skips shows */
+	for (i = 0; i < size; i++)
+	    probe[i] = ~core_xfer_buf[i];
+
+	memcpy(save, trap, size);
+	if (edd_read_one(disk, lba, probe, true) &&
+	    !memcmp(probe, core_xfer_buf, size))
+	    edd_flat = 1;
+	memcpy(trap, save, size);
+    }
+
+    free(probe);
+
+    dprintf("EDD: 64-bit addresses %s\n",
+	    edd_flat > 0 ? "work" : "don't work");
+}
+
 static int edd_rdwr_sectors(struct disk *disk, void *buf,
 			    sector_t lba, size_t count, bool is_write)
 {
@@ -174,6 +259,8 @@ static int edd_rdwr_sectors(struct disk *disk, void *buf,
     int retry;
     uint32_t maxtransfer = disk->maxtransfer;
 
+    disk->io_calls++;
+
     memset(&ireg, 0, sizeof ireg);
 
     ireg.eax.b[1] = 0x42 + is_write;
@@ -195,25 +282,40 @@ static int edd_rdwr_sectors(struct disk *disk, void *buf,
 	    /* Can do a direct load */
 	    tptr = ptr;
 	} else {
-	    /* Either accessing high memory or we're crossing a 64K line */
-	    tptr = core_xfer_buf;
-	    freeseg = (0x10000 - ((size_t)tptr & 0xffff)) >> sector_shift;
+	    if (!edd_flat)
+		edd_flat_probe(disk, lba);
+
+	    if (edd_flat > 0) {
+		/* Straight to a 64-bit address, wherever it is */
+		tptr = NULL;
+		freeseg = chunk;
+	    } else {
+		/* Either accessing high memory or we're crossing a 64K line */
+		tptr = core_xfer_buf;
+		freeseg = (0x10000 - ((size_t)tptr & 0xffff)) >> sector_shift;
+	    }
 	}
 	if (chunk > freeseg)
 	    chunk = freeseg;
 
 	bytes = chunk << sector_shift;
 
-	if (tptr != ptr && is_write)
+	if (tptr && tptr != ptr && is_write)
 	    memcpy(tptr, ptr, bytes);
 
 	retry = RETRY_COUNT;
 
 	for (;;) {
-	    pkt.size   = sizeof pkt;
 	    pkt.blocks = chunk;
-	    pkt.buf    = FAR_PTR(tptr);
 	    pkt.lba    = lba;
+	    if (tptr) {
+		pkt.size    = EDD_PKT_SIZE;
+		pkt.buf     = FAR_PTR(tptr);
+	    } else {
+		pkt.size    = sizeof pkt;
+		pkt.buf.ptr = 0xffffffff;
+		pkt.buf64   = (size_t)ptr;
+	    }
 
 	    dprintf("EDD[%02x]: %u @ %llu %04x:%04x %s %p\n",
 		    ireg.edx.b[0], pkt.blocks, pkt.lba,
@@ -226,6 +328,7 @@ static int edd_rdwr_sectors(struct disk *disk, void *buf,
 		break;
 
 	    dprintf("EDD: error AX = %04x\n", oreg.eax.w[0]);
+	    disk->io_errors++;
 
 	    if (retry--)
 		continue;
@@ -254,10 +357,12 @@ static int edd_rdwr_sectors(struct disk *disk, void *buf,
 	     *
 	     * Try to fall back to CHS.  If the LBA is absurd, the
 	     * chs_max() test in chs_rdwr_sectors() will catch it.
+	     * That counts as the same call, not another one.
 	     */
+	    disk->io_calls--;
 	    done = chs_rdwr_sectors(disk, buf, lba - disk->part_start,
 				    count, is_write);
-	    if (done == (count << sector_shift)) {
+	    if (done == count) {
 		/* Successful, assume this is a CHS disk */
 		disk->rdwr_sectors = chs_rdwr_sectors;
 		return done;
@@ -271,11 +376,12 @@ static int edd_rdwr_sectors(struct disk *disk, void *buf,
 
 	bytes = chunk << sector_shift;
 
-	if (tptr != ptr && !is_write)
+	if (tptr && tptr != ptr && !is_write)
 	    memcpy(ptr, tptr, bytes);
 
 	/* If we dropped maxtransfer, it eventually worked, so remember it */
 	disk->maxtransfer = maxtransfer;
+	disk->io_sectors += chunk;
 
 	ptr   += bytes;
 	lba   += chunk;
@@ -300,7 +406,6 @@ struct disk *bios_disk_init(void *private)
     uint32_t MaxTransfer = regs->ebp.l;
     bool ebios;
     int sector_size;
-    unsigned int hard_max_transfer;
 
     memset(&ireg, 0, sizeof ireg);
     ireg.edx.b[0] = devno;
@@ -348,6 +453,10 @@ struct disk *bios_disk_init(void *private)
 	    ebios = true;
 	    hard_max_transfer = 127;
 
+	    /* EDD 3.0 with the 64-bit extensions: try them on first use */
+	    if (oreg.eax.b[1] >= 0x30 && (oreg.ecx.b[0] & 8))
+		edd_flat = 0;
+
 	    /* Query EBIOS parameters */
 	    /* The memset() is needed once this function can be called
 	       more than once */
@@ -394,6 +503,134 @@ struct disk *bios_disk_init(void *private)
     return &disk;
 }
 
+static struct disk *boot_disk(void)
+{
+    struct device *dev = this_fs ? this_fs->fs_dev : NULL;
+
+    return dev ? dev->disk : NULL;
+}
+
+/*
+ * The MAXTRANSFER directive: use at most this many sectors per
+ * request, up to what the interface allows.  Returns the new limit,
+ * or 0 if we didn't boot from a disk.
+ */
+__export unsigned int bios_disk_set_maxtransfer(unsigned int sectors)
+{
+    struct disk *disk = boot_disk();
+
+    if (!disk)
+	return 0;
+
+    if (!sectors || sectors > hard_max_transfer)
+	sectors = hard_max_transfer;
+
+    disk->maxtransfer = sectors;
+    return sectors;
+}
+
+/* Sizes tried by the probe, besides the interface limit */
+static const uint8_t probe_sizes[] = { 8, 16, 32, 64 };
+
+#define PROBE_BYTES	(128 << 10)	/* Read at each size */
+
+/*
+ * Time a read of PROBE_BYTES at the given size, at lba; 0 if the
+ * read failed, or the drivers had to retry or cut the size down.
+ */
+static uint64_t probe_read(struct disk *disk, void *buf, sector_t lba,
+			   unsigned int sectors)
+{
+    size_t count = PROBE_BYTES >> disk->sector_shift;
+    uint32_t errors = disk->io_errors;
+    uint64_t tsc;
+
+    disk->maxtransfer = sectors;
+    tsc = rdtsc();
+    if (disk->rdwr_sectors(disk, buf, lba, count, false) != (int)count)
+	return 0;
+    tsc = rdtsc() - tsc;
+
+    if (disk->io_errors != errors || disk->maxtransfer != sectors)
+	return 0;
+
+    return tsc ? tsc : 1;
+}
+
+/*
+ * MAXTRANSFER PROBE: read the start of the boot partition at each
+ * size in turn, a fresh stretch every time so the drive's own cache
+ * doesn't flatter anyone, and keep the fastest size that went through
+ * cleanly.  The current size stays unless another one beats it by
+ * more than 1/16.  Returns the limit chosen, 0 if we couldn't probe.
+ */
+__export unsigned int bios_disk_probe_maxtransfer(void)
+{
+    struct disk *disk = boot_disk();
+    unsigned int sizes[sizeof probe_sizes + 1];
+    unsigned int cur, best, i, n;
+    uint64_t t, best_t;
+    size_t count;
+    sector_t lba;
+    void *buf;
+
+    if (!disk)
+	return 0;
+
+    /* CPUID level 1, EDX bit 4: the TSC */
+    if (!cpu_has_eflag(EFLAGS_ID) || !(cpuid_edx(1) & (1 << 4)))
+	return 0;
+
+    buf = malloc(PROBE_BYTES);
+    if (!buf)
+	return 0;
+
+    cur = disk->maxtransfer;
+    count = PROBE_BYTES >> disk->sector_shift;
+
+    n = 0;
+    sizes[n++] = cur;
+    for (i = 0; i < sizeof probe_sizes; i++) {
+	if (probe_sizes[i] < hard_max_transfer && probe_sizes[i] != cur)
+	    sizes[n++] = probe_sizes[i];
+    }
+    if (cur != hard_max_transfer)
+	sizes[n++] = hard_max_transfer;
+
+    /* Spin the drive up and seek there first, at the known good size */
+    lba = 0;
+    probe_read(disk, buf, lba, cur);
+    lba += count;
+
+    best = cur;
+    best_t = 0;
+    for (i = 0; i < n; i++) {
+	t = probe_read(disk, buf, lba, sizes[i]);
+	lba += count;
+
+	dprintf("maxtransfer %u: %llu\n", sizes[i], t);
+
+	if (!t)
+	    continue;		/* Not safe */
+	if (!best_t) {
+	    best = sizes[i];
+	    best_t = t;
+	} else if (t < best_t - (best_t >> 4) ||
+		   (best != cur && t < best_t)) {
+	    best = sizes[i];
+	    best_t = t;
+	}
+    }
+
+    free(buf);
+
+    if (!best_t)
+	best = cur;		/* Nothing worked cleanly; leave it be */
+
+    disk->maxtransfer = best;
+    return best_t ? best : 0;
+}
+
 void pm_fs_init(com32sys_t *regs)
 {
 	static struct bios_disk_private priv;
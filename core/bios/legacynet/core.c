@@ -33,6 +33,23 @@ int core_udp_open(struct pxe_pvt_inode *socket __unused)
     return 0;
 }
 
+/**
+ * Open a socket receiving from a multicast group
+ *
+ * @param:socket, the socket to open
+ * @param:group, the multicast group address
+ * @param:port, the port number to receive on, host-byte order
+ *
+ * @out: error code, 0 on success, -1 on failure
+ *
+ * Multicast reception is not supported through the PXE UDP API; callers fall back to unicast.
+ */
+int core_udp_open_group(struct pxe_pvt_inode *socket __unused,
+			uint32_t group __unused, uint16_t port __unused)
+{
+    return -1;
+}
+
 /**
  * Close a socket
  *
@@ -201,6 +218,18 @@ void net_core_init(void)
     }
 }
 
+/**
+ * Run func on each of args concurrently
+ *
+ * @out: -1, since the PXE UDP API has a single socket and nothing
+ * can overlap; nothing is run.
+ */
+int net_core_parallel(void (*func)(void *) __unused, void **args __unused,
+		      int count __unused)
+{
+    return -1;
+}
+
 void probe_undi(void)
 {
 }
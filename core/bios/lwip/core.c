@@ -2,8 +2,11 @@
 #include <lwip/api.h>
 #include <lwip/tcpip.h>
 #include <lwip/dns.h>
+#include <lwip/memp.h>
+#include <lwip/tcp_impl.h>
 #include <core.h>
 #include <net.h>
+#include "thread.h"
 #include "core_pxe.h"
 
 #include <dprintf.h>
@@ -41,6 +44,50 @@ int core_udp_open(struct pxe_pvt_inode *socket)
     return 0;
 }
 
+/**
+ * Open a socket receiving from a multicast group
+ *
+ * @param:socket, the socket to open
+ * @param:group, the multicast group address
+ * @param:port, the port number to receive on, host-byte order
+ *
+ * @out: error code, 0 on success, -1 on failure
+ */
+int core_udp_open_group(struct pxe_pvt_inode *socket, uint32_t group,
+			uint16_t port)
+{
+    struct net_private_lwip *priv = &socket->net.lwip;
+    struct ip_addr addr;
+    int err;
+
+    priv->conn = netconn_new(NETCONN_UDP);
+    if (!priv->conn)
+	return -1;
+
+    priv->conn->recv_timeout = 15;
+    err = netconn_bind(priv->conn, NULL, port);
+    if (err) {
+	ddprintf("netconn_bind error %d\n", err);
+	goto bail;
+    }
+
+    addr.addr = group;
+    err = netconn_join_leave_group(priv->conn, &addr, IP_ADDR_ANY,
+				   NETCONN_JOIN);
+    if (err) {
+	ddprintf("netconn_join_leave_group error %d\n", err);
+	goto bail;
+    }
+
+    priv->group = group;
+    return 0;
+
+bail:
+    netconn_delete(priv->conn);
+    priv->conn = NULL;
+    return -1;
+}
+
 /**
  * Close a socket
  *
@@ -49,8 +96,15 @@ int core_udp_open(struct pxe_pvt_inode *socket)
 void core_udp_close(struct pxe_pvt_inode *socket)
 {
     struct net_private_lwip *priv = &socket->net.lwip;
+    struct ip_addr addr;
 
     if (priv->conn) {
+	if (priv->group) {
+	    addr.addr = priv->group;
+	    netconn_join_leave_group(priv->conn, &addr, IP_ADDR_ANY,
+				     NETCONN_LEAVE);
+	    priv->group = 0;
+	}
 	netconn_delete(priv->conn);
 	priv->conn = NULL;
     }
@@ -208,6 +262,31 @@ out:
     netbuf_delete(nbuf);
 }
 
+/*
+ * Grow the pbuf and TCP segment pools so that a full receive window
+ * can be held, as far as 1/16 of high memory allows.  The pools built
+ * into lwIP only cover a few unscaled windows.
+ */
+static void net_grow_pools(void)
+{
+    const size_t pbuf_size = PBUF_POOL_BUFSIZE + sizeof(struct pbuf) +
+	sizeof(struct tcp_seg) + 2*MEM_ALIGNMENT;
+    size_t budget = __com32.cs_memsize >> 4;
+    size_t want = TCP_WND / TCP_MSS + 1;
+    unsigned int npbuf, nseg;
+
+    if (want * pbuf_size > budget)
+	want = budget / pbuf_size;
+    if (want > 0xffff)
+	want = 0xffff;
+
+    npbuf = memp_grow(MEMP_PBUF_POOL, want);
+    nseg = memp_grow(MEMP_TCP_SEG, want);
+
+    dprintf("net: %u pbufs, %u TCP segments\n",
+	    PBUF_POOL_SIZE + npbuf, MEMP_NUM_TCP_SEG + nseg);
+}
+
 /**
  * Network stack-specific initialization
  */
@@ -220,6 +299,7 @@ void net_core_init(void)
 
     /* Initialize lwip */
     tcpip_init(NULL, NULL);
+    net_grow_pools();
 
     /* Start up the undi driver for lwip */
     err = undiif_start(IPInfo.myip, IPInfo.netmask, IPInfo.gateway);
@@ -234,6 +314,61 @@ void net_core_init(void)
     }
 }
 
+/*
+ * Each job runs on a thread of its own, so that one waiting for the
+ * network doesn't hold up the others.
+ */
+#define PARALLEL_STACK_SIZE	32768
+
+struct parallel_job {
+    void (*func)(void *);
+    void *arg;
+    struct semaphore *done;
+};
+
+static void parallel_thread(void *data)
+{
+    struct parallel_job *job = data;
+
+    job->func(job->arg);
+    sem_up(job->done);
+}
+
+/**
+ * Run func on each of args concurrently, and wait for them all
+ *
+ * @out: 0
+ */
+int net_core_parallel(void (*func)(void *), void **args, int count)
+{
+    DECLARE_INIT_SEMAPHORE(done, 0);
+    struct parallel_job *jobs;
+    int started = 0;
+    int i;
+
+    jobs = malloc(count * sizeof *jobs);
+
+    for (i = 0; i < count; i++) {
+	if (jobs) {
+	    jobs[i].func = func;
+	    jobs[i].arg = args[i];
+	    jobs[i].done = &done;
+	    if (start_thread("net parallel", PARALLEL_STACK_SIZE, 0,
+			     parallel_thread, &jobs[i])) {
+		started++;
+		continue;
+	    }
+	}
+	func(args[i]);		/* No thread; do it here */
+    }
+
+    while (started--)
+	sem_down(&done, 0);
+
+    free(jobs);
+    return 0;
+}
+
 void probe_undi(void)
 {
     /* Probe UNDI information */
@@ -322,7 +457,10 @@ void core_tcp_fill_buffer(struct inode *inode)
     }
     /* If needed get a new netbuf */
     if (!socket->net.lwip.buf) {
+	mstime_t t0 = ms_timer();
+
 	err = netconn_recv(socket->net.lwip.conn, &(socket->net.lwip.buf));
+	net_iostat.tcp_stall_ms += ms_timer() - t0;
 	if (!socket->net.lwip.buf || err) {
 	    socket->tftp_goteof = 1;
 	    if (inode->size == -1)
@@ -337,6 +475,7 @@ void core_tcp_fill_buffer(struct inode *inode)
 	printf("netbuf_data err: %d\n", err);
 	kaboom();
     }
+    net_iostat.tcp_bytes += len;
     socket->tftp_dataptr = data;
     socket->tftp_filepos += len;
     socket->tftp_bytesleft = len;
@@ -26,6 +26,24 @@ static struct thread *pxe_thread, *poll_thread;
 #  define PXE_POLL_BY_MODEL 1
 #endif
 
+/*
+ * Frames copied out of the UNDI before any of them is handed to the
+ * stack.  A pass which fills the batch means the link is busy; the
+ * receive thread then keeps polling instead of waiting for the next
+ * interrupt.
+ */
+#define PXE_RX_BATCH	32
+
+/*
+ * Empty polls before the poll thread starts backing off, and the
+ * longest pause between polls, in cpu_relax() units.
+ */
+#define PXE_POLL_IDLE		64
+#define PXE_POLL_MAX_DELAY	1024
+
+struct pxe_rx_stats pxe_rx_stats, pxe_rx_rate;
+extern volatile uint32_t pxe_irq_count;
+
 /*
  * Note: this *must* be called with interrupts enabled.
  */
@@ -118,6 +136,36 @@ static bool uninstall_irq_vector(uint8_t irq, void (*isr), far_ptr_t *old)
     return rv;
 }
 
+/*
+ * Roll the receive counters over into pxe_rx_rate once a second.
+ */
+static void pxe_rx_stats_tick(void)
+{
+    static struct pxe_rx_stats last;
+    static mstime_t last_ms;
+    mstime_t now = ms_timer();
+
+    if (now - last_ms < 1000)
+	return;
+    last_ms = now;
+
+    pxe_rx_stats.irqs = pxe_irq_count;
+
+    pxe_rx_rate.packets = pxe_rx_stats.packets - last.packets;
+    pxe_rx_rate.bytes   = pxe_rx_stats.bytes - last.bytes;
+    pxe_rx_rate.thunks  = pxe_rx_stats.thunks - last.thunks;
+    pxe_rx_rate.drops   = pxe_rx_stats.drops - last.drops;
+    pxe_rx_rate.irqs    = pxe_rx_stats.irqs - last.irqs;
+    pxe_rx_rate.polls   = pxe_rx_stats.polls - last.polls;
+    last = pxe_rx_stats;
+
+    if (pxe_rx_rate.packets)
+	dprintf("UNDI rx/s: %u packets, %u bytes, %u thunks, %u drops, "
+		"%u irqs, %u polls\n",
+		pxe_rx_rate.packets, pxe_rx_rate.bytes, pxe_rx_rate.thunks,
+		pxe_rx_rate.drops, pxe_rx_rate.irqs, pxe_rx_rate.polls);
+}
+
 static void pxe_poll_wakeups(void)
 {
     static jiffies_t last_jiffies = 0;
@@ -132,6 +180,7 @@ static void pxe_poll_wakeups(void)
     if (now != last_jiffies) {
 	last_jiffies = now;
 	__thread_process_timeouts();
+	pxe_rx_stats_tick();
     }
 
     if (pxe_irq_pending) {
@@ -140,11 +189,22 @@ static void pxe_poll_wakeups(void)
     }
 }
 
-static void pxe_process_irq(void)
+/*
+ * Drain the UNDI of every frame it has, then hand them to the stack.
+ * Each frame still costs one PXENV_UNDI_ISR call, since that is all
+ * the UNDI API offers, but the frames are copied out back to back and
+ * the UNDI gets its interrupt re-enabled as early as possible.
+ *
+ * Returns the number of frames received.
+ */
+static unsigned int pxe_process_irq(void)
 {
     static __lowmem t_PXENV_UNDI_ISR isr;
+    static struct pbuf *batch[PXE_RX_BATCH];
+    static uint8_t prot[PXE_RX_BATCH];
 
     uint16_t func = PXENV_UNDI_ISR_IN_PROCESS; /* First time */
+    unsigned int i, n = 0, total = 0;
     bool done = false;
 
     while (!done) {
@@ -153,6 +213,7 @@ static void pxe_process_irq(void)
         func = PXENV_UNDI_ISR_IN_GET_NEXT; /* Next time */
 
         pxe_call(PXENV_UNDI_ISR, &isr);
+	pxe_rx_stats.thunks++;
 
         switch (isr.FuncFlag) {
         case PXENV_UNDI_ISR_OUT_DONE:
@@ -164,7 +225,20 @@ static void pxe_process_irq(void)
 	    break;
 
         case PXENV_UNDI_ISR_OUT_RECEIVE:
-	    undiif_input(&isr);
+	    batch[n] = undiif_receive(&isr, &prot[n]);
+	    if (!batch[n]) {
+		pxe_rx_stats.drops++;
+		break;
+	    }
+	    total++;
+	    if (++n < PXE_RX_BATCH)
+		break;
+
+	    /* Batch full; pass it on and carry on draining */
+	    for (i = 0; i < n; i++)
+		if (undiif_deliver(batch[i], prot[i]))
+		    pxe_rx_stats.drops++;
+	    n = 0;
 	    break;
 
         case PXENV_UNDI_ISR_OUT_BUSY:
@@ -178,16 +252,12 @@ static void pxe_process_irq(void)
 	    break;
         }
     }
-}
 
-static void pxe_receive_thread(void *dummy)
-{
-    (void)dummy;
+    for (i = 0; i < n; i++)
+	if (undiif_deliver(batch[i], prot[i]))
+	    pxe_rx_stats.drops++;
 
-    for (;;) {
-	sem_down(&pxe_receive_thread_sem, 0);
-	pxe_process_irq();
-    }
+    return total;
 }
 
 static bool pxe_isr_poll(void)
@@ -196,12 +266,43 @@ static bool pxe_isr_poll(void)
 
     isr.FuncFlag = PXENV_UNDI_ISR_IN_START;
     pxe_call(PXENV_UNDI_ISR, &isr);
+    pxe_rx_stats.thunks++;
 
-    return isr.FuncFlag == PXENV_UNDI_ISR_OUT_OURS;
+    if (isr.FuncFlag != PXENV_UNDI_ISR_OUT_OURS)
+	return false;
+
+    pxe_rx_stats.polls++;
+    return true;
+}
+
+static void pxe_receive_thread(void *dummy)
+{
+    bool more;
+
+    (void)dummy;
+
+    for (;;) {
+	sem_down(&pxe_receive_thread_sem, 0);
+
+	/*
+	 * While frames come in faster than one batch per pass, poll for
+	 * the next lot straight away instead of waiting for an interrupt.
+	 */
+	do {
+	    if (pxe_process_irq() < PXE_RX_BATCH)
+		break;
+	    __schedule();	/* Let the stack consume the batch */
+	    cli();
+	    more = pxe_isr_poll();
+	    sti();
+	} while (more);
+    }
 }
 
 static void pxe_poll_thread(void *dummy)
 {
+    unsigned int idle = 0, delay = 1, i;
+
     (void)dummy;
 
     /* Block indefinitely unless activated */
@@ -209,12 +310,22 @@ static void pxe_poll_thread(void *dummy)
 
     for (;;) {
 	cli();
-	if (pxe_receive_thread_sem.count < 0 && pxe_isr_poll())
+	if (pxe_receive_thread_sem.count < 0 && pxe_isr_poll()) {
 	    sem_up(&pxe_receive_thread_sem);
-	else
+	    idle = 0;
+	    delay = 1;
+	} else {
 	    __schedule();
+	    /*
+	     * Every poll is a trip to real mode; when nothing has come
+	     * in for a while, poll less and less often.
+	     */
+	    if (++idle > PXE_POLL_IDLE && delay < PXE_POLL_MAX_DELAY)
+		delay <<= 1;
+	}
 	sti();
-	cpu_relax();
+	for (i = 0; i < delay; i++)
+	    cpu_relax();
     }
 }
 
@@ -373,6 +373,50 @@ memp_init(void)
 #endif /* MEMP_OVERFLOW_CHECK */
 }
 
+#if MEMP_GROW
+/**
+ * Add elements to a pool at run time, for when the memory that can be
+ * spared is only known once the system is up.  The elements come from
+ * one block obtained with MEMP_GROW_ALLOC() and are never given back.
+ *
+ * @param type the pool to grow
+ * @param num the number of elements to add
+ * @return the number of elements added (0 if the allocation failed)
+ */
+u16_t
+memp_grow(memp_t type, u16_t num)
+{
+  struct memp *memp;
+  u8_t *block;
+  u16_t j;
+  SYS_ARCH_DECL_PROTECT(old_level);
+
+  LWIP_ERROR("memp_grow: type < MEMP_MAX", (type < MEMP_MAX), return 0;);
+
+  if (num == 0) {
+    return 0;
+  }
+  block = (u8_t *)MEMP_GROW_ALLOC(MEM_ALIGNMENT - 1 +
+                                  (size_t)num * (MEMP_SIZE + memp_sizes[type]));
+  if (block == NULL) {
+    LWIP_DEBUGF(MEMP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ("memp_grow: no memory for %"U16_F" more in pool %s\n", num, memp_desc[type]));
+    return 0;
+  }
+
+  memp = (struct memp *)LWIP_MEM_ALIGN(block);
+  SYS_ARCH_PROTECT(old_level);
+  for (j = 0; j < num; ++j) {
+    memp->next = memp_tab[type];
+    memp_tab[type] = memp;
+    memp = (struct memp *)(void *)((u8_t *)memp + MEMP_SIZE + memp_sizes[type]);
+  }
+  MEMP_STATS_AVAIL(avail, type, lwip_stats.memp[type].avail + num);
+  SYS_ARCH_UNPROTECT(old_level);
+
+  return num;
+}
+#endif /* MEMP_GROW */
+
 /**
  * Get an element from a specific pool.
  *
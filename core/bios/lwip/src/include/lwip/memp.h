@@ -98,6 +98,9 @@ struct memp_malloc_helper
 #endif /* MEM_USE_POOLS */
 
 void  memp_init(void);
+#if MEMP_GROW
+u16_t memp_grow(memp_t type, u16_t num);
+#endif /* MEMP_GROW */
 
 #if MEMP_OVERFLOW_CHECK
 void *memp_malloc_fn(memp_t type, const char* file, const int line);
@@ -412,6 +412,18 @@
 #define PBUF_POOL_SIZE                  16
 #endif
 
+/**
+ * MEMP_GROW==1: provide memp_grow(), which adds elements to a pool at
+ * run time.  MEMP_GROW_ALLOC(size) gets the memory for them; it is
+ * never freed.  The sizes above are then only the minimum.
+ */
+#ifndef MEMP_GROW
+#define MEMP_GROW                       0
+#endif
+#ifndef MEMP_GROW_ALLOC
+#define MEMP_GROW_ALLOC(size)           mem_malloc(size)
+#endif
+
 /*
    ---------------------------------
    ---------- ARP options ----------
@@ -899,6 +911,28 @@
 #define TCP_WND                         (4 * TCP_MSS)
 #endif 
 
+/**
+ * LWIP_WND_SCALE==1: support the TCP window scale option (RFC 1323).
+ * TCP_RCV_SCALE is the shift count announced for the receive window,
+ * in the range 0..14; TCP_WND may then be up to (0xffff << TCP_RCV_SCALE).
+ */
+#ifndef LWIP_WND_SCALE
+#define LWIP_WND_SCALE                  0
+#endif
+#ifndef TCP_RCV_SCALE
+#define TCP_RCV_SCALE                   0
+#endif
+
+/**
+ * LWIP_TCP_SACK==1: offer selective acknowledgements (RFC 2018) and,
+ * when the peer agrees, report out-of-sequence data held in the ooseq
+ * queue with SACK blocks in our ACKs.  Received SACK blocks are not
+ * used for retransmission.  Requires TCP_QUEUE_OOSEQ.
+ */
+#ifndef LWIP_TCP_SACK
+#define LWIP_TCP_SACK                   0
+#endif
+
 /**
  * TCP_MAXRTX: Maximum number of retransmissions of data segments.
  */
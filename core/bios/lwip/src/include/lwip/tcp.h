@@ -124,6 +124,28 @@ typedef void  (*tcp_err_fn)(void *arg, err_t err);
  */
 typedef err_t (*tcp_connected_fn)(void *arg, struct tcp_pcb *tpcb, err_t err);
 
+#if LWIP_WND_SCALE
+typedef u32_t tcpwnd_size_t;
+#define TCPWNDSIZE_F            U32_F
+/* Window sizes as they go on the wire, and back */
+#define RCV_WND_SCALE(pcb, wnd) (((pcb)->opts & TF_WND_SCALE) ? \
+                                 ((wnd) >> (pcb)->rcv_scale) : (wnd))
+#define SND_WND_SCALE(pcb, wnd) (((pcb)->opts & TF_WND_SCALE) ? \
+                                 ((tcpwnd_size_t)(wnd) << (pcb)->snd_scale) : \
+                                 (tcpwnd_size_t)(wnd))
+#define TCPWND16(x)             ((u16_t)LWIP_MIN((x), 0xFFFF))
+/* The largest receive window; without scaling, it must fit the header */
+#define TCP_WND_MAX(pcb)        ((tcpwnd_size_t)(((pcb)->opts & TF_WND_SCALE) ? \
+                                 TCP_WND : TCPWND16(TCP_WND)))
+#else /* LWIP_WND_SCALE */
+typedef u16_t tcpwnd_size_t;
+#define TCPWNDSIZE_F            U16_F
+#define RCV_WND_SCALE(pcb, wnd) (wnd)
+#define SND_WND_SCALE(pcb, wnd) (wnd)
+#define TCPWND16(x)             (x)
+#define TCP_WND_MAX(pcb)        TCP_WND
+#endif /* LWIP_WND_SCALE */
+
 enum tcp_state {
   CLOSED      = 0,
   LISTEN      = 1,
@@ -185,13 +207,26 @@ struct tcp_pcb {
 #define TF_NODELAY     ((u8_t)0x40U)   /* Disable Nagle algorithm */
 #define TF_NAGLEMEMERR ((u8_t)0x80U)   /* nagle enabled, memerr, try to output to prevent delayed ACK to happen */
 
+#if LWIP_WND_SCALE || LWIP_TCP_SACK
+  u8_t opts;     /* options agreed on in the SYN exchange */
+#define TF_WND_SCALE   ((u8_t)0x01U)   /* Window scale option enabled */
+#define TF_SACK        ((u8_t)0x02U)   /* SACK option enabled */
+#endif /* LWIP_WND_SCALE || LWIP_TCP_SACK */
+#if LWIP_WND_SCALE
+  u8_t snd_scale;  /* shift count for windows received */
+  u8_t rcv_scale;  /* shift count for windows sent */
+#endif /* LWIP_WND_SCALE */
+
   /* the rest of the fields are in host byte order
      as we have to do some math with them */
   /* receiver variables */
   u32_t rcv_nxt;   /* next seqno expected */
-  u16_t rcv_wnd;   /* receiver window available */
-  u16_t rcv_ann_wnd; /* receiver window to announce */
+  tcpwnd_size_t rcv_wnd;   /* receiver window available */
+  tcpwnd_size_t rcv_ann_wnd; /* receiver window to announce */
   u32_t rcv_ann_right_edge; /* announced right edge of window */
+#if LWIP_TCP_SACK
+  u32_t sack_recent; /* seqno of the latest out-of-sequence segment */
+#endif /* LWIP_TCP_SACK */
 
   /* Timers */
   u32_t tmr;
@@ -215,19 +250,19 @@ struct tcp_pcb {
   u8_t dupacks;
   
   /* congestion avoidance/control variables */
-  u16_t cwnd;  
-  u16_t ssthresh;
+  tcpwnd_size_t cwnd;
+  tcpwnd_size_t ssthresh;
 
   /* sender variables */
   u32_t snd_nxt;   /* next new seqno to be sent */
-  u16_t snd_wnd;   /* sender window */
+  tcpwnd_size_t snd_wnd;   /* sender window */
   u32_t snd_wl1, snd_wl2; /* Sequence and acknowledgement numbers of last
                              window update. */
   u32_t snd_lbb;       /* Sequence number of next byte to be buffered. */
 
-  u16_t acked;
+  tcpwnd_size_t acked;
   
-  u16_t snd_buf;   /* Available buffer space for sending (in bytes). */
+  tcpwnd_size_t snd_buf;   /* Available buffer space for sending (in bytes). */
 #define TCP_SNDQUEUELEN_OVERFLOW (0xffffU-3)
   u16_t snd_queuelen; /* Available buffer space for sending (in tcp_segs). */
 
@@ -321,7 +356,7 @@ void             tcp_poll    (struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interv
 void             tcp_err     (struct tcp_pcb *pcb, tcp_err_fn err);
 
 #define          tcp_mss(pcb)             (((pcb)->flags & TF_TIMESTAMP) ? ((pcb)->mss - 12)  : (pcb)->mss)
-#define          tcp_sndbuf(pcb)          ((pcb)->snd_buf)
+#define          tcp_sndbuf(pcb)          (TCPWND16((pcb)->snd_buf))
 #define          tcp_sndqueuelen(pcb)     ((pcb)->snd_queuelen)
 #define          tcp_nagle_disable(pcb)   ((pcb)->flags |= TF_NODELAY)
 #define          tcp_nagle_enable(pcb)    ((pcb)->flags &= ~TF_NODELAY)
@@ -2,6 +2,7 @@
 #define __LWIPOPTS_H__
 
 #include <byteswap.h>
+#include <stdlib.h>
 #include <netinet/in.h>
 
 #define SYS_LIGHTWEIGHT_PROT	1
@@ -11,13 +12,16 @@
 #define LWIP_TCP		1
 #define LWIP_SO_RCVTIMEO	1
 #define LWIP_ICMP		1
+#define LWIP_IGMP		1
+/* Only used to spread out IGMP reports; the millisecond timer will do */
+#define LWIP_RAND()		((u32_t)sys_now())
 
 #define TCPIP_MBOX_SIZE         	512
 #define TCPIP_THREAD_PRIO		-10
 #define TCPIP_THREAD_STACKSIZE		32768
 
 #define DEFAULT_UDP_RECVMBOX_SIZE	16
-#define DEFAULT_TCP_RECVMBOX_SIZE	128
+#define DEFAULT_TCP_RECVMBOX_SIZE	1024
 #define DEFAULT_ACCEPTMBOX_SIZE		4
 
 #define LWIP_SOCKET			0
@@ -34,6 +38,9 @@
 #define MEMP_NUM_TCPIP_MSG_INPKT	64
 #define MEMP_NUM_NETBUF			128
 #define PBUF_POOL_SIZE			256
+/* The pools above are a minimum; net_core_init() grows them */
+#define MEMP_GROW			1
+#define MEMP_GROW_ALLOC(size)		malloc(size)
 #define ARP_TABLE_SIZE			16
 #define IP_REASS_MAX_PBUFS		64
 #define IP_REASS_MAXAGE			10
@@ -44,7 +51,11 @@
 #define DNS_TABLE_SIZE		16
 #define DNS_MAX_SERVERS		4
 #define TCP_MSS			1460
-#define TCP_WND			64000
+/* Room for a 10 MB/s transfer at 100 ms RTT */
+#define TCP_WND			(1024*1024)
+#define LWIP_WND_SCALE		1
+#define TCP_RCV_SCALE		5
+#define LWIP_TCP_SACK		1
 #define TCP_SND_BUF		(4*TCP_MSS)
 #define LWIP_TCP_TIMESTAMPS	1
 
@@ -87,6 +87,7 @@
 #include "ipv4/lwip/icmp.h"
 #include "lwip/tcp_impl.h"
 #include "lwip/udp.h"
+#include "lwip/igmp.h"
 
 #if LWIP_AUTOIP
 #error "AUTOIP not supported"
@@ -432,6 +433,9 @@ low_level_init(struct netif *netif)
 
   /* device capabilities */
   netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_LINK_UP;
+#if LWIP_IGMP
+  netif->flags |= NETIF_FLAG_IGMP;
+#endif
   /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
   if (undi_is_ethernet(netif))
     netif->flags |= NETIF_FLAG_ETHARP;
@@ -1133,7 +1137,8 @@ static void get_packet_fragment(t_PXENV_UNDI_ISR *isr)
 {
   do {
     isr->FuncFlag = PXENV_UNDI_ISR_IN_GET_NEXT;
-    pxe_call(PXENV_UNDI_ISR, &isr);
+    pxe_call(PXENV_UNDI_ISR, isr);
+    pxe_rx_stats.thunks++;
   } while (isr->FuncFlag != PXENV_UNDI_ISR_OUT_RECEIVE);
 }
 
@@ -1438,27 +1443,53 @@ undiarp_input(struct netif *netif, struct pbuf *p)
 
 /**
  * This function should be called when a packet is ready to be read
- * from the interface. It uses the function low_level_input() that
- * should handle the actual reception of bytes from the network
- * interface. Then the type of the received packet is determined and
- * the appropriate input function is called.
+ * from the interface. It uses the function low_level_input() to copy
+ * the frame out of the UNDI buffers, and strips the link level header
+ * where the link is not Ethernet.  The frame is passed on to the stack
+ * later, with undiif_deliver(), so that the UNDI can be drained of
+ * every pending frame first.
  *
- * @param netif the lwip network interface structure for this undiif
+ * @param isr the UNDI ISR structure describing the frame
+ * @param prot where to store the UNDI protocol of the frame
+ * @return the frame, or NULL if it was dropped
  */
-void undiif_input(t_PXENV_UNDI_ISR *isr)
+struct pbuf *undiif_receive(t_PXENV_UNDI_ISR *isr, u8_t *prot)
 {
   struct pbuf *p;
-  u8_t undi_prot;
   u16_t llhdr_len;
 
   /* From the first isr capture the essential information */
-  undi_prot = isr->ProtType;
+  *prot = isr->ProtType;
   llhdr_len = isr->FrameHeaderLength;
 
   /* move received packet into a new pbuf */
   p = low_level_input(isr);
-  /* no packet could be read, silently ignore this */
-  if (p == NULL) return;
+  if (p == NULL)
+    return NULL;
+
+  if (!undi_is_ethernet(&undi_netif) && pbuf_header(p, -(s16_t)llhdr_len)) {
+    LWIP_ASSERT("Can't move link level header in packet", 0);
+    pbuf_free(p);
+    return NULL;
+  }
+
+  return p;
+}
+
+/**
+ * Determine the type of a frame from undiif_receive() and call the
+ * appropriate input function.
+ *
+ * @param p the frame
+ * @param prot the UNDI protocol of the frame, from undiif_receive()
+ * @return ERR_OK, or an error if the frame was dropped
+ *
+ * Frames the stack takes are counted in pxe_rx_stats.
+ */
+err_t undiif_deliver(struct pbuf *p, u8_t prot)
+{
+  err_t err = ERR_OK;
+  u16_t len = p->tot_len;	/* p belongs to the stack once it has it */
 
   if (undi_is_ethernet(&undi_netif)) {
     /* points to packet payload, which starts with an Ethernet header */
@@ -1495,46 +1526,119 @@ void undiif_input(t_PXENV_UNDI_ISR *isr)
     case ETHTYPE_PPPOE:
 #endif /* PPPOE_SUPPORT */
       /* full packet send to tcpip_thread to process */
-      if (tcpip_input(p, &undi_netif)!=ERR_OK)
-       { LWIP_DEBUGF(UNDIIF_NET_DEBUG | UNDIIF_DEBUG, ("undiif_input: IP input error\n"));
+      err = tcpip_input(p, &undi_netif);
+      if (err != ERR_OK)
+       { LWIP_DEBUGF(UNDIIF_NET_DEBUG | UNDIIF_DEBUG, ("undiif_deliver: IP input error\n"));
          pbuf_free(p);
-         p = NULL;
+         return err;
        }
+      pxe_rx_stats.packets++;
+      pxe_rx_stats.bytes += len;
       break;
 
     default:
       pbuf_free(p);
-      p = NULL;
       break;
     }
   } else {
-    if (pbuf_header(p, -(s16_t)llhdr_len)) {
-      LWIP_ASSERT("Can't move link level header in packet", 0);
-      pbuf_free(p);
-      p = NULL;
-    } else {
-      switch(undi_prot) {
-      case P_IP:
-        /* pass to IP layer */
-        tcpip_input(p, &undi_netif);
-        break;
-      
-      case P_ARP:
-        /* pass p to ARP module */
-        undiarp_input(&undi_netif, p);
-        break;
-
-      default:
-        ETHARP_STATS_INC(etharp.proterr);
-        ETHARP_STATS_INC(etharp.drop);
+    switch(prot) {
+    case P_IP:
+      /* pass to IP layer */
+      err = tcpip_input(p, &undi_netif);
+      if (err != ERR_OK) {
         pbuf_free(p);
-        p = NULL;
-        break;
+        return err;
       }
+      pxe_rx_stats.packets++;
+      pxe_rx_stats.bytes += len;
+      break;
+
+    case P_ARP:
+      /* pass p to ARP module */
+      undiarp_input(&undi_netif, p);
+      pxe_rx_stats.packets++;
+      pxe_rx_stats.bytes += len;
+      break;
+
+    default:
+      ETHARP_STATS_INC(etharp.proterr);
+      ETHARP_STATS_INC(etharp.drop);
+      pbuf_free(p);
+      break;
     }
   }
+
+  return err;
 }
 
+#if LWIP_IGMP
+/**
+ * Add or remove a multicast group in the UNDI receive filter.
+ *
+ * The UNDI API only takes the complete list of multicast hardware
+ * addresses, so keep a copy of it here; several groups may map to the
+ * same hardware address, hence the reference counts.
+ *
+ * @param netif the lwip network interface structure for this undiif
+ * @param group the multicast group IP address
+ * @param action IGMP_ADD_MAC_FILTER or IGMP_DEL_MAC_FILTER
+ */
+static err_t
+undiif_igmp_mac_filter(struct netif *netif, ip_addr_t *group, u8_t action)
+{
+  static __lowmem t_PXENV_UNDI_GET_MCAST_ADDR get_mcast;
+  static __lowmem t_PXENV_UNDI_SET_MCAST_ADDR set_mcast;
+  static t_PXENV_UNDI_MCAST_ADDRESS mcast_list;
+  static u8_t mcast_refs[MAXNUM_MCADDR];
+  u16_t i, count = mcast_list.MCastAddrCount;
+
+  (void)netif;
+
+  memset(&get_mcast, 0, sizeof get_mcast);
+  memcpy(&get_mcast.InetAddr, group, sizeof(get_mcast.InetAddr));
+  if (pxe_call(PXENV_UNDI_GET_MCAST_ADDR, &get_mcast))
+    return ERR_IF;
+
+  for (i = 0; i < count; i++)
+    if (!memcmp(mcast_list.McastAddr[i], get_mcast.MediaAddr, MAC_len))
+      break;
+
+  if (action == IGMP_ADD_MAC_FILTER) {
+    if (i < count) {
+      mcast_refs[i]++;
+      return ERR_OK;
+    }
+    if (count == MAXNUM_MCADDR)
+      return ERR_MEM;
+    memcpy(mcast_list.McastAddr[count], get_mcast.MediaAddr,
+	   sizeof(mac_addr_t));
+    mcast_refs[count] = 1;
+    mcast_list.MCastAddrCount++;
+  } else {
+    if (i == count)
+      return ERR_OK;
+    if (--mcast_refs[i])
+      return ERR_OK;
+    /* Move the last entry into the freed slot */
+    count--;
+    memcpy(mcast_list.McastAddr[i], mcast_list.McastAddr[count],
+	   sizeof(mac_addr_t));
+    mcast_refs[i] = mcast_refs[count];
+    mcast_list.MCastAddrCount--;
+  }
+
+  memset(&set_mcast, 0, sizeof set_mcast);
+  memcpy(&set_mcast.R_Mcast_Buf, &mcast_list, sizeof mcast_list);
+  if (pxe_call(PXENV_UNDI_SET_MCAST_ADDR, &set_mcast)) {
+    dprintf("UNDI: setting the multicast filter failed: %04x\n",
+	    set_mcast.Status);
+    return ERR_IF;
+  }
+
+  return ERR_OK;
+}
+#endif /* LWIP_IGMP */
+
 /**
  * Should be called at the beginning of the program to set up the
  * network interface. It calls the function low_level_init() to do the
@@ -1568,6 +1672,9 @@ undiif_init(struct netif *netif)
   netif->name[1] = IFNAME1;
   netif->output = undiarp_output;
   netif->linkoutput = undi_send_unknown;
+#if LWIP_IGMP
+  netif_set_igmp_mac_filter(netif, undiif_igmp_mac_filter);
+#endif
 
   /* initialize the hardware */
   low_level_init(netif);
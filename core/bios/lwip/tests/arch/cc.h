@@ -0,0 +1,38 @@
+#ifndef __LWIP_ARCH_CC_H__
+#define __LWIP_ARCH_CC_H__
+
+/* Host build of the lwIP core, for the benchmark only */
+
+#include <inttypes.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <endian.h>
+
+#define BYTE_ORDER __BYTE_ORDER
+
+typedef uint8_t  u8_t;
+typedef int8_t   s8_t;
+typedef uint16_t u16_t;
+typedef int16_t  s16_t;
+typedef uint32_t u32_t;
+typedef int32_t  s32_t;
+
+typedef uintptr_t mem_ptr_t;
+
+#define PACK_STRUCT_STRUCT	__attribute__((packed))
+
+#define LWIP_PLATFORM_DIAG(x)	do { printf x; } while(0)
+#define LWIP_PLATFORM_ASSERT(x)	do { fprintf(stderr, "LWIP(%s,%d): %s\n", \
+					     __FILE__, __LINE__, (x)); \
+				     abort(); } while(0)
+
+#define U16_F	PRIu16
+#define S16_F	PRId16
+#define X16_F	PRIx16
+#define U32_F	PRIu32
+#define S32_F	PRId32
+#define X32_F	PRIx32
+#define SZT_F	"zu"
+
+#endif /* __LWIP_ARCH_CC_H__ */
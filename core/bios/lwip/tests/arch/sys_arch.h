@@ -0,0 +1,6 @@
+#ifndef __LWIP_ARCH_SYS_ARCH_H__
+#define __LWIP_ARCH_SYS_ARCH_H__
+
+/* NO_SYS: lwip/sys.h provides everything */
+
+#endif /* __LWIP_ARCH_SYS_ARCH_H__ */
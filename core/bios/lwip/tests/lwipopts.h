@@ -0,0 +1,59 @@
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/*
+ * lwIP options for the host TCP benchmark.  The receive side uses the
+ * same TCP settings as lpxelinux.0 (src/include/lwipopts.h); build with
+ * -DBENCH_WND_SCALE=0 for the settings from before window scaling.
+ */
+#ifndef BENCH_WND_SCALE
+#define BENCH_WND_SCALE		1
+#endif
+
+#define NO_SYS			1
+#define NO_SYS_NO_TIMERS	1
+#define SYS_LIGHTWEIGHT_PROT	0
+
+#define LWIP_ARP		0
+#define LWIP_ICMP		0
+#define LWIP_RAW		0
+#define LWIP_UDP		0
+#define LWIP_TCP		1
+#define LWIP_DHCP		0
+#define LWIP_IGMP		0
+#define LWIP_DNS		0
+#define LWIP_NETCONN		0
+#define LWIP_SOCKET		0
+#define LWIP_STATS		0
+#define IP_REASSEMBLY		0
+#define IP_FRAG			0
+
+#define MEM_ALIGNMENT		4
+#define PBUF_LINK_HLEN		0	/* The link carries bare IP */
+#define MEM_LIBC_MALLOC		1
+#define MEMP_MEM_MALLOC		0
+#define MEMP_GROW		1
+#define MEMP_GROW_ALLOC(size)	malloc(size)
+
+#define MEMP_NUM_TCP_PCB	4
+#define MEMP_NUM_TCP_SEG	4096
+#define MEMP_NUM_PBUF		4096
+#define PBUF_POOL_SIZE		256
+
+#define TCP_MSS			1460
+#define LWIP_TCP_TIMESTAMPS	1
+
+#if BENCH_WND_SCALE
+#define TCP_WND			(1024*1024)
+#define LWIP_WND_SCALE		1
+#define TCP_RCV_SCALE		5
+#define LWIP_TCP_SACK		1
+#define TCP_SND_BUF		(2*TCP_WND)
+#else
+#define TCP_WND			64000
+#define TCP_SND_BUF		0xffff
+#endif
+#define TCP_SND_QUEUELEN	4096
+#define TCP_SNDLOWAT		(8*TCP_MSS)
+
+#endif /* __LWIPOPTS_H__ */
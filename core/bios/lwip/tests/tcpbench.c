@@ -0,0 +1,387 @@
+/*
+ * TCP receive throughput of the lwIP stack over a long, fast link.
+ *
+ * Both ends run in this one process on the lwIP core from ../src, built
+ * for the host with NO_SYS.  The server end stands in for an HTTP
+ * server: it answers a GET with a Content-Length header and a body.
+ * Every packet crosses a simulated link with a fixed one-way delay and
+ * bandwidth, driven by a virtual clock, so the figures don't depend on
+ * the speed of the host.
+ *
+ * Usage: tcpbench [-r rtt_ms] [-b mbit_s] [-s size_mb] [-l loss_every]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lwip/init.h"
+#include "lwip/memp.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/ip.h"
+#include "lwip/tcp.h"
+#include "lwip/tcp_impl.h"
+
+#define CLIENT_IP	0x0a000001	/* 10.0.0.1 */
+#define SERVER_IP	0x0a000101	/* 10.0.1.1 */
+#define HTTP_PORT	80
+#define PATTERN		251		/* Body byte n is n % PATTERN */
+#define MAX_WRITE	0x8000
+
+static uint64_t now_us;			/* The virtual clock */
+static unsigned int delay_us = 10000;	/* One way */
+static unsigned int mbit_s = 1000;
+static unsigned int loss_every;		/* Drop every nth data packet */
+
+u32_t sys_now(void)
+{
+    return now_us / 1000;
+}
+
+/*
+ * The link.  Each direction is a FIFO of packets with the time they
+ * arrive at the other end; a packet can't start before the previous
+ * one in the same direction has been serialized.
+ */
+struct packet {
+    struct packet *next;
+    uint64_t when;
+    u16_t len;
+    u8_t data[];
+};
+
+struct link {
+    struct packet *head, **tailp;
+    uint64_t busy_until;
+    struct netif *to;
+    unsigned int packets, lost;
+};
+
+static struct netif client_if, server_if;
+static struct link to_client = { NULL, &to_client.head, 0, &client_if };
+static struct link to_server = { NULL, &to_server.head, 0, &server_if };
+
+static err_t link_output(struct netif *netif, struct pbuf *p,
+			 ip_addr_t *ipaddr)
+{
+    struct link *link = (ip4_addr_get_u32(ipaddr) == htonl(CLIENT_IP)) ?
+	&to_client : &to_server;
+    struct packet *pkt;
+    uint64_t start;
+
+    (void)netif;
+
+    start = link->busy_until > now_us ? link->busy_until : now_us;
+    link->busy_until = start + (uint64_t)p->tot_len * 8 / mbit_s;
+
+    link->packets++;
+    if (loss_every && p->tot_len > 100 && !(link->packets % loss_every)) {
+	link->lost++;
+	return ERR_OK;
+    }
+
+    pkt = malloc(sizeof *pkt + p->tot_len);
+    if (!pkt)
+	return ERR_MEM;
+    pkt->next = NULL;
+    pkt->when = link->busy_until + delay_us;
+    pkt->len = pbuf_copy_partial(p, pkt->data, p->tot_len, 0);
+
+    *link->tailp = pkt;
+    link->tailp = &pkt->next;
+    return ERR_OK;
+}
+
+static void link_deliver(struct link *link)
+{
+    struct packet *pkt;
+    struct pbuf *p;
+
+    while ((pkt = link->head) && pkt->when <= now_us) {
+	link->head = pkt->next;
+	if (!link->head)
+	    link->tailp = &link->head;
+
+	/* Out of pbufs counts as a drop, as it would on a NIC */
+	p = pbuf_alloc(PBUF_RAW, pkt->len, PBUF_POOL);
+	if (p) {
+	    pbuf_take(p, pkt->data, pkt->len);
+	    ip_input(p, link->to);
+	} else {
+	    link->lost++;
+	}
+	free(pkt);
+    }
+}
+
+static err_t link_netif_init(struct netif *netif)
+{
+    netif->output = link_output;
+    netif->mtu = 1500;
+    return ERR_OK;
+}
+
+/*
+ * The HTTP server stand-in.  The body is sent straight from a pattern
+ * buffer, without copying.
+ */
+static u8_t pattern[MAX_WRITE + PATTERN];
+static u32_t body_size;
+
+struct server {
+    char head[128];
+    u16_t head_len, head_sent;
+    u32_t body_sent;
+    int got_request;
+};
+
+static struct server server;
+
+static void server_push(struct tcp_pcb *pcb)
+{
+    u16_t len;
+
+    if (!server.got_request)
+	return;
+
+    while (server.head_sent < server.head_len) {
+	len = server.head_len - server.head_sent;
+	if (len > tcp_sndbuf(pcb))
+	    len = tcp_sndbuf(pcb);
+	if (!len || tcp_write(pcb, server.head + server.head_sent, len,
+			      TCP_WRITE_FLAG_COPY) != ERR_OK)
+	    goto out;
+	server.head_sent += len;
+    }
+
+    while (server.body_sent < body_size) {
+	len = tcp_sndbuf(pcb);
+	if (len > MAX_WRITE)
+	    len = MAX_WRITE;
+	if (len > body_size - server.body_sent)
+	    len = body_size - server.body_sent;
+	if (!len || tcp_write(pcb, pattern + server.body_sent % PATTERN,
+			      len, 0) != ERR_OK)
+	    break;
+	server.body_sent += len;
+    }
+
+out:
+    tcp_output(pcb);
+}
+
+static err_t server_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+    (void)arg;
+    (void)len;
+
+    server_push(pcb);
+    return ERR_OK;
+}
+
+static err_t server_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
+			 err_t err)
+{
+    (void)arg;
+    (void)err;
+
+    if (!p) {
+	tcp_close(pcb);
+	return ERR_OK;
+    }
+
+    /* The request is small enough to arrive in one segment */
+    if (!server.got_request) {
+	server.got_request = 1;
+	server.head_len = snprintf(server.head, sizeof server.head,
+				   "HTTP/1.0 200 OK\r\n"
+				   "Content-Length: %u\r\n\r\n", body_size);
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    server_push(pcb);
+    return ERR_OK;
+}
+
+static err_t server_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    (void)arg;
+    (void)err;
+
+    tcp_recv(pcb, server_recv);
+    tcp_sent(pcb, server_sent);
+    return ERR_OK;
+}
+
+/*
+ * The client end, reading the way the boot loader does: everything is
+ * consumed as soon as it arrives, and the body is checked.
+ */
+struct client {
+    int head_state;		/* Matched so much of "\r\n\r\n" */
+    u32_t body_got;
+    uint64_t start, done;
+    int bad;
+};
+
+static struct client client;
+
+static err_t client_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
+			 err_t err)
+{
+    static const char eoh[] = "\r\n\r\n";
+    struct pbuf *q;
+    u16_t i;
+
+    (void)arg;
+    (void)err;
+
+    if (!p)
+	return ERR_OK;
+
+    for (q = p; q; q = q->next) {
+	const u8_t *data = q->payload;
+
+	for (i = 0; i < q->len; i++) {
+	    if (client.head_state < 4) {
+		if (data[i] == eoh[client.head_state])
+		    client.head_state++;
+		else
+		    client.head_state = (data[i] == '\r');
+		continue;
+	    }
+	    if (data[i] != client.body_got % PATTERN)
+		client.bad++;
+	    client.body_got++;
+	}
+    }
+
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+
+    if (client.body_got == body_size && !client.done)
+	client.done = now_us;
+    return ERR_OK;
+}
+
+static err_t client_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+    static const char req[] = "GET /vmlinuz HTTP/1.0\r\n\r\n";
+
+    (void)arg;
+    (void)err;
+
+    tcp_write(pcb, req, sizeof req - 1, 0);
+    tcp_output(pcb);
+    return ERR_OK;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+	    "Usage: tcpbench [-r rtt_ms] [-b mbit_s] [-s size_mb] [-l loss_every]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    ip_addr_t addr, mask, gw;
+    struct tcp_pcb *listen, *pcb;
+    uint64_t next_tmr, next;
+    unsigned int size_mb = 32;
+    double secs;
+    u32_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:b:s:l:")) != -1) {
+	switch (opt) {
+	case 'r':
+	    delay_us = atoi(optarg) * 500;
+	    break;
+	case 'b':
+	    mbit_s = atoi(optarg);
+	    break;
+	case 's':
+	    size_mb = atoi(optarg);
+	    break;
+	case 'l':
+	    loss_every = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (!mbit_s || !size_mb)
+	usage();
+
+    body_size = size_mb << 20;
+    for (i = 0; i < sizeof pattern; i++)
+	pattern[i] = i % PATTERN;
+
+    lwip_init();
+
+    /* As net_core_init() does in lpxelinux.0 */
+    memp_grow(MEMP_PBUF_POOL, TCP_WND / TCP_MSS + 1);
+    memp_grow(MEMP_TCP_SEG, TCP_WND / TCP_MSS + 1);
+
+    IP4_ADDR(&mask, 255, 255, 255, 0);
+    ip_addr_set_zero(&gw);
+    ip4_addr_set_u32(&addr, htonl(CLIENT_IP));
+    netif_add(&client_if, &addr, &mask, &gw, NULL, link_netif_init, ip_input);
+    netif_set_up(&client_if);
+    ip4_addr_set_u32(&addr, htonl(SERVER_IP));
+    netif_add(&server_if, &addr, &mask, &gw, NULL, link_netif_init, ip_input);
+    netif_set_up(&server_if);
+
+    listen = tcp_new();
+    tcp_bind(listen, &addr, HTTP_PORT);
+    listen = tcp_listen(listen);
+    tcp_accept(listen, server_accept);
+
+    pcb = tcp_new();
+    ip4_addr_set_u32(&addr, htonl(CLIENT_IP));
+    tcp_bind(pcb, &addr, 0);
+    tcp_recv(pcb, client_recv);
+    ip4_addr_set_u32(&addr, htonl(SERVER_IP));
+    client.start = now_us;
+    tcp_connect(pcb, &addr, HTTP_PORT, client_connected);
+
+    /* Run the clock until the body is in, or for a simulated hour */
+    next_tmr = TCP_TMR_INTERVAL * 1000;
+    while (!client.done && now_us < 3600ULL * 1000000) {
+	next = next_tmr;
+	if (to_client.head && to_client.head->when < next)
+	    next = to_client.head->when;
+	if (to_server.head && to_server.head->when < next)
+	    next = to_server.head->when;
+	now_us = next;
+
+	link_deliver(&to_client);
+	link_deliver(&to_server);
+	if (now_us >= next_tmr) {
+	    tcp_tmr();
+	    next_tmr += TCP_TMR_INTERVAL * 1000;
+	}
+    }
+
+    if (!client.done) {
+	fprintf(stderr, "tcpbench: transfer stalled at %u of %u bytes\n",
+		client.body_got, body_size);
+	return 1;
+    }
+    if (client.bad) {
+	fprintf(stderr, "tcpbench: %d bad bytes\n", client.bad);
+	return 1;
+    }
+
+    secs = (client.done - client.start) / 1e6;
+    printf("window %7u%s: %u MB, %u ms RTT, %u Mbit/s, %u lost: "
+	   "%.2f s, %.2f MB/s\n",
+	   (unsigned int)TCP_WND, LWIP_WND_SCALE ? " scaled" : "       ",
+	   size_mb, delay_us / 500, mbit_s, to_client.lost + to_server.lost,
+	   secs, size_mb / secs);
+    return 0;
+}
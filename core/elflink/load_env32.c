@@ -52,7 +52,7 @@ struct elf_module core_module = {
  */
 void init_module_subsystem(struct elf_module *module)
 {
-    list_add(&module->list, &modules_head);
+    module_list_add(module);
 }
 
 static int _start_ldlinux(int argc, char **argv)
@@ -70,6 +70,18 @@ void cache_lock_block(struct cache *cs)
     cs->next = cs->prev = NULL;
 }
 
+/*
+ * While preloading, the blocks read are locked as well, until half
+ * of the cache is locked; the other half stays LRU.
+ */
+static void cache_pin_block(struct device *dev, struct cache *cs)
+{
+    if (cs->next && dev->cache_pinned < dev->cache_entries / 2) {
+	cache_lock_block(cs);
+	dev->cache_pinned++;
+    }
+}
+
 /*
  * Check for a particular BLOCK in the block cache, 
  * and if it is already there, just do nothing and return;
@@ -119,31 +131,179 @@ const void *get_cache(struct device *dev, block_t block)
 
     cs = _get_cache_block(dev, block);
     if (cs->block != block) {
+	dev->cache_misses++;
+	if (cs->block != (block_t)-1)
+	    dev->cache_evictions++;
 	cs->block = block;
         getoneblk(dev->disk, cs->data, block, dev->cache_block_size);
+    } else {
+	dev->cache_hits++;
     }
 
+    if (dev->cache_pin)
+	cache_pin_block(dev, cs);
+
     return cs->data;
 }
 
+/*
+ * Find a block in the cache without reading it or moving it in the
+ * LRU chain; NULL if it isn't there.
+ */
+static const void *cache_lookup(struct device *dev, block_t block)
+{
+    struct cache *cs = dev->cache_head + 1;
+    int i;
+
+    for (i = 0; i < dev->cache_entries; i++) {
+	if (cs->block == block) {
+	    dev->cache_hits++;
+	    return cs->data;
+	}
+	cs++;
+    }
+
+    return NULL;
+}
+
+/*
+ * File data for generic_getfssec(), in sectors starting at a block
+ * boundary.  While a small file is preloaded its blocks are read
+ * through the cache, and so locked there; once anything is locked,
+ * a read is served from the cache if all of its blocks are in it.
+ * Returns false if the caller has to read the disk.
+ */
+bool cache_get_sectors(struct fs_info *fs, void *buf, sector_t sector,
+		       uint32_t count)
+{
+    struct device *dev = fs->fs_dev;
+    int sector_shift = dev->disk->sector_shift;
+    int shift = __builtin_ctz(dev->cache_block_size) - sector_shift;
+    uint32_t per_block = 1 << shift;
+    const char *cd;
+    uint32_t cnt;
+    char *p = buf;
+
+    if (dev->cache_pin != CACHE_PIN_ALL && !dev->cache_pinned)
+	return false;
+    if (!dev->cache_head || (sector & (per_block - 1)))
+	return false;
+
+    while (count) {
+	if (dev->cache_pin == CACHE_PIN_ALL)
+	    cd = get_cache(dev, sector >> shift);
+	else
+	    cd = cache_lookup(dev, sector >> shift);
+	if (!cd)
+	    return false;
+
+	cnt = count < per_block ? count : per_block;
+	memcpy(p, cd, cnt << sector_shift);
+	p += cnt << sector_shift;
+	sector += cnt;
+	count -= cnt;
+    }
+    return true;
+}
+
+/*
+ * Read whole blocks straight into buf, bypassing the cache, in
+ * transfers of up to maxtransfer sectors.  Blocks which are in the
+ * cache already are copied from there instead; none are added.
+ * Returns the blocks read.
+ */
+static uint32_t cache_stream(struct device *dev, char *buf, block_t block,
+			     uint32_t count)
+{
+    struct disk *disk = dev->disk;
+    int block_shift = __builtin_ctz(dev->cache_block_size);
+    int shift = block_shift - disk->sector_shift;
+    uint32_t max = disk->maxtransfer >> shift;
+    uint32_t done = 0, n;
+    struct cache *cs, *hit;
+    int i;
+
+    if (!max)
+	max = 1;
+
+    while (done < count) {
+	n = count - done;
+	if (n > max)
+	    n = max;
+
+	/* The first block of this stretch we have already */
+	hit = NULL;
+	cs = dev->cache_head + 1;
+	for (i = 0; i < dev->cache_entries; i++, cs++) {
+	    if (cs->block >= block && cs->block < block + n &&
+		(!hit || cs->block < hit->block))
+		hit = cs;
+	}
+
+	if (hit && hit->block == block) {
+	    memcpy(buf, hit->data, dev->cache_block_size);
+	    dev->cache_hits++;
+	    n = 1;
+	} else {
+	    if (hit)
+		n = hit->block - block;
+	    if (disk->rdwr_sectors(disk, buf, block << shift, n << shift, 0)
+		!= (int)(n << shift))
+		break;
+	}
+
+	buf += n << block_shift;
+	block += n;
+	done += n;
+    }
+
+    return done;
+}
+
 /*
  * Read data from the cache at an arbitrary byte offset and length.
  * This is useful for filesystems whose metadata is not necessarily
  * aligned with their blocks.
  *
- * This is still reading linearly on the disk.
+ * A read of a quarter of the cache or more, or one which carries on
+ * where the last ones left off for that long, goes around the cache
+ * instead, so that streaming a large file doesn't push out all the
+ * metadata.  Only its partial blocks at either end are cached.
  */
 size_t cache_read(struct fs_info *fs, void *buf, uint64_t offset, size_t count)
 {
+    struct device *dev = fs->fs_dev;
     const char *cd;
     char *p = buf;
     size_t off, cnt, total;
     block_t block;
+    uint32_t nblocks;
+    bool stream;
+
+    if (offset == dev->cache_read_next)
+	dev->cache_read_run += count;
+    else
+	dev->cache_read_run = count;
+    dev->cache_read_next = offset + count;
+    stream = dev->cache_read_run >= dev->cache_size / 4;
 
     total = count;
     while (count) {
 	block = offset >> fs->block_shift;
 	off = offset & (fs->block_size - 1);
+
+	if (stream && !off && count >= fs->block_size) {
+	    nblocks = count >> fs->block_shift;
+	    cnt = (size_t)cache_stream(dev, p, block, nblocks)
+		<< fs->block_shift;
+	    count -= cnt;
+	    if (cnt < (size_t)nblocks << fs->block_shift)
+		break;		/* Disk error */
+	    p += cnt;
+	    offset += cnt;
+	    continue;
+	}
+
 	cd = get_cache(fs->fs_dev, block);
 	if (!cd)
 	    break;
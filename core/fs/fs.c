@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #include <dprintf.h>
 #include <syslinux/sysappend.h>
+#include <syslinux/trace.h>
 #include "core.h"
 #include "dev.h"
 #include "fs.h"
@@ -124,7 +125,9 @@ size_t pmapi_read_file(uint16_t *handle, void *buf, size_t sectors)
     struct file *file;
 
     file = handle_to_file(*handle);
+    syslinux_trace_begin("getfssec", NULL, sectors);
     bytes_read = file->fs->fs_ops->getfssec(file, buf, sectors, &have_more);
+    syslinux_trace_end("getfssec", bytes_read);
 
     /*
      * If we reach EOF, the filesystem driver will have already closed
@@ -138,7 +141,7 @@ size_t pmapi_read_file(uint16_t *handle, void *buf, size_t sectors)
     return bytes_read;
 }
 
-int searchdir(const char *name, int flags)
+static int do_searchdir(const char *name, int flags)
 {
     static char root_name[] = "/";
     struct file *file;
@@ -337,6 +340,17 @@ err_no_close:
     return -1;
 }
 
+int searchdir(const char *name, int flags)
+{
+    int rv;
+
+    syslinux_trace_begin("searchdir", name, 0);
+    rv = do_searchdir(name, flags);
+    syslinux_trace_end("searchdir", rv >= 0);
+
+    return rv;
+}
+
 __export int open_file(const char *name, int flags, struct com32_filedata *filedata)
 {
     int rv;
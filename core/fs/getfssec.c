@@ -61,6 +61,7 @@
 #include <dprintf.h>
 #include <minmax.h>
 #include "fs.h"
+#include "cache.h"
 
 static inline sector_t next_psector(sector_t psector, uint32_t skip)
 {
@@ -178,7 +179,9 @@ uint32_t generic_getfssec(struct file *file, char *buf,
 	if (inode->this_extent.pstart == EXTENT_ZERO) {
 	    memset(buf, 0, len);
 	} else {
-	    disk->rdwr_sectors(disk, buf, inode->this_extent.pstart, chunk, 0);
+	    if (!cache_get_sectors(fs, buf, inode->this_extent.pstart, chunk))
+		disk->rdwr_sectors(disk, buf, inode->this_extent.pstart,
+				   chunk, 0);
 	    inode->this_extent.pstart += chunk;
 	}
 
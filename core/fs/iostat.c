@@ -0,0 +1,43 @@
+/*
+ * iostat.c
+ *
+ * Collect the I/O counters kept around the core for pmapi_iostat().
+ */
+
+#include <string.h>
+#include <core.h>
+#include <fs.h>
+#include <disk.h>
+#include <net.h>
+#include <pmapi.h>
+#include <syslinux/iostat.h>
+
+/* Bumped by the network code, which may not be linked in */
+struct net_iostat net_iostat;
+
+__export void pmapi_iostat(struct syslinux_iostat *st)
+{
+    struct device *dev = this_fs ? this_fs->fs_dev : NULL;
+    struct disk *disk = dev ? dev->disk : NULL;
+
+    memset(st, 0, sizeof *st);
+    st->ms = ms_timer();
+
+    if (disk) {
+	st->disk_calls   = disk->io_calls;
+	st->disk_errors  = disk->io_errors;
+	st->disk_sectors = disk->io_sectors;
+	st->sector_size  = disk->sector_size;
+    }
+
+    if (dev) {
+	st->cache_hits      = dev->cache_hits;
+	st->cache_misses    = dev->cache_misses;
+	st->cache_evictions = dev->cache_evictions;
+    }
+
+    st->tftp_timeouts    = net_iostat.tftp_timeouts;
+    st->tftp_retransmits = net_iostat.tftp_retransmits;
+    st->tcp_stall_ms     = net_iostat.tcp_stall_ms;
+    st->tcp_bytes        = net_iostat.tcp_bytes;
+}
@@ -0,0 +1,67 @@
+/*
+ * preload.c
+ *
+ * The PRELOAD directive: read a file once and lock the blocks the
+ * filesystem read for it in the block cache, so that bulk reads later
+ * don't push them out again.  That is the directories on the way to
+ * it, its inode and its block map; a small file is kept whole.
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <core.h>
+#include <fs.h>
+#include <cache.h>
+
+/* Files up to this part of the cache are kept whole */
+#define PRELOAD_SMALL	8
+
+__export int fs_preload(const char *name)
+{
+    struct device *dev = this_fs ? this_fs->fs_dev : NULL;
+    char mangled_name[FILENAME_MAX];
+    struct file *file;
+    struct inode *inode;
+    uint32_t sectors, lstart;
+    char *buf;
+    int rv;
+
+    if (!dev || !dev->cache_head)
+	return 0;		/* No block cache, nothing to keep */
+
+    dev->cache_pin = CACHE_PIN_META;
+
+    mangle_name(mangled_name, name);
+    rv = searchdir(mangled_name, O_RDONLY);
+    if (rv < 0)
+	goto out;
+
+    file = handle_to_file(rv);
+    inode = file->inode;
+    sectors = (inode->size + SECTOR_SIZE(this_fs) - 1) >> SECTOR_SHIFT(this_fs);
+
+    if (inode->mode != DT_REG) {
+	rv = -1;
+    } else if (inode->size <= dev->cache_size / PRELOAD_SMALL) {
+	dev->cache_pin = CACHE_PIN_ALL;
+	buf = malloc(sectors << SECTOR_SHIFT(this_fs));
+	if (buf) {
+	    while (this_fs->fs_ops->getfssec(file, buf, sectors, NULL))
+		;
+	    free(buf);
+	}
+    } else if (this_fs->fs_ops->next_extent) {
+	/* Walk the block map, without reading the data */
+	for (lstart = 0; lstart < sectors; lstart += inode->next_extent.len) {
+	    if (this_fs->fs_ops->next_extent(inode, lstart) ||
+		!inode->next_extent.len)
+		break;
+	}
+    }
+
+    _close_file(file);
+
+out:
+    dev->cache_pin = 0;
+    return rv < 0 ? -1 : 0;
+}
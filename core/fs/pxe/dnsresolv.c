@@ -0,0 +1,561 @@
+/*
+ * The DNS resolver, shared by all the network stacks.
+ *
+ * A question goes to every configured server at once and the first
+ * usable answer wins, so a dead or slow server costs nothing while
+ * another one is up.  Answers, positive and negative, are remembered
+ * for as long as their TTL allows.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <core.h>
+#include <minmax.h>
+#include <net.h>
+#include "core_pxe.h"
+#include <lwip/opt.h>		/* DNS_MAX_SERVERS */
+
+#define DNS_PORT	53
+
+/* DNS CLASS values we care about */
+#define CLASS_IN	1
+
+/* DNS TYPE values we care about */
+#define TYPE_A		1
+#define TYPE_CNAME	5
+#define TYPE_SOA	6
+
+/* DNS RCODE values we care about */
+#define RCODE_OK	0
+#define RCODE_NXDOMAIN	3
+
+#define DNS_NAME_MAX	255	/* As a label set, including the final 0 */
+#define DNS_PKT_MAX	512	/* Largest reply without EDNS */
+#define DNS_CACHE_SIZE	32	/* Names remembered */
+#define DNS_MAX_TTL	86400	/* Seconds; longer TTLs are cut to this */
+#define DNS_NEG_TTL	60	/* For a negative answer without an SOA */
+#define DNS_MAX_NEG_TTL	300
+#define DNS_MAX_BATCH	8	/* Questions in flight at once */
+
+/*
+ * The DNS header structure
+ */
+struct dnshdr {
+    uint16_t id;
+    uint16_t flags;
+    /* number of entries in the question section */
+    uint16_t qdcount;
+    /* number of resource records in the answer section */
+    uint16_t ancount;
+    /* number of name server resource records in the authority records section*/
+    uint16_t nscount;
+    /* number of resource records in the additional records section */
+    uint16_t arcount;
+} __attribute__ ((packed));
+
+/*
+ * The DNS query structure
+ */
+struct dnsquery {
+    uint16_t qtype;
+    uint16_t qclass;
+} __attribute__ ((packed));
+
+/*
+ * The DNS Resource recodes structure
+ */
+struct dnsrr {
+    uint16_t type;
+    uint16_t class;
+    uint32_t ttl;
+    uint16_t rdlength;   /* The lenght of this rr data */
+} __attribute__ ((packed));
+
+uint32_t dns_server[DNS_MAX_SERVERS] = {0, };
+
+/* Retransmission intervals in milliseconds, ending with 0 */
+static const uint16_t dns_timeouts[] = { 1000, 2000, 4000, 8000, 0 };
+
+struct dns_cache_entry {
+    char *name;			/* NULL if the slot is free */
+    uint32_t ip;		/* 0 if the name doesn't resolve */
+    mstime_t expires;
+};
+
+static struct dns_cache_entry dns_cache[DNS_CACHE_SIZE];
+
+struct dns_question {
+    char name[DNS_NAME_MAX];	/* Fully qualified */
+    uint8_t pkt[sizeof(struct dnshdr) + DNS_NAME_MAX + sizeof(struct dnsquery)];
+    uint16_t len;		/* Of the packet */
+    uint16_t id;
+    uint8_t failed;		/* Servers which couldn't answer, as bits */
+    bool done;
+    uint32_t ip;
+};
+
+static uint16_t dns_id;
+
+/*
+ * parse the ip_str and return the ip address with *res.
+ * return true if the whole string was consumed and the result
+ * was valid.
+ *
+ */
+static bool parse_dotquad(const char *ip_str, uint32_t *res)
+{
+    const char *p = ip_str;
+    uint8_t part = 0;
+    uint32_t ip = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        while (is_digit(*p)) {
+            part = part * 10 + *p - '0';
+            p++;
+        }
+        if (i != 3 && *p != '.')
+            return false;
+
+        ip = (ip << 8) | part;
+        part = 0;
+        p++;
+    }
+    p--;
+
+    *res = htonl(ip);
+    return *p == '\0';
+}
+
+/*
+ * Turn a string in _src_ into a DNS "label set" in _dst_; returns the
+ * number of dots encountered. On return, *dst is updated.
+ */
+static int dns_mangle(char **dst, const char *p)
+{
+    char *q = *dst;
+    char *count_ptr;
+    char c;
+    int dots = 0;
+
+    count_ptr = q;
+    *q++ = 0;
+
+    while (1) {
+        c = *p++;
+        if (c == 0 || c == ':' || c == '/')
+            break;
+        if (c == '.') {
+            dots++;
+            count_ptr = q;
+            *q++ = 0;
+            continue;
+        }
+
+        *count_ptr += 1;
+        *q++ = c;
+    }
+
+    if (*count_ptr)
+        *q++ = 0;
+
+    /* update the strings */
+    *dst = q;
+    return dots;
+}
+
+/*
+ * Copy the name at offset _off_ of a reply into _dst_ as a plain label
+ * set, following compression pointers.  Returns the offset just past
+ * the name as it appears at _off_, or -1 if it is malformed.
+ */
+static int dns_getlabel(const uint8_t *buf, int len, int off, char *dst)
+{
+    int end = -1;
+    int hops = 0;
+    int out = 0;
+    unsigned int c;
+
+    while (1) {
+	if (off >= len)
+	    return -1;
+
+	c = buf[off];
+	if (c >= 0xc0) {
+	    /* Follow pointer */
+	    if (off + 1 >= len || ++hops > 16)
+		return -1;
+	    if (end < 0)
+		end = off + 2;
+	    off = ((c - 0xc0) << 8) + buf[off + 1];
+	} else if (c) {
+	    c++;		/* Include the length byte */
+	    if (off + c > len || out + c >= DNS_NAME_MAX)
+		return -1;
+	    memcpy(dst + out, buf + off, c);
+	    out += c;
+	    off += c;
+	} else {
+	    dst[out] = 0;
+	    return end < 0 ? off + 1 : end;
+	}
+    }
+}
+
+static bool dns_cache_lookup(const char *name, uint32_t *ip)
+{
+    struct dns_cache_entry *ce;
+
+    for (ce = dns_cache; ce < dns_cache + DNS_CACHE_SIZE; ce++) {
+	if (!ce->name || strcasecmp(ce->name, name))
+	    continue;
+
+	if ((mstimediff_t)(ce->expires - ms_timer()) <= 0) {
+	    free(ce->name);
+	    ce->name = NULL;
+	    return false;
+	}
+
+	*ip = ce->ip;
+	return true;
+    }
+
+    return false;
+}
+
+static void dns_cache_store(const char *name, uint32_t ip, uint32_t ttl)
+{
+    struct dns_cache_entry *ce, *slot = NULL;
+
+    if (!ttl)
+	return;
+
+    /* The same name, else a free slot, else the soonest to expire */
+    for (ce = dns_cache; ce < dns_cache + DNS_CACHE_SIZE; ce++) {
+	if (ce->name && !strcasecmp(ce->name, name)) {
+	    slot = ce;
+	    break;
+	}
+	if (!slot || (slot->name && (!ce->name ||
+	     (mstimediff_t)(ce->expires - slot->expires) < 0)))
+	    slot = ce;
+    }
+
+    if (!slot->name || strcasecmp(slot->name, name)) {
+	free(slot->name);
+	slot->name = strdup(name);
+	if (!slot->name)
+	    return;
+    }
+
+    slot->ip = ip;
+    slot->expires = ms_timer() + ttl * 1000;
+}
+
+/*
+ * Get a question ready to send.  Returns 1 if the answer is known
+ * without asking (in q->ip), 0 if the question is ready, or -1 if the
+ * name can't be looked up.
+ */
+static int dns_prepare(struct dns_question *q, const char *name)
+{
+    struct dnshdr *hd = (struct dnshdr *)q->pkt;
+    struct dnsquery *query;
+    char *p;
+    int len;
+
+    memset(q, 0, sizeof *q);
+
+    if (parse_dotquad(name, &q->ip))
+	return 1;
+
+    /* Is it a local (unqualified) domain name? */
+    if (!strchr(name, '.') && LocalDomain[0])
+	len = snprintf(q->name, sizeof q->name, "%s.%s", name, LocalDomain);
+    else
+	len = snprintf(q->name, sizeof q->name, "%s", name);
+    if (len >= DNS_NAME_MAX - 1)
+	return -1;
+
+    if (dns_cache_lookup(q->name, &q->ip))
+	return 1;
+
+    if (!dns_id)
+	dns_id = ms_timer();	/* Don't start from the same ID every boot */
+    q->id = ++dns_id;
+    hd->id      = q->id;
+    hd->flags   = htons(0x0100);   /* Recursion requested */
+    hd->qdcount = htons(1);        /* One question */
+
+    p = (char *)q->pkt + sizeof(struct dnshdr);
+    dns_mangle(&p, q->name);
+
+    query = (struct dnsquery *)p;
+    query->qtype  = htons(TYPE_A);
+    query->qclass = htons(CLASS_IN);
+    p += sizeof(struct dnsquery);
+
+    q->len = (uint8_t *)p - q->pkt;
+    return 0;
+}
+
+/*
+ * Make what we can of a reply to _q_.  Returns the number of seconds
+ * the answer may be cached for, or -1 if this server couldn't answer
+ * and another one should be given the chance.
+ */
+static int dns_parse(struct dns_question *q, const uint8_t *buf, int len)
+{
+    const struct dnshdr *hd = (const struct dnshdr *)buf;
+    char want[DNS_NAME_MAX], name[DNS_NAME_MAX];
+    struct dnsrr rr;
+    uint32_t ttl = DNS_MAX_TTL;
+    uint32_t neg_ttl = DNS_NEG_TTL;
+    uint32_t minimum;
+    uint16_t flags;
+    int ques, reps, auth;
+    int rd_len;
+    int off;
+
+    flags = ntohs(hd->flags);
+    if (!(flags & 0x8000) || (flags & 0x7800))
+	return -1;		/* Not a response to a standard query */
+
+    switch (flags & 0x000f) {
+    case RCODE_OK:
+    case RCODE_NXDOMAIN:
+	break;
+    default:
+	return -1;		/* SERVFAIL, REFUSED and the like */
+    }
+
+    strcpy(want, (const char *)q->pkt + sizeof(struct dnshdr));
+
+    ques = ntohs(hd->qdcount);   /* Questions */
+    reps = ntohs(hd->ancount);   /* Replies   */
+    auth = ntohs(hd->nscount);   /* Authority */
+    off = sizeof(struct dnshdr);
+
+    while (ques--) {
+	off = dns_getlabel(buf, len, off, name);
+	if (off < 0)
+	    return -1;
+	off += sizeof(struct dnsquery);
+    }
+
+    /* Parse the replies, following a CNAME chain */
+    while (reps--) {
+	off = dns_getlabel(buf, len, off, name);
+	if (off < 0 || off + (int)sizeof rr > len)
+	    return -1;
+	memcpy(&rr, buf + off, sizeof rr);
+	off += sizeof rr;
+	rd_len = ntohs(rr.rdlength);
+	if (off + rd_len > len)
+	    return -1;
+
+	if (ntohs(rr.class) == CLASS_IN && !strcasecmp(name, want)) {
+	    ttl = min(ttl, ntohl(rr.ttl));
+	    switch (ntohs(rr.type)) {
+	    case TYPE_A:
+		if (rd_len == 4) {
+		    memcpy(&q->ip, buf + off, 4);
+		    return ttl;
+		}
+		break;
+	    case TYPE_CNAME:
+		if (dns_getlabel(buf, len, off, want) < 0)
+		    return -1;
+		break;
+	    default:
+		break;
+	    }
+	}
+
+	off += rd_len;
+    }
+
+    /*
+     * No address: the name doesn't exist or has none.  The SOA in the
+     * authority section says for how long to believe that (RFC 2308).
+     */
+    while (auth--) {
+	off = dns_getlabel(buf, len, off, name);
+	if (off < 0 || off + (int)sizeof rr > len)
+	    break;
+	memcpy(&rr, buf + off, sizeof rr);
+	off += sizeof rr;
+	rd_len = ntohs(rr.rdlength);
+	if (off + rd_len > len)
+	    break;
+
+	if (ntohs(rr.type) == TYPE_SOA && rd_len >= 4) {
+	    memcpy(&minimum, buf + off + rd_len - 4, 4);
+	    neg_ttl = min(ntohl(rr.ttl), ntohl(minimum));
+	    break;
+	}
+
+	off += rd_len;
+    }
+
+    q->ip = 0;
+    return min(ttl, min(neg_ttl, DNS_MAX_NEG_TTL));
+}
+
+/*
+ * Ask all the servers all the questions, and wait for the answers.
+ */
+static void dns_resolve(struct dns_question *qs, int nq)
+{
+    uint8_t reply[DNS_PKT_MAX];
+    const struct dnshdr *hd = (const struct dnshdr *)reply;
+    struct pxe_pvt_inode socket;
+    struct dns_question *q;
+    const uint16_t *timeout;
+    mstime_t start;
+    uint32_t src_ip;
+    uint16_t src_port;
+    uint16_t len;
+    int pending = 0;
+    int nserv, s;
+    int ttl;
+
+    for (nserv = 0; nserv < DNS_MAX_SERVERS && dns_server[nserv]; nserv++)
+	;
+    if (!nserv)
+	return;
+
+    memset(&socket, 0, sizeof socket);
+    if (core_udp_open(&socket))
+	return;
+
+    for (q = qs; q < qs + nq; q++)
+	pending += !q->done;
+
+    for (timeout = dns_timeouts; *timeout && pending; timeout++) {
+	for (q = qs; q < qs + nq; q++) {
+	    if (q->done)
+		continue;
+	    for (s = 0; s < nserv; s++) {
+		if (!(q->failed & (1 << s)))
+		    core_udp_sendto(&socket, q->pkt, q->len,
+				    dns_server[s], DNS_PORT);
+	    }
+	}
+
+	start = ms_timer();
+	while (pending && ms_timer() - start < *timeout) {
+	    len = sizeof reply;
+	    if (core_udp_recv(&socket, reply, &len, &src_ip, &src_port))
+		continue;
+	    if (src_port != DNS_PORT || len < sizeof(struct dnshdr))
+		continue;
+
+	    for (s = 0; s < nserv; s++) {
+		if (dns_server[s] == src_ip)
+		    break;
+	    }
+	    if (s == nserv)
+		continue;
+
+	    for (q = qs; q < qs + nq; q++) {
+		if (!q->done && q->id == hd->id)
+		    break;
+	    }
+	    if (q == qs + nq)
+		continue;	/* A late answer, or not for us */
+
+	    ttl = dns_parse(q, reply, len);
+	    if (ttl < 0) {
+		q->failed |= 1 << s;
+		if (q->failed != (1 << nserv) - 1)
+		    continue;	/* Another server may yet answer */
+		q->ip = 0;	/* None can; don't remember that */
+		ttl = 0;
+	    }
+
+	    dprintf("dns: %s = %08x, ttl %d\n", q->name, ntohl(q->ip), ttl);
+	    dns_cache_store(q->name, q->ip, ttl);
+	    q->done = true;
+	    pending--;
+	}
+    }
+
+    core_udp_close(&socket);
+}
+
+/*
+ * Actual resolver function
+ * Points to a null-terminated string in _name_
+ * and returns the ip addr in _ip_ if it exists and can be found.
+ * If _ip_ = 0 on exit, the lookup failed.
+ */
+__export uint32_t pxe_dns(const char *name)
+{
+    struct dns_question *q;
+    uint32_t ip = 0;
+
+    /*
+     * Return failure on an empty input... this can happen during
+     * some types of URL parsing, and this is the easiest place to
+     * check for it.
+     */
+    if (!name || !*name)
+	return 0;
+
+    q = malloc(sizeof *q);
+    if (!q)
+	return 0;
+
+    switch (dns_prepare(q, name)) {
+    case 0:
+	dns_resolve(q, 1);
+	/* fall through */
+    case 1:
+	ip = q->ip;
+	break;
+    }
+
+    free(q);
+    return ip;
+}
+
+/*
+ * Look up a whitespace-separated list of names, all at once, so that
+ * opening files from those hosts later doesn't wait on the DNS.
+ */
+__export void pxe_dns_prefetch(const char *names)
+{
+    struct dns_question *qs;
+    char name[DNS_NAME_MAX];
+    const char *p = names;
+    int nq = 0;
+    int len;
+
+    qs = malloc(DNS_MAX_BATCH * sizeof *qs);
+    if (!qs)
+	return;
+
+    while (1) {
+	while (*p && !not_whitespace(*p))
+	    p++;
+	if (!*p)
+	    break;
+
+	for (len = 0; not_whitespace(p[len]); len++)
+	    ;
+	if (len < DNS_NAME_MAX) {
+	    memcpy(name, p, len);
+	    name[len] = '\0';
+	    if (!dns_prepare(&qs[nq], name) && ++nq == DNS_MAX_BATCH) {
+		dns_resolve(qs, nq);
+		nq = 0;
+	    }
+	}
+	p += len;
+    }
+
+    if (nq)
+	dns_resolve(qs, nq);
+
+    free(qs);
+}
@@ -0,0 +1,481 @@
+/*
+ * A RAM cache of files read over the network, keyed by the name they
+ * were opened with, so that a config file re-read on return to the
+ * menu, or a module loaded again, doesn't cost another transfer.
+ *
+ * A copy is taken as a file is read, and kept only if the whole file
+ * came in.  When the file is opened again it is served from memory:
+ * straight away if it came from TFTP or FTP, or after a conditional
+ * request if an HTTP server gave it an ETag or Last-Modified header.
+ *
+ * NetCache is the memory budget in kilobytes, 0 turning the cache off.
+ * The least recently used files are dropped to stay within it, and a
+ * file bigger than a quarter of the budget is never kept.
+ *
+ * Files read while prefetching are different: they are about to be
+ * loaded, once, so they are kept whatever their size, outside the
+ * budget, and handed over to the first reader.
+ */
+#include <dprintf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core.h>
+#include "core_pxe.h"
+
+#define FILECACHE_CHUNK	32768	/* Most handed out by one fill_buffer */
+
+__export uint32_t NetCache = 8192;
+
+struct filecache_entry {
+    struct filecache_entry *prev, *next; /* Most recently used first */
+    int refs;			/* One for the cache, one per reader */
+    char *key;
+    char *etag, *lastmod;	/* HTTP validators, NULL if not given */
+    char *data;
+    uint32_t size;
+};
+
+struct filecache_fill {
+    char *key;
+    char *etag, *lastmod;
+    char *data;
+    uint32_t len, alloc;
+    uint32_t expect;		/* Length announced by the server, or -1 */
+    bool started;		/* The file is open; what is read is its data */
+    bool failed;		/* Too big, or out of memory */
+    bool prefetch;		/* Read by pxe_prefetch() */
+};
+
+static struct filecache_entry *lru_head, *lru_tail;
+static uint32_t cache_used;
+
+static struct filecache_entry *prefetched[PREFETCH_MAX];
+static bool prefetching;
+
+static uint32_t filecache_budget(void)
+{
+    if (NetCache >= (UINT32_MAX >> 10))
+	return UINT32_MAX;
+    return NetCache << 10;
+}
+
+static void filecache_put(struct filecache_entry *e)
+{
+    if (--e->refs)
+	return;
+
+    free(e->key);
+    free(e->etag);
+    free(e->lastmod);
+    free(e->data);
+    free(e);
+}
+
+static void filecache_unlink(struct filecache_entry *e)
+{
+    if (e->prev)
+	e->prev->next = e->next;
+    else
+	lru_head = e->next;
+    if (e->next)
+	e->next->prev = e->prev;
+    else
+	lru_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void filecache_link(struct filecache_entry *e)
+{
+    e->prev = NULL;
+    e->next = lru_head;
+    if (lru_head)
+	lru_head->prev = e;
+    else
+	lru_tail = e;
+    lru_head = e;
+}
+
+/* Drop an entry from the cache; readers still using it keep it alive */
+static void filecache_drop(struct filecache_entry *e)
+{
+    filecache_unlink(e);
+    cache_used -= e->size;
+    filecache_put(e);
+}
+
+/* The largest copy a fill may take */
+static uint32_t filecache_fill_limit(const struct filecache_fill *fill)
+{
+    return fill->prefetch ? UINT32_MAX : filecache_budget() / 4;
+}
+
+static struct filecache_entry *filecache_find(const char *key)
+{
+    struct filecache_entry *e;
+
+    for (e = lru_head; e; e = e->next) {
+	if (!strcmp(e->key, key)) {
+	    filecache_unlink(e);
+	    filecache_link(e);
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+/* Take a prefetched file, along with the cache's reference to it */
+static struct filecache_entry *filecache_take_prefetched(const char *key)
+{
+    struct filecache_entry *e;
+    int i;
+
+    for (i = 0; i < PREFETCH_MAX; i++) {
+	e = prefetched[i];
+	if (e && !strcmp(e->key, key)) {
+	    prefetched[i] = NULL;
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+static void filecache_fill_free(struct filecache_fill *fill)
+{
+    free(fill->key);
+    free(fill->etag);
+    free(fill->lastmod);
+    free(fill->data);
+    free(fill);
+}
+
+static void filecache_insert(struct filecache_fill *fill)
+{
+    struct filecache_entry *e;
+    uint32_t budget = filecache_budget();
+    char *data;
+    int slot = -1;		/* Prefetch slot, if it is prefetched */
+
+    e = filecache_find(fill->key);
+    if (e)
+	filecache_drop(e);	/* The file has changed */
+
+    if (fill->prefetch) {
+	for (slot = 0; slot < PREFETCH_MAX && prefetched[slot]; slot++)
+	    ;
+	if (slot == PREFETCH_MAX)
+	    return;
+    } else {
+	if (fill->len > budget / 4)
+	    return;
+
+	while (lru_tail && cache_used + fill->len > budget)
+	    filecache_drop(lru_tail);
+    }
+
+    e = malloc(sizeof *e);
+    if (!e)
+	return;
+
+    /* Don't hold on to the slack from growing the copy */
+    data = realloc(fill->data, fill->len);
+    if (data)
+	fill->data = data;
+
+    e->refs = 1;
+    e->key = fill->key;
+    e->etag = fill->etag;
+    e->lastmod = fill->lastmod;
+    e->data = fill->data;
+    e->size = fill->len;
+    fill->key = fill->etag = fill->lastmod = fill->data = NULL;
+
+    if (slot >= 0) {
+	e->prev = e->next = NULL;
+	prefetched[slot] = e;
+	dprintf("filecache: prefetched %s, %u bytes\n", e->key, e->size);
+	return;
+    }
+
+    filecache_link(e);
+    cache_used += e->size;
+
+    dprintf("filecache: keeping %s, %u bytes, %u in use\n",
+	    e->key, e->size, cache_used);
+}
+
+/*
+ * Serving a file from memory.
+ */
+static void filecache_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct filecache_entry *e = socket->fc_entry;
+    uint32_t len = e->size - socket->tftp_filepos;
+
+    if (len > FILECACHE_CHUNK)
+	len = FILECACHE_CHUNK;
+
+    socket->tftp_dataptr = e->data + socket->tftp_filepos;
+    socket->tftp_bytesleft = len;
+    socket->tftp_filepos += len;
+    if (socket->tftp_filepos == e->size)
+	socket->tftp_goteof = 1;
+}
+
+static void filecache_close(struct inode *inode)
+{
+    (void)inode;		/* The entry goes with the socket */
+}
+
+const struct pxe_conn_ops filecache_conn_ops = {
+    .fill_buffer	= filecache_fill_buffer,
+    .close		= filecache_close,
+};
+
+/*
+ * Look a file up before it is opened.  Returns true if the inode is
+ * now reading it from memory.  Otherwise a copy will be taken as it
+ * is read, and fc_entry is set if there is a copy to revalidate.
+ */
+bool filecache_open(struct inode *inode, const char *key)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct filecache_entry *e;
+    struct filecache_fill *fill;
+
+    e = filecache_take_prefetched(key);
+    if (e) {
+	/* The reader now holds the only reference */
+	socket->fc_entry = e;
+	filecache_serve(inode);
+	return true;
+    }
+
+    if (!NetCache && !prefetching)
+	return false;
+
+    e = NetCache ? filecache_find(key) : NULL;
+    if (e) {
+	e->refs++;
+	socket->fc_entry = e;
+	if (!e->etag && !e->lastmod) {
+	    filecache_serve(inode);
+	    return true;
+	}
+    }
+
+    fill = zalloc(sizeof *fill);
+    if (!fill)
+	return false;
+
+    fill->key = strdup(key);
+    if (!fill->key) {
+	free(fill);
+	return false;
+    }
+    fill->expect = -1;
+    fill->prefetch = prefetching;
+    socket->fc_fill = fill;
+    return false;
+}
+
+/*
+ * Read the file from the entry found by filecache_open(), e.g. after
+ * the server has said it has not been modified.
+ */
+void filecache_serve(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+
+    dprintf("filecache: %s from memory\n", socket->fc_entry->key);
+
+    if (socket->fc_fill) {
+	filecache_fill_free(socket->fc_fill);
+	socket->fc_fill = NULL;
+    }
+
+    socket->ops = &filecache_conn_ops;
+    socket->tftp_filepos = 0;
+    socket->tftp_bytesleft = 0;
+    socket->tftp_goteof = 0;
+    inode->size = socket->fc_entry->size;
+}
+
+/*
+ * The validators to send with a conditional request, if the cached
+ * copy can be revalidated.
+ */
+bool filecache_validators(struct inode *inode,
+			  const char **etag, const char **lastmod)
+{
+    struct filecache_entry *e = PVT(inode)->fc_entry;
+
+    if (!e)
+	return false;
+
+    *etag = e->etag;
+    *lastmod = e->lastmod;
+    return true;
+}
+
+/*
+ * What the server said about the file now being read.  A length of -1
+ * means it is not known.
+ */
+void filecache_fill_info(struct inode *inode, const char *etag,
+			 const char *lastmod, uint32_t length)
+{
+    struct filecache_fill *fill = PVT(inode)->fc_fill;
+
+    if (!fill)
+	return;
+
+    free(fill->etag);
+    free(fill->lastmod);
+    fill->etag = etag && etag[0] ? strdup(etag) : NULL;
+    fill->lastmod = lastmod && lastmod[0] ? strdup(lastmod) : NULL;
+    fill->expect = length;
+}
+
+/*
+ * Record what fill_buffer just put in the socket buffer.
+ */
+void filecache_record(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct filecache_fill *fill = socket->fc_fill;
+    uint32_t len = socket->tftp_bytesleft;
+    uint32_t alloc;
+    char *data;
+
+    if (!fill || !fill->started || fill->failed || !len)
+	return;
+
+    if (fill->len + len > filecache_fill_limit(fill))
+	goto fail;
+
+    if (fill->len + len > fill->alloc) {
+	alloc = fill->alloc ? fill->alloc : FILECACHE_CHUNK;
+	while (alloc < fill->len + len)
+	    alloc <<= 1;
+
+	data = realloc(fill->data, alloc);
+	if (!data)
+	    goto fail;
+	fill->data = data;
+	fill->alloc = alloc;
+    }
+
+    memcpy(fill->data + fill->len, socket->tftp_dataptr, len);
+    fill->len += len;
+    return;
+
+fail:
+    fill->failed = true;
+    free(fill->data);
+    fill->data = NULL;
+    fill->alloc = 0;
+}
+
+/*
+ * The file has been opened, and what is left in the buffer is the
+ * start of it.  Nothing before this is the file: the open itself read
+ * response headers, and maybe redirects, through the same buffer.
+ */
+void filecache_fill_start(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct filecache_fill *fill = socket->fc_fill;
+
+    if (!fill)
+	return;
+
+    free(fill->data);
+    fill->data = NULL;
+    fill->len = fill->alloc = 0;
+    fill->started = true;
+
+    if (fill->expect == (uint32_t)-1 && inode->size != (uint64_t)-1)
+	fill->expect = inode->size;
+
+    /* With the size known up front the copy needn't grow */
+    if (fill->expect != (uint32_t)-1) {
+	if (fill->expect > filecache_fill_limit(fill)) {
+	    fill->failed = true;
+	    return;
+	}
+	fill->data = malloc(fill->expect);
+	if (fill->data)
+	    fill->alloc = fill->expect;
+    }
+
+    filecache_record(inode);
+}
+
+/*
+ * The file is being closed: keep the copy if all of it was read.
+ */
+void filecache_fill_end(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct filecache_fill *fill = socket->fc_fill;
+
+    if (!fill)
+	return;
+
+    if (!fill->failed && socket->tftp_goteof && fill->len &&
+	(fill->expect == (uint32_t)-1 || fill->len == fill->expect))
+	filecache_insert(fill);
+
+    filecache_fill_free(fill);
+    socket->fc_fill = NULL;
+}
+
+/*
+ * The socket is being freed.
+ */
+void filecache_release(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+
+    if (socket->fc_fill) {
+	filecache_fill_free(socket->fc_fill);
+	socket->fc_fill = NULL;
+    }
+    if (socket->fc_entry) {
+	filecache_put(socket->fc_entry);
+	socket->fc_entry = NULL;
+    }
+}
+
+/*
+ * Hand a redirected open's cache state on to the socket that follows
+ * the redirect.
+ */
+void filecache_move(struct inode *to, struct inode *from)
+{
+    PVT(to)->fc_entry = PVT(from)->fc_entry;
+    PVT(to)->fc_fill = PVT(from)->fc_fill;
+    PVT(from)->fc_entry = NULL;
+    PVT(from)->fc_fill = NULL;
+}
+
+/*
+ * Files opened between filecache_prefetch(true) and (false) are kept
+ * for their first reader.  Starting a prefetch drops whatever the last
+ * one fetched and nobody read.
+ */
+void filecache_prefetch(bool on)
+{
+    int i;
+
+    if (on) {
+	for (i = 0; i < PREFETCH_MAX; i++) {
+	    if (prefetched[i]) {
+		filecache_put(prefetched[i]);
+		prefetched[i] = NULL;
+	    }
+	}
+    }
+    prefetching = on;
+}
@@ -0,0 +1,46 @@
+/*
+ * Reading a PXE socket's data a buffer or a byte at a time.  These
+ * are kept apart from pxe.c so the host tests can build them too.
+ */
+#include <syslinux/trace.h>
+#include "core_pxe.h"
+
+/*
+ * Get a fresh packet if the buffer is drained, and we haven't hit
+ * EOF yet.  The buffer should be filled immediately after draining!
+ */
+void pxe_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    if (socket->tftp_bytesleft || socket->tftp_goteof)
+        return;
+
+    syslinux_trace_begin("fill_buffer", NULL, socket->tftp_filepos);
+    socket->ops->fill_buffer(inode);
+    syslinux_trace_end("fill_buffer", socket->tftp_bytesleft);
+    filecache_record(inode);
+}
+
+/*
+ * Read a single character from the specified pxe inode.
+ * Very useful for stepping through http streams and
+ * parsing their headers.
+ */
+int pxe_getc(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    unsigned char byte;
+
+    while (!socket->tftp_bytesleft) {
+	if (socket->tftp_goteof)
+	    return -1;
+
+	pxe_fill_buffer(inode);
+    }
+
+    byte = *socket->tftp_dataptr;
+    socket->tftp_bytesleft -= 1;
+    socket->tftp_dataptr += 1;
+
+    return byte;
+}
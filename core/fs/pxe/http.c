@@ -1,6 +1,7 @@
 #include <syslinux/sysappend.h>
 #include <ctype.h>
 #include <lwip/api.h>
+#include <zlib.h>
 #include "core_pxe.h"
 #include "version.h"
 #include "url.h"
@@ -51,6 +52,7 @@ static size_t cookie_len, header_len;
 static char *cookie_buf, *header_buf;
 
 __export uint32_t SendCookies = UINT_MAX; /* Send all cookies */
+__export uint8_t HttpEncoding = 1; /* Ask for compressed bodies */
 
 static size_t http_do_bake_cookies(char *q)
 {
@@ -152,6 +154,164 @@ static const struct pxe_conn_ops http_conn_ops = {
     .readdir		= http_readdir,
 };
 
+/*
+ * A body sent with Content-Encoding: gzip is inflated as it is read,
+ * so the file appears to hold the decompressed data.  The state lives
+ * in the socket's packet buffer, which TCP connections don't otherwise
+ * use and which is freed with the socket.
+ */
+#define HTTP_INFLATE_BUF	16384
+
+struct http_inflate {
+    z_stream zs;		/* Holds the unread compressed data */
+    bool zs_live;		/* inflateEnd() still to be done */
+    bool raw_eof;		/* The TCP connection is done with */
+    char out[HTTP_INFLATE_BUF];
+};
+
+#define HTTP_INFLATE(socket) ((struct http_inflate *)(socket)->tftp_pktbuf)
+
+static void http_inflate_fill_buffer(struct inode *inode);
+static void http_inflate_close(struct inode *inode);
+
+static const struct pxe_conn_ops http_inflate_conn_ops = {
+    .fill_buffer	= http_inflate_fill_buffer,
+    .close		= http_inflate_close,
+    .readdir		= http_readdir,
+};
+
+/*
+ * The content codings we can undo.  Others were never asked for, and
+ * are passed through as they always have been.
+ */
+static bool http_inflatable(const char *coding)
+{
+    static const char * const codings[] = {
+	"gzip", "x-gzip", "deflate", NULL
+    };
+    const char * const *c;
+    size_t len;
+
+    for (len = 0; coding[len] && !isspace(coding[len]); len++)
+	;
+
+    for (c = codings; *c; c++) {
+	if (strlen(*c) == len && !strncasecmp(coding, *c, len))
+	    return true;
+    }
+    return false;
+}
+
+static int http_inflate_start(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct http_inflate *hz;
+
+    hz = malloc(sizeof *hz);
+    if (!hz)
+	return -1;
+
+    /* What is left in the buffer is the start of the compressed body */
+    memset(&hz->zs, 0, sizeof hz->zs);
+    hz->zs.next_in = (Bytef *)socket->tftp_dataptr;
+    hz->zs.avail_in = socket->tftp_bytesleft;
+
+    /* +32: take a gzip or a zlib header */
+    if (inflateInit2(&hz->zs, 32 + MAX_WBITS) != Z_OK) {
+	free(hz);
+	return -1;
+    }
+    hz->zs_live = true;
+    hz->raw_eof = socket->tftp_goteof;
+
+    socket->tftp_pktbuf = (char *)hz;
+    socket->ops = &http_inflate_conn_ops;
+    socket->tftp_bytesleft = 0;
+    socket->tftp_filepos = 0;
+    return 0;
+}
+
+/*
+ * Get the next piece of the compressed body.  While doing so the TCP
+ * code sees the socket as a plain HTTP connection, and must not touch
+ * the size of the inflated file.
+ */
+static void http_inflate_pull(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct http_inflate *hz = HTTP_INFLATE(socket);
+    uint64_t size = inode->size;
+    uint32_t filepos = socket->tftp_filepos;
+
+    socket->ops = &http_conn_ops;
+    socket->tftp_bytesleft = 0;
+    socket->tftp_goteof = 0;
+
+    core_tcp_fill_buffer(inode);
+
+    hz->zs.next_in = (Bytef *)socket->tftp_dataptr;
+    hz->zs.avail_in = socket->tftp_bytesleft;
+    hz->raw_eof = socket->tftp_goteof;
+
+    socket->ops = &http_inflate_conn_ops;
+    socket->tftp_bytesleft = 0;
+    socket->tftp_goteof = 0;
+    socket->tftp_filepos = filepos;
+    inode->size = size;
+}
+
+static void http_inflate_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct http_inflate *hz = HTTP_INFLATE(socket);
+    z_stream *zs = &hz->zs;
+    uint16_t len;
+    int rv = Z_OK;
+
+    zs->next_out = (Bytef *)hz->out;
+    zs->avail_out = sizeof hz->out;
+
+    while (zs->avail_out) {
+	if (!zs->avail_in && !hz->raw_eof)
+	    http_inflate_pull(inode);
+
+	rv = inflate(zs, Z_NO_FLUSH);
+	if (rv == Z_BUF_ERROR && !hz->raw_eof)
+	    continue;		/* An empty piece; try again */
+	if (rv != Z_OK)
+	    break;
+    }
+
+    len = sizeof hz->out - zs->avail_out;
+    socket->tftp_dataptr = hz->out;
+    socket->tftp_bytesleft = len;
+    socket->tftp_filepos += len;
+
+    if (rv != Z_OK) {
+	/* The end of the stream, or a truncated or corrupt one */
+	if (rv != Z_STREAM_END)
+	    dprintf("http: inflate error %d after %u bytes\n",
+		    rv, socket->tftp_filepos);
+	http_inflate_close(inode);
+	socket->tftp_goteof = 1;
+	inode->size = socket->tftp_filepos;
+    }
+}
+
+static void http_inflate_close(struct inode *inode)
+{
+    struct http_inflate *hz = HTTP_INFLATE(PVT(inode));
+
+    if (hz->zs_live) {
+	inflateEnd(&hz->zs);
+	hz->zs_live = false;
+    }
+    if (!hz->raw_eof) {
+	hz->raw_eof = true;
+	core_tcp_close_file(inode);
+    }
+}
+
 void http_open(struct url_info *url, int flags, struct inode *inode,
 	       const char **redir)
 {
@@ -172,8 +332,12 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
 	st_skip_fieldvalue,
 	st_eoh,
     } state;
-    static char location[FILENAME_MAX];
+    char *location = NULL;	/* Goes with the socket on a redirect */
+    char etag[256], lastmod[64];
+    const char *if_etag, *if_lastmod;
+    bool conditional;
     uint32_t content_length; /* same as inode->size */
+    bool inflate = false;
     size_t response_size;
     int status;
     int pos;
@@ -227,13 +391,33 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
 			     "\r\n"
 			     "User-Agent: Syslinux/" VERSION_STR "\r\n"
 			     "Connection: close\r\n"
-			     "%s"
+			     "%s%s"
 			     "\r\n",
+			     HttpEncoding ? "Accept-Encoding: gzip\r\n" : "",
 			     cookie_buf ? cookie_buf : "");
     if (header_bytes >= header_len)
 	goto fail;		/* Buffer overflow */
 
-    err = core_tcp_write(socket, header_buf, header_bytes, false);
+    /* Only send a body if our cached copy is out of date */
+    conditional = filecache_validators(inode, &if_etag, &if_lastmod);
+    if (conditional) {
+	header_bytes -= 2;	/* Back up over the blank line */
+	if (if_etag)
+	    header_bytes += snprintf(header_buf + header_bytes,
+				     header_len - header_bytes,
+				     "If-None-Match: %s\r\n", if_etag);
+	if (if_lastmod && header_bytes < header_len)
+	    header_bytes += snprintf(header_buf + header_bytes,
+				     header_len - header_bytes,
+				     "If-Modified-Since: %s\r\n", if_lastmod);
+	if (header_bytes < header_len)
+	    header_bytes += snprintf(header_buf + header_bytes,
+				     header_len - header_bytes, "\r\n");
+	if (header_bytes >= header_len)
+	    goto fail;		/* Buffer overflow */
+    }
+
+    err = core_tcp_write(socket, header_buf, header_bytes, true);
     if (err)
 	goto fail;
 
@@ -244,6 +428,8 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
     response_size = 0;
     field_value_len = 0;
     field_name_len = 0;
+    field_name[0] = field_value[0] = '\0';
+    etag[0] = lastmod[0] = '\0';
 
     while (state != st_eoh) {
 	int ch = pxe_getc(inode);
@@ -278,14 +464,12 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
 	    break;
 
 	case st_fieldfirst:
-	    if (ch == '\n')
-		state = st_eoh;
-	    else if (isspace(ch)) {
+	    if (isspace(ch) && ch != '\n') {
 		/* A continuation line */
 		state = st_fieldvalue;
 		goto fieldvalue;
 	    }
-	    else if (is_token(ch)) {
+	    else if (ch == '\n' || is_token(ch)) {
 		/* Process the previous field before starting on the next one */
 		if (strcasecmp(field_name, "Content-Length") == 0) {
 		    next = field_value;
@@ -309,7 +493,38 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
 		    /* Skip leading whitespace */
 		    while (isspace(*next))
 			next++;
-		    strlcpy(location, next, sizeof location);
+		    free(location);
+		    location = strdup(next);
+		}
+		else if (strcasecmp(field_name, "Content-Encoding") == 0) {
+		    next = field_value;
+		    /* Skip leading whitespace */
+		    while (isspace(*next))
+			next++;
+		    inflate = http_inflatable(next);
+		}
+		else if (strcasecmp(field_name, "ETag") == 0) {
+		    next = field_value;
+		    /* Skip leading whitespace */
+		    while (isspace(*next))
+			next++;
+		    /* A truncated validator is no use */
+		    if (strlen(next) < sizeof etag)
+			strcpy(etag, next);
+		}
+		else if (strcasecmp(field_name, "Last-Modified") == 0) {
+		    next = field_value;
+		    /* Skip leading whitespace */
+		    while (isspace(*next))
+			next++;
+		    /* A truncated validator is no use */
+		    if (strlen(next) < sizeof lastmod)
+			strcpy(lastmod, next);
+		}
+		/* A blank line ends the header */
+		if (ch == '\n') {
+		    state = st_eoh;
+		    break;
 		}
 		/* Start the field name and field value afress */
 		field_name_len = 1;
@@ -383,22 +598,38 @@ void http_open(struct url_info *url, int flags, struct inode *inode,
 	 */
 	/* Treat the remainder of the bytes as data */
 	socket->tftp_filepos -= response_size;
+	if (inflate && http_inflate_start(inode))
+	    goto fail;
+	filecache_fill_info(inode, etag, lastmod,
+			    inflate ? (uint32_t)-1 : content_length);
+	break;
+    case 304:
+	/* Not modified: read our cached copy */
+	if (!conditional)
+	    goto fail;
+	core_tcp_close_file(inode);
+	filecache_serve(inode);
 	break;
     case 301:
     case 302:
     case 303:
     case 307:
 	/* A redirect */
-	if (!location[0])
+	if (!location || !location[0])
 	    goto fail;
+	/* Valid until the caller frees the socket */
+	socket->tftp_pktbuf = location;
 	*redir = location;
+	location = NULL;
 	goto fail;
     default:
 	goto fail;
 	break;
     }
+    free(location);
     return;
 fail:
+    free(location);
     inode->size = 0;
     core_tcp_close_file(inode);
     return;
@@ -0,0 +1,94 @@
+/*
+ * Fetching the files a boot is about to load all at once: a kernel
+ * and several initrds are otherwise read one after the other, each
+ * transfer waiting out the round trips of the one before.
+ *
+ * Each file is read to the end on its own connection, where the
+ * network stack can run them side by side, into the file cache; the
+ * loaders then find the copies there.
+ */
+#include <dprintf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <core.h>
+#include <fs.h>
+#include <net.h>
+#include "core_pxe.h"
+
+#define PREFETCH_CHUNK	65536	/* Bytes read at a time */
+
+__export uint8_t NetPrefetch = 1;
+
+/* Read a file to the end; the cache takes the copy, the data is dropped */
+static void prefetch_file(void *data)
+{
+    static char scratch[PREFETCH_CHUNK];
+    const char *name = data;
+    struct com32_filedata fd;
+    uint16_t handle;
+    int rv;
+
+    rv = open_file(name, O_RDONLY, &fd);
+    if (rv < 0) {
+	dprintf("prefetch: %s not found\n", name);
+	return;
+    }
+
+    handle = rv;
+    while (handle) {
+	if (!pmapi_read_file(&handle, scratch,
+			     PREFETCH_CHUNK >> fd.blocklg2))
+	    break;
+    }
+    close_file(handle);
+
+    dprintf("prefetch: %s, %zu bytes\n", name, fd.size);
+}
+
+/*
+ * Fetch a whitespace-separated list of files, all at once.  Nothing
+ * is done if the network stack can't overlap the transfers.
+ */
+__export void pxe_prefetch(const char *names)
+{
+    char *files[PREFETCH_MAX];
+    char *list, *p;
+    int nfiles = 0;
+    int i;
+
+    if (!NetPrefetch)
+	return;
+
+    list = strdup(names);
+    if (!list)
+	return;
+
+    p = list;
+    while (nfiles < PREFETCH_MAX) {
+	while (*p && !not_whitespace(*p))
+	    p++;
+	if (!*p)
+	    break;
+
+	files[nfiles] = p;
+	while (not_whitespace(*p))
+	    p++;
+	if (*p)
+	    *p++ = '\0';
+
+	/* The same file twice would only be fetched twice */
+	for (i = 0; i < nfiles; i++) {
+	    if (!strcmp(files[i], files[nfiles]))
+		break;
+	}
+	if (i == nfiles)
+	    nfiles++;
+    }
+
+    filecache_prefetch(true);
+    if (nfiles > 1 && net_core_parallel(prefetch_file, (void **)files, nfiles))
+	dprintf("prefetch: the network stack can't overlap transfers\n");
+    filecache_prefetch(false);
+
+    free(list);
+}
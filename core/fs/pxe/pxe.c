@@ -45,6 +45,7 @@ void free_socket(struct inode *inode)
     struct pxe_pvt_inode *socket = PVT(inode);
 
     free(socket->tftp_pktbuf);	/* If we allocated a buffer, free it now */
+    filecache_release(inode);
     free_inode(inode);
 }
 
@@ -56,6 +57,8 @@ static void pxe_close_file(struct file *file)
     if (!inode)
 	return;
 
+    filecache_fill_end(inode);
+
     if (!socket->tftp_goteof) {
 	socket->ops->close(inode);
     }
@@ -116,44 +119,6 @@ static void pxe_mangle_name(char *dst, const char *src)
     *dst = '\0';
 }
 
-/*
- * Read a single character from the specified pxe inode.
- * Very useful for stepping through http streams and
- * parsing their headers.
- */
-int pxe_getc(struct inode *inode)
-{
-    struct pxe_pvt_inode *socket = PVT(inode);
-    unsigned char byte;
-
-    while (!socket->tftp_bytesleft) {
-	if (socket->tftp_goteof)
-	    return -1;
-
-	socket->ops->fill_buffer(inode);
-    }
-
-    byte = *socket->tftp_dataptr;
-    socket->tftp_bytesleft -= 1;
-    socket->tftp_dataptr += 1;
-
-    return byte;
-}
-
-/*
- * Get a fresh packet if the buffer is drained, and we haven't hit
- * EOF yet.  The buffer should be filled immediately after draining!
- */
-static void fill_buffer(struct inode *inode)
-{
-    struct pxe_pvt_inode *socket = PVT(inode);
-    if (socket->tftp_bytesleft || socket->tftp_goteof)
-        return;
-
-    return socket->ops->fill_buffer(inode);
-}
-
-
 /**
  * getfssec: Get multiple clusters from a file, given the starting cluster.
  * In this case, get multiple blocks from a specific TCP connection.
@@ -177,7 +142,7 @@ static uint32_t pxe_getfssec(struct file *file, char *buf,
 
     count <<= TFTP_BLOCKSIZE_LG2;
     while (count) {
-        fill_buffer(inode); /* If we have no 'fresh' buffer, get it */
+        pxe_fill_buffer(inode); /* If we have no 'fresh' buffer, get it */
         if (!socket->tftp_bytesleft)
             break;
 
@@ -194,7 +159,7 @@ static uint32_t pxe_getfssec(struct file *file, char *buf,
 
 
     if (socket->tftp_bytesleft || (socket->tftp_filepos < inode->size)) {
-	fill_buffer(inode);
+	pxe_fill_buffer(inode);
         *have_more = 1;
     } else if (socket->tftp_goteof) {
         /*
@@ -256,8 +221,9 @@ static void pxe_searchdir(const char *filename, int flags, struct file *file)
 static void __pxe_searchdir(const char *filename, int flags, struct file *file)
 {
     struct fs_info *fs = file->fs;
-    struct inode *inode;
+    struct inode *inode, *prev;
     char fullpath[2*FILENAME_MAX];
+    char key[2*FILENAME_MAX];
 #if GPXE
     char urlsave[2*FILENAME_MAX];
 #endif
@@ -273,21 +239,33 @@ static void __pxe_searchdir(const char *filename, int flags, struct file *file)
 	    break;
 
 	strlcpy(fullpath, filename, sizeof fullpath);
+	strcpy(key, fullpath);
 #if GPXE
 	strcpy(urlsave, fullpath);
 #endif
 	parse_url(&url, fullpath);
 	if (url.type == URL_SUFFIX) {
 	    snprintf(fullpath, sizeof fullpath, "%s%s", fs->cwd_name, filename);
+	    strcpy(key, fullpath);
 #if GPXE
 	    strcpy(urlsave, fullpath);
 #endif
 	    parse_url(&url, fullpath);
 	}
 
+	prev = inode;
 	inode = allocate_socket(fs);
 	if (!inode)
 	    return;			/* Allocation failure */
+
+	if (prev) {
+	    /* A redirect; the file is still cached under its first name */
+	    filecache_move(inode, prev);
+	    free_socket(prev);
+	} else if (!(flags & O_DIRECTORY) && filecache_open(inode, key)) {
+	    found_scheme = true;
+	    break;
+	}
 	
 	url_set_ip(&url);
 	
@@ -315,6 +293,7 @@ static void __pxe_searchdir(const char *filename, int flags, struct file *file)
     if (inode->size) {
 	file->inode = inode;
 	file->inode->mode = (flags & O_DIRECTORY) ? DT_DIR : DT_REG;
+	filecache_fill_start(inode);
     } else {
         free_socket(inode);
     }
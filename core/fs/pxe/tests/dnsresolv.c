@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include "unittest/unittest.h"
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <arpa/inet.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h, fs.h, timer.h and lwip/opt.h
+ * that dnsresolv.c depends on.
+ */
+#define PXE_H
+#define DNS_MAX_SERVERS	4
+
+#define is_digit(c)     (((c) >= '0') && ((c) <= '9'))
+
+struct pxe_pvt_inode {
+    int dummy;
+};
+
+typedef uint32_t mstime_t;
+typedef int32_t  mstimediff_t;
+static mstime_t now_ms;
+
+static inline mstime_t ms_timer(void)
+{
+    return now_ms;
+}
+
+static inline bool not_whitespace(char c)
+{
+  return (unsigned char)c > ' ';
+}
+
+char LocalDomain[256];
+
+int core_udp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+void core_udp_close(struct pxe_pvt_inode *socket)
+{
+}
+
+#include "../dnsresolv.c"
+
+/*
+ * The DNS servers.  Each answers every question at once, in its own
+ * way; the replies are queued and picked up by core_udp_recv().
+ */
+#define SERVER(n)	htonl(0x0a000001 + (n))
+#define HOST_IP		htonl(0x0a010203)
+#define ALIAS_IP	htonl(0x0a010204)
+
+enum behaviour { DEAD, GOOD, SERVFAIL };
+
+static enum behaviour servers[DNS_MAX_SERVERS];
+static int sent[DNS_MAX_SERVERS];
+static uint32_t ttl = 600;
+
+struct reply {
+    uint32_t from;
+    uint16_t len;
+    uint8_t data[DNS_PKT_MAX];
+};
+
+static struct reply replies[64];
+static int reply_head, reply_tail;
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    v = htons(v);
+    memcpy(p, &v, 2);
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    v = htonl(v);
+    memcpy(p, &v, 4);
+    return p + 4;
+}
+
+/* A resource record named by a pointer to offset _name_ */
+static uint8_t *put_rr(uint8_t *p, uint16_t name, uint16_t type,
+		       uint32_t rr_ttl, uint16_t len)
+{
+    p = put16(p, 0xc000 | name);
+    p = put16(p, type);
+    p = put16(p, CLASS_IN);
+    p = put32(p, rr_ttl);
+    return put16(p, len);
+}
+
+static void answer(int n, const uint8_t *query, size_t qlen)
+{
+    struct reply *r = &replies[reply_tail++ % 64];
+    const char *name = (const char *)query + 12;
+    uint8_t *p;
+    uint16_t flags = 0x8180;	/* Response, RD, RA */
+    uint16_t ancount = 0, nscount = 0;
+
+    r->from = SERVER(n);
+    memcpy(r->data, query, qlen);
+    p = r->data + qlen;
+
+    if (servers[n] == SERVFAIL) {
+	flags |= 2;
+    } else if (!strcmp(name, "\4boot\7example\3com")) {
+	p = put_rr(p, 12, TYPE_A, ttl, 4);
+	memcpy(p, &(uint32_t){ HOST_IP }, 4);
+	p += 4;
+	ancount = 1;
+    } else if (!strcmp(name, "\5alias\7example\3com")) {
+	/* alias is a CNAME for www.example.com */
+	uint16_t target = p + 12 - r->data;
+
+	p = put_rr(p, 12, TYPE_CNAME, ttl, 6);
+	memcpy(p, "\3www\xc0", 5);
+	p[5] = 18;		/* example.com in the question */
+	p += 6;
+	p = put_rr(p, target, TYPE_A, 30, 4);
+	memcpy(p, &(uint32_t){ ALIAS_IP }, 4);
+	p += 4;
+	ancount = 2;
+    } else {
+	/* NXDOMAIN, with an SOA whose MINIMUM is 45 seconds */
+	flags |= RCODE_NXDOMAIN;
+	p = put_rr(p, 12, TYPE_SOA, 3600, 24);
+	memset(p, 0, 20);
+	p = put32(p + 20, 45);
+	nscount = 1;
+    }
+
+    put16(r->data + 2, flags);
+    put16(r->data + 6, ancount);
+    put16(r->data + 8, nscount);
+    r->len = p - r->data;
+}
+
+void core_udp_sendto(struct pxe_pvt_inode *socket, const void *data,
+		     size_t len, uint32_t ip, uint16_t port)
+{
+    int n;
+
+    syslinux_assert_str(port == DNS_PORT, "Sent to port %u", port);
+    for (n = 0; n < DNS_MAX_SERVERS; n++) {
+	if (ip == SERVER(n))
+	    break;
+    }
+    syslinux_assert_str(n < DNS_MAX_SERVERS, "Sent to a stranger");
+
+    sent[n]++;
+    if (servers[n] != DEAD)
+	answer(n, data, len);
+}
+
+int core_udp_recv(struct pxe_pvt_inode *socket, void *buf, uint16_t *buf_len,
+		  uint32_t *src_ip, uint16_t *src_port)
+{
+    struct reply *r;
+
+    if (reply_head == reply_tail) {
+	now_ms += 10;		/* Nothing there; time passes */
+	return -1;
+    }
+
+    r = &replies[reply_head++ % 64];
+    memcpy(buf, r->data, r->len < *buf_len ? r->len : *buf_len);
+    *buf_len = r->len;
+    *src_ip = r->from;
+    *src_port = DNS_PORT;
+    return 0;
+}
+
+static void setup(enum behaviour s0, enum behaviour s1, enum behaviour s2)
+{
+    int n;
+
+    servers[0] = s0;
+    servers[1] = s1;
+    servers[2] = s2;
+    for (n = 0; n < DNS_MAX_SERVERS; n++) {
+	dns_server[n] = n < 3 ? SERVER(n) : 0;
+	sent[n] = 0;
+    }
+}
+
+static int total_sent(void)
+{
+    return sent[0] + sent[1] + sent[2] + sent[3];
+}
+
+/*
+ * All the servers are asked at once, so a dead one costs nothing, and
+ * the answer is remembered for its TTL.
+ */
+static void test_parallel(void)
+{
+    mstime_t start = now_ms;
+
+    setup(DEAD, SERVFAIL, GOOD);
+    syslinux_assert_str(pxe_dns("boot.example.com") == HOST_IP,
+			"Wrong address");
+    syslinux_assert_str(now_ms - start < 1000,
+			"Took %u ms", now_ms - start);
+    syslinux_assert_str(sent[0] == 1 && sent[1] == 1 && sent[2] == 1,
+			"Servers not asked once each");
+
+    setup(DEAD, DEAD, DEAD);
+    syslinux_assert_str(pxe_dns("BOOT.example.com") == HOST_IP,
+			"Not answered from the cache");
+    syslinux_assert_str(!total_sent(), "Cached name was asked for");
+
+    now_ms += ttl * 1000;
+    setup(GOOD, DEAD, DEAD);
+    syslinux_assert_str(pxe_dns("boot.example.com") == HOST_IP &&
+			sent[0] == 1, "Expired name was not asked for");
+}
+
+/*
+ * An unqualified name gets the local domain, and a CNAME is followed
+ * with the shortest TTL in the chain.
+ */
+static void test_cname(void)
+{
+    strcpy(LocalDomain, "example.com");
+    setup(GOOD, DEAD, DEAD);
+    syslinux_assert_str(pxe_dns("alias") == ALIAS_IP, "CNAME not followed");
+
+    now_ms += 31 * 1000;
+    setup(GOOD, DEAD, DEAD);
+    pxe_dns("alias");
+    syslinux_assert_str(sent[0] == 1, "CNAME kept longer than its A record");
+    LocalDomain[0] = '\0';
+}
+
+/*
+ * A name that doesn't exist is remembered for the SOA's MINIMUM; when
+ * every server fails nothing is remembered.
+ */
+static void test_negative(void)
+{
+    setup(GOOD, GOOD, DEAD);
+    syslinux_assert_str(!pxe_dns("nowhere.example.com"), "Name resolved");
+
+    setup(GOOD, DEAD, DEAD);
+    syslinux_assert_str(!pxe_dns("nowhere.example.com") && !total_sent(),
+			"Negative answer was not remembered");
+
+    now_ms += 46 * 1000;
+    pxe_dns("nowhere.example.com");
+    syslinux_assert_str(sent[0] == 1, "Negative answer kept too long");
+
+    setup(SERVFAIL, SERVFAIL, SERVFAIL);
+    syslinux_assert_str(!pxe_dns("other.example.com"), "Failure resolved");
+    setup(GOOD, DEAD, DEAD);
+    pxe_dns("other.example.com");
+    syslinux_assert_str(sent[0] == 1, "Server failure was remembered");
+}
+
+/*
+ * Prefetching asks for every name in one round.
+ */
+static void test_prefetch(void)
+{
+    mstime_t start;
+
+    now_ms += DNS_MAX_TTL * 1000;
+    setup(DEAD, GOOD, DEAD);
+    start = now_ms;
+    pxe_dns_prefetch("  boot.example.com\talias.example.com 10.0.0.1 "
+		     "missing.example.com");
+    syslinux_assert_str(sent[1] == 3, "Sent %d questions", sent[1]);
+    syslinux_assert_str(now_ms - start < 1000, "Took %u ms", now_ms - start);
+
+    setup(DEAD, DEAD, DEAD);
+    syslinux_assert_str(pxe_dns("boot.example.com") == HOST_IP &&
+			pxe_dns("alias.example.com") == ALIAS_IP &&
+			!pxe_dns("missing.example.com") && !total_sent(),
+			"Prefetched names not remembered");
+    syslinux_assert_str(pxe_dns("10.1.2.3") == htonl(0x0a010203),
+			"Dotted quad");
+}
+
+int main(int argc, char **argv)
+{
+    now_ms = 12345;
+
+    test_parallel();
+    test_cname();
+    test_negative();
+    test_prefetch();
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+#define _GNU_SOURCE
+#include "unittest/unittest.h"
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h and fs.h that filecache.c
+ * depends on.
+ */
+#define PXE_H
+#define PREFETCH_MAX	16
+
+struct inode;
+
+struct pxe_conn_ops {
+    void (*fill_buffer)(struct inode *inode);
+    void (*close)(struct inode *inode);
+    int (*readdir)(struct inode *inode, void *dirent);
+};
+
+struct pxe_pvt_inode {
+    uint32_t tftp_filepos;
+    uint16_t tftp_bytesleft;
+    char    *tftp_dataptr;
+    uint8_t  tftp_goteof;
+    struct filecache_entry *fc_entry;
+    struct filecache_fill *fc_fill;
+    const struct pxe_conn_ops *ops;
+};
+
+struct inode {
+    uint64_t size;
+    struct pxe_pvt_inode pvt[1];
+};
+
+#define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
+
+static void *zalloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+void filecache_serve(struct inode *inode);
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg)
+{
+}
+
+void syslinux_trace_end(const char *name, uint32_t arg)
+{
+}
+
+#include "../filecache.c"
+#include "../getc.c"
+
+/*
+ * A server stand-in, handing the file out in pieces.
+ */
+#define PIECE		1000
+
+static char file_data[64 * 1024];
+static uint32_t file_size;
+static int transfers;
+
+static void server_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    uint32_t len = file_size - socket->tftp_filepos;
+
+    if (len > PIECE)
+	len = PIECE;
+
+    socket->tftp_dataptr = file_data + socket->tftp_filepos;
+    socket->tftp_bytesleft = len;
+    socket->tftp_filepos += len;
+    if (socket->tftp_filepos == file_size)
+	socket->tftp_goteof = 1;
+}
+
+static void server_close(struct inode *inode)
+{
+}
+
+static const struct pxe_conn_ops server_conn_ops = {
+    .fill_buffer	= server_fill_buffer,
+    .close		= server_close,
+};
+
+/* As __pxe_searchdir() does, for a file without validators */
+static void open_it(struct inode *inode, const char *key, uint32_t size)
+{
+    memset(inode, 0, sizeof *inode);
+    if (filecache_open(inode, key))
+	return;
+
+    transfers++;
+    file_size = size;
+    inode->size = size;
+    PVT(inode)->ops = &server_conn_ops;
+    filecache_fill_start(inode);
+}
+
+/* As pxe_getfssec() and pxe_close_file() do */
+static uint32_t read_close(struct inode *inode, char *buf, uint32_t max)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    uint32_t pos = 0;
+
+    while (pos < max) {
+	if (!socket->tftp_bytesleft) {
+	    if (socket->tftp_goteof)
+		break;
+	    pxe_fill_buffer(inode);
+	}
+	memcpy(buf + pos, socket->tftp_dataptr, socket->tftp_bytesleft);
+	pos += socket->tftp_bytesleft;
+	socket->tftp_bytesleft = 0;
+    }
+
+    filecache_fill_end(inode);
+    filecache_release(inode);
+    return pos;
+}
+
+/*
+ * A file read to the end is kept, and the next open reads the copy.
+ */
+static void test_hit(void)
+{
+    static char buf[sizeof file_data];
+    struct inode inode;
+    uint32_t len;
+
+    transfers = 0;
+    open_it(&inode, "::pxelinux.cfg/default", 5000);
+    len = read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(len == 5000, "First read gave %u bytes", len);
+
+    file_data[0] ^= 0xff;	/* Any read from the server would differ */
+    open_it(&inode, "::pxelinux.cfg/default", 5000);
+    syslinux_assert_str(PVT(&inode)->ops == &filecache_conn_ops,
+			"Not served from the cache");
+    syslinux_assert_str(inode.size == 5000, "Cached size is %llu",
+			(unsigned long long)inode.size);
+    len = read_close(&inode, buf, sizeof buf);
+    file_data[0] ^= 0xff;
+
+    syslinux_assert_str(transfers == 1, "%d transfers", transfers);
+    syslinux_assert_str(len == 5000 && !memcmp(buf, file_data, len),
+			"Cached copy differs");
+}
+
+/*
+ * A file closed early, or which ended short of its announced length,
+ * is not kept.
+ */
+static void test_partial(void)
+{
+    static char buf[sizeof file_data];
+    struct inode inode;
+
+    transfers = 0;
+    open_it(&inode, "early", 5000);
+    read_close(&inode, buf, 2000);
+    open_it(&inode, "early", 5000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 2, "Early close: %d transfers",
+			transfers);
+
+    open_it(&inode, "short", 5000);
+    filecache_fill_info(&inode, NULL, NULL, 6000);
+    read_close(&inode, buf, sizeof buf);
+    open_it(&inode, "short", 5000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 4, "Short file: %d transfers",
+			transfers);
+}
+
+/*
+ * A copy with validators is only read after a conditional request.
+ */
+static void test_validators(void)
+{
+    static char buf[sizeof file_data];
+    struct inode inode;
+    const char *etag, *lastmod;
+
+    open_it(&inode, "http://boot/menu.c32", 3000);
+    filecache_fill_info(&inode, "\"abc\"", "", -1);
+    read_close(&inode, buf, sizeof buf);
+
+    memset(&inode, 0, sizeof inode);
+    syslinux_assert_str(!filecache_open(&inode, "http://boot/menu.c32"),
+			"Served without revalidating");
+    syslinux_assert_str(filecache_validators(&inode, &etag, &lastmod) &&
+			etag && !strcmp(etag, "\"abc\"") && !lastmod,
+			"Wrong validators");
+
+    /* The server says 304 */
+    filecache_serve(&inode);
+    syslinux_assert_str(read_close(&inode, buf, sizeof buf) == 3000 &&
+			!memcmp(buf, file_data, 3000), "Revalidated copy differs");
+}
+
+/*
+ * The least recently used files go to make room, but stay readable
+ * while open; files too big for the budget are never kept.
+ */
+static void test_budget(void)
+{
+    static char buf[sizeof file_data];
+    struct inode inode, reader;
+    char key[8];
+    int i;
+
+    NetCache = 64;		/* 16K per file at most */
+
+    for (i = 0; i < 5; i++) {
+	sprintf(key, "f%d", i);
+	open_it(&inode, key, 15000);
+	read_close(&inode, buf, sizeof buf);
+    }
+    syslinux_assert_str(cache_used <= 64 * 1024, "%u bytes in use",
+			cache_used);
+
+    transfers = 0;
+    open_it(&inode, "f0", 15000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 1, "Oldest file was not dropped");
+
+    /* f4 is open while the files after it push it out */
+    open_it(&reader, "f4", 15000);
+    syslinux_assert_str(transfers == 1, "f4 was dropped too soon");
+    for (i = 5; i < 10; i++) {
+	sprintf(key, "f%d", i);
+	open_it(&inode, key, 15000);
+	read_close(&inode, buf, sizeof buf);
+    }
+    syslinux_assert_str(read_close(&reader, buf, sizeof buf) == 15000 &&
+			!memcmp(buf, file_data, 15000), "Dropped copy differs");
+
+    transfers = 0;
+    open_it(&inode, "big", 20000);
+    read_close(&inode, buf, sizeof buf);
+    open_it(&inode, "big", 20000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 2, "Big file was kept");
+
+    NetCache = 0;
+    open_it(&inode, "f9", 15000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 3, "Cache used while turned off");
+}
+
+/*
+ * A prefetched file is kept whatever its size, outside the budget,
+ * and only for its first reader.
+ */
+static void test_prefetch(void)
+{
+    static char buf[sizeof file_data];
+    struct inode inode;
+    uint32_t used = cache_used;
+
+    NetCache = 64;
+    transfers = 0;
+
+    filecache_prefetch(true);
+    open_it(&inode, "initrd", 40000);
+    read_close(&inode, buf, sizeof buf);
+    open_it(&inode, "stale", 1000);
+    read_close(&inode, buf, sizeof buf);
+    filecache_prefetch(false);
+    syslinux_assert_str(cache_used == used, "Prefetched files counted");
+
+    open_it(&inode, "initrd", 40000);
+    syslinux_assert_str(transfers == 2, "Prefetched file was not kept");
+    syslinux_assert_str(read_close(&inode, buf, sizeof buf) == 40000 &&
+			!memcmp(buf, file_data, 40000), "Prefetched copy differs");
+
+    open_it(&inode, "initrd", 40000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 3, "Prefetched file read twice");
+
+    /* The next prefetch drops what nobody read */
+    filecache_prefetch(true);
+    filecache_prefetch(false);
+    open_it(&inode, "stale", 1000);
+    read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(transfers == 4, "Unread prefetched file kept");
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < sizeof file_data; i++)
+	file_data[i] = i * 7 + (i >> 9);
+
+    test_hit();
+    test_partial();
+    test_validators();
+    test_budget();
+    test_prefetch();
+
+    return 0;
+}
@@ -0,0 +1,345 @@
+#define _GNU_SOURCE
+#include "unittest/unittest.h"
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <zlib.h>
+#include <syslinux/sysappend.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h and fs.h that http.c and
+ * filecache.c depend on.
+ */
+#define PXE_H
+#define PREFETCH_MAX	16
+
+struct inode;
+struct dirent;
+
+struct pxe_conn_ops {
+    void (*fill_buffer)(struct inode *inode);
+    void (*close)(struct inode *inode);
+    int (*readdir)(struct inode *inode, struct dirent *dirent);
+};
+
+struct pxe_pvt_inode {
+    uint32_t tftp_filepos;
+    uint16_t tftp_bytesleft;
+    char    *tftp_dataptr;
+    uint8_t  tftp_goteof;
+    char    *tftp_pktbuf;
+    struct filecache_entry *fc_entry;
+    struct filecache_fill *fc_fill;
+    const struct pxe_conn_ops *ops;
+};
+
+struct inode {
+    uint64_t size;
+    struct pxe_pvt_inode pvt[1];
+};
+
+#define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
+
+const char *sysappend_strings[SYSAPPEND_MAX];
+
+static size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    memcpy(dst, src, len < size ? len : size);
+    dst[len < size ? len : size] = '\0';
+    return len;
+}
+
+static void *zalloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+size_t url_escape_unsafe(char *output, const char *input, size_t bufsize)
+{
+    return strlcpy(output, input, bufsize);
+}
+
+int http_readdir(struct inode *inode, struct dirent *dirent)
+{
+    return -1;
+}
+
+void filecache_serve(struct inode *inode);
+
+#include "../filecache.c"
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg)
+{
+}
+
+void syslinux_trace_end(const char *name, uint32_t arg)
+{
+}
+
+#include "../getc.c"
+
+/*
+ * A server stand-in.  /old redirects to /vmlinuz; /vmlinuz is served
+ * with an ETag and a Content-Length, gzip'd if asked for and allowed,
+ * and a request which names the current ETag gets a 304.
+ */
+#define PIECE		1000
+#define BODY_SIZE	100000
+
+static char body[BODY_SIZE];
+static char request[1024];
+static char response[2 * BODY_SIZE];
+static size_t response_len, response_pos;
+static bool send_etag, send_length, send_gzip;
+static int requests, full_responses;
+
+int core_tcp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+int core_tcp_connect(struct pxe_pvt_inode *socket, uint32_t ip, uint16_t port)
+{
+    return 0;
+}
+
+static void respond(void)
+{
+    bool gzip = send_gzip && strstr(request, "\r\nAccept-Encoding: gzip\r\n");
+    z_stream zs;
+
+    requests++;
+
+    if (!strncmp(request, "GET /old ", 9)) {
+	response_len = sprintf(response, "HTTP/1.1 302 Found\r\n"
+			       "Location: http://boot/vmlinuz\r\n"
+			       "Content-Length: 5\r\n\r\nmoved");
+	return;
+    }
+
+    if (send_etag && strstr(request, "\r\nIf-None-Match: \"v1\"\r\n")) {
+	response_len = sprintf(response, "HTTP/1.1 304 Not Modified\r\n\r\n");
+	return;
+    }
+
+    full_responses++;
+    response_len = sprintf(response, "HTTP/1.1 200 OK\r\n");
+    if (send_etag)
+	response_len += sprintf(response + response_len, "ETag: \"v1\"\r\n");
+    if (gzip)
+	response_len += sprintf(response + response_len,
+				"Content-Encoding: gzip\r\n\r\n");
+    else if (send_length)
+	response_len += sprintf(response + response_len,
+				"Content-Length: %d\r\n\r\n", BODY_SIZE);
+    else
+	response_len += sprintf(response + response_len, "\r\n");
+
+    if (gzip) {
+	memset(&zs, 0, sizeof zs);
+	deflateInit2(&zs, 9, Z_DEFLATED, 16 + MAX_WBITS, 8,
+		     Z_DEFAULT_STRATEGY);
+	zs.next_in = (Bytef *)body;
+	zs.avail_in = sizeof body;
+	zs.next_out = (Bytef *)response + response_len;
+	zs.avail_out = sizeof response - response_len;
+	deflate(&zs, Z_FINISH);
+	response_len += zs.total_out;
+	deflateEnd(&zs);
+    } else {
+	memcpy(response + response_len, body, sizeof body);
+	response_len += sizeof body;
+    }
+}
+
+int core_tcp_write(struct pxe_pvt_inode *socket, const void *data,
+		   size_t len, bool copy)
+{
+    if (len >= sizeof request)
+	len = sizeof request - 1;
+    memcpy(request, data, len);
+    request[len] = '\0';
+
+    respond();
+    response_pos = 0;
+    return 0;
+}
+
+void core_tcp_close_file(struct inode *inode)
+{
+}
+
+void core_tcp_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    static char piece[PIECE];
+    size_t len = response_len - response_pos;
+
+    if (!len) {
+	socket->tftp_goteof = 1;
+	if (inode->size == (uint64_t)-1)
+	    inode->size = socket->tftp_filepos;
+	socket->ops->close(inode);
+	return;
+    }
+
+    if (len > PIECE)
+	len = PIECE;
+    memcpy(piece, response + response_pos, len);
+    response_pos += len;
+
+    socket->tftp_dataptr = piece;
+    socket->tftp_filepos += len;
+    socket->tftp_bytesleft = len;
+}
+
+#include "../http.c"
+
+/* As __pxe_searchdir() does, following redirects */
+static bool open_it(struct inode *inode, const char *name)
+{
+    static char host[] = "boot";
+    static char path[FILENAME_MAX];
+    struct url_info url = { .host = host, .path = path, .port = HTTP_PORT };
+    struct inode *prev = NULL;
+    const char *redir;
+    char key[FILENAME_MAX];
+    int redirects = 0;
+
+    snprintf(key, sizeof key, "http://boot%s", name);
+    strcpy(path, name);
+
+    for (;;) {
+	memset(inode, 0, sizeof *inode);
+	if (prev) {
+	    filecache_move(inode, prev);
+	    filecache_release(prev);
+	    free(PVT(prev)->tftp_pktbuf);
+	    free(prev);
+	    prev = NULL;
+	} else if (filecache_open(inode, key)) {
+	    break;
+	}
+
+	redir = NULL;
+	http_open(&url, 0, inode, &redir);
+	if (!redir)
+	    break;
+
+	syslinux_assert_str(!strcmp(redir, "http://boot/vmlinuz"),
+			    "Redirected to %s", redir);
+	syslinux_assert_str(++redirects < 5, "Redirect loop");
+	strcpy(path, redir + strlen("http://boot"));
+	prev = malloc(sizeof *prev);
+	memcpy(prev, inode, sizeof *prev);
+    }
+
+    if (!inode->size) {
+	filecache_release(inode);
+	return false;
+    }
+    filecache_fill_start(inode);
+    return true;
+}
+
+/* As pxe_getfssec() and pxe_close_file() do */
+static size_t read_close(struct inode *inode, char *buf, size_t size)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    size_t pos = 0;
+
+    for (;;) {
+	if (!socket->tftp_bytesleft) {
+	    if (socket->tftp_goteof)
+		break;
+	    pxe_fill_buffer(inode);
+	}
+	syslinux_assert_str(pos + socket->tftp_bytesleft <= size,
+			    "Read past the end of the file");
+	memcpy(buf + pos, socket->tftp_dataptr, socket->tftp_bytesleft);
+	pos += socket->tftp_bytesleft;
+	socket->tftp_bytesleft = 0;
+    }
+
+    filecache_fill_end(inode);
+    filecache_release(inode);
+    free(socket->tftp_pktbuf);
+    return pos;
+}
+
+static void forget_all(void)
+{
+    while (lru_head)
+	filecache_drop(lru_head);
+    requests = full_responses = 0;
+}
+
+/*
+ * Reads the file twice; the second time must come from the cache,
+ * with no body sent by the server, and be the body and nothing else.
+ */
+static void check_cached(const char *what, const char *name)
+{
+    static char buf[BODY_SIZE];
+    struct inode inode;
+    size_t len;
+
+    forget_all();
+
+    syslinux_assert_str(open_it(&inode, name), "%s: open failed", what);
+    len = read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(len == BODY_SIZE && !memcmp(buf, body, len),
+			"%s: first read gave %zu bytes", what, len);
+
+    syslinux_assert_str(lru_head && lru_head->size == BODY_SIZE &&
+			!memcmp(lru_head->data, body, BODY_SIZE),
+			"%s: cached copy is %u bytes, or differs", what,
+			lru_head ? lru_head->size : 0);
+
+    syslinux_assert_str(open_it(&inode, name), "%s: reopen failed", what);
+    syslinux_assert_str(PVT(&inode)->ops == &filecache_conn_ops,
+			"%s: reopened file not read from memory", what);
+    len = read_close(&inode, buf, sizeof buf);
+    syslinux_assert_str(len == BODY_SIZE && !memcmp(buf, body, len),
+			"%s: cached read gave %zu bytes", what, len);
+    syslinux_assert_str(full_responses == 1, "%s: %d bodies sent", what,
+			full_responses);
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < BODY_SIZE; i++)
+	body[i] = "syslinux"[(i * 7 + (i >> 10)) & 7] ^ (i >> 13);
+
+    http_bake_cookies();
+    NetCache = 1024;
+
+    send_length = true;
+    check_cached("Content-Length", "/vmlinuz");
+
+    send_etag = true;
+    check_cached("Content-Length and ETag", "/vmlinuz");
+    syslinux_assert_str(requests == 2, "ETag: %d requests", requests);
+
+    send_etag = send_length = false;
+    check_cached("no length", "/vmlinuz");
+
+    send_gzip = true;
+    check_cached("gzip", "/vmlinuz");
+    send_gzip = false;
+
+    send_length = true;
+    check_cached("redirect", "/old");
+
+    return 0;
+}
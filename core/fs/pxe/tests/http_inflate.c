@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+#include "unittest/unittest.h"
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <zlib.h>
+#include <syslinux/sysappend.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h and fs.h that http.c
+ * depends on.
+ */
+#define PXE_H
+
+struct inode;
+struct dirent;
+
+struct pxe_conn_ops {
+    void (*fill_buffer)(struct inode *inode);
+    void (*close)(struct inode *inode);
+    int (*readdir)(struct inode *inode, struct dirent *dirent);
+};
+
+struct pxe_pvt_inode {
+    uint32_t tftp_filepos;
+    uint16_t tftp_bytesleft;
+    char    *tftp_dataptr;
+    uint8_t  tftp_goteof;
+    char    *tftp_pktbuf;
+    const struct pxe_conn_ops *ops;
+};
+
+struct inode {
+    uint64_t size;
+    struct pxe_pvt_inode pvt[1];
+};
+
+#define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
+
+const char *sysappend_strings[SYSAPPEND_MAX];
+
+static size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    memcpy(dst, src, len < size ? len : size);
+    dst[len < size ? len : size] = '\0';
+    return len;
+}
+
+size_t url_escape_unsafe(char *output, const char *input, size_t bufsize)
+{
+    return strlcpy(output, input, bufsize);
+}
+
+int http_readdir(struct inode *inode, struct dirent *dirent)
+{
+    return -1;
+}
+
+/*
+ * The file cache, as seen by http.c: with cached_etag set there is a
+ * copy to revalidate.
+ */
+static const char *cached_etag;
+static bool served_cached;
+static char fill_etag[64];
+
+bool filecache_validators(struct inode *inode,
+			  const char **etag, const char **lastmod)
+{
+    *etag = cached_etag;
+    *lastmod = NULL;
+    return cached_etag != NULL;
+}
+
+void filecache_fill_info(struct inode *inode, const char *etag,
+			 const char *lastmod, uint32_t length)
+{
+    strcpy(fill_etag, etag);
+}
+
+void filecache_serve(struct inode *inode)
+{
+    served_cached = true;
+    inode->size = 1;
+}
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg)
+{
+}
+
+void syslinux_trace_end(const char *name, uint32_t arg)
+{
+}
+
+void filecache_record(struct inode *inode)
+{
+}
+
+#include "../getc.c"
+
+/*
+ * A server stand-in: the response goes out in small pieces, the way
+ * TCP segments would arrive.
+ */
+#define PIECE		1000
+#define BODY_SIZE	100000
+
+static char request[1024];
+static char response[2 * BODY_SIZE];
+static size_t response_len, response_pos;
+static int tcp_closes;
+
+int core_tcp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+int core_tcp_connect(struct pxe_pvt_inode *socket, uint32_t ip, uint16_t port)
+{
+    return 0;
+}
+
+int core_tcp_write(struct pxe_pvt_inode *socket, const void *data,
+		   size_t len, bool copy)
+{
+    memcpy(request, data, len < sizeof request ? len : sizeof request - 1);
+    return 0;
+}
+
+void core_tcp_close_file(struct inode *inode)
+{
+    tcp_closes++;
+}
+
+void core_tcp_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    static char piece[PIECE];
+    size_t len = response_len - response_pos;
+
+    if (!len) {
+	socket->tftp_goteof = 1;
+	if (inode->size == (uint64_t)-1)
+	    inode->size = socket->tftp_filepos;
+	socket->ops->close(inode);
+	return;
+    }
+
+    if (len > PIECE)
+	len = PIECE;
+    memcpy(piece, response + response_pos, len);
+    response_pos += len;
+
+    socket->tftp_dataptr = piece;
+    socket->tftp_filepos += len;
+    socket->tftp_bytesleft = len;
+}
+
+#include "../http.c"
+
+static char body[BODY_SIZE];
+
+static void serve(const char *encoding, bool compress, size_t cut)
+{
+    z_stream zs;
+
+    response_len = sprintf(response, "HTTP/1.0 200 OK\r\n"
+			   "ETag: \"v2\"\r\n"
+			   "Content-Type: application/octet-stream\r\n");
+    if (encoding)
+	response_len += sprintf(response + response_len,
+				"Content-Encoding: %s\r\n", encoding);
+    response_len += sprintf(response + response_len, "\r\n");
+
+    if (compress) {
+	memset(&zs, 0, sizeof zs);
+	deflateInit2(&zs, 9, Z_DEFLATED, 16 + MAX_WBITS, 8,
+		     Z_DEFAULT_STRATEGY);
+	zs.next_in = (Bytef *)body;
+	zs.avail_in = sizeof body;
+	zs.next_out = (Bytef *)response + response_len;
+	zs.avail_out = sizeof response - response_len;
+	deflate(&zs, Z_FINISH);
+	response_len += zs.total_out;
+	deflateEnd(&zs);
+    } else {
+	memcpy(response + response_len, body, sizeof body);
+	response_len += sizeof body;
+    }
+
+    response_len -= cut;
+    response_pos = 0;
+    tcp_closes = 0;
+}
+
+static void open_it(struct inode *inode)
+{
+    static char path[] = "vmlinuz";
+    static char host[] = "boot.example.com";
+    struct url_info url = {
+	.host = host,
+	.path = path,
+    };
+    const char *redir = NULL;
+
+    memset(inode, 0, sizeof *inode);
+    http_open(&url, 0, inode, &redir);
+}
+
+static size_t read_file(struct inode *inode, char *buf, size_t size)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    size_t pos = 0;
+
+    for (;;) {
+	if (!socket->tftp_bytesleft) {
+	    if (socket->tftp_goteof)
+		break;
+	    pxe_fill_buffer(inode);
+	}
+	syslinux_assert_str(pos + socket->tftp_bytesleft <= size,
+			    "Read past the end of the file");
+	memcpy(buf + pos, socket->tftp_dataptr, socket->tftp_bytesleft);
+	pos += socket->tftp_bytesleft;
+	socket->tftp_bytesleft = 0;
+    }
+
+    return pos;
+}
+
+/*
+ * A gzip'd body comes out decompressed, and the Content-Encoding
+ * header is seen even when it is the last one.
+ */
+static void test_gzip(void)
+{
+    static char buf[BODY_SIZE];
+    struct inode inode;
+    size_t len;
+
+    serve("gzip", true, 0);
+    open_it(&inode);
+
+    syslinux_assert_str(strstr(request, "\r\nAccept-Encoding: gzip\r\n"),
+			"No Accept-Encoding in the request");
+    syslinux_assert_str(PVT(&inode)->ops == &http_inflate_conn_ops,
+			"Body is not being inflated");
+
+    len = read_file(&inode, buf, sizeof buf);
+    syslinux_assert_str(len == BODY_SIZE, "Read %zu bytes", len);
+    syslinux_assert_str(!memcmp(buf, body, BODY_SIZE), "Body differs");
+    syslinux_assert_str(inode.size == BODY_SIZE,
+			"Size is %llu", (unsigned long long)inode.size);
+    syslinux_assert_str(tcp_closes == 1, "Closed %d times", tcp_closes);
+
+    free(PVT(&inode)->tftp_pktbuf);
+}
+
+/*
+ * A body without Content-Encoding is read as it is.
+ */
+static void test_plain(void)
+{
+    static char buf[BODY_SIZE];
+    struct inode inode;
+    size_t len;
+
+    serve(NULL, false, 0);
+    open_it(&inode);
+
+    syslinux_assert_str(PVT(&inode)->ops == &http_conn_ops,
+			"Plain body is being inflated");
+    len = read_file(&inode, buf, sizeof buf);
+    syslinux_assert_str(len == BODY_SIZE && !memcmp(buf, body, BODY_SIZE),
+			"Plain body differs");
+}
+
+/*
+ * A file closed half way, and a truncated stream, each close the
+ * connection exactly once.
+ */
+static void test_close(void)
+{
+    static char buf[BODY_SIZE];
+    struct inode inode;
+    size_t len;
+
+    serve("x-gzip", true, 0);
+    open_it(&inode);
+    PVT(&inode)->ops->fill_buffer(&inode);
+    PVT(&inode)->ops->close(&inode);
+    syslinux_assert_str(tcp_closes == 1, "Early close: closed %d times",
+			tcp_closes);
+    free(PVT(&inode)->tftp_pktbuf);
+
+    serve("gzip", true, 100);
+    open_it(&inode);
+    len = read_file(&inode, buf, sizeof buf);
+    syslinux_assert_str(len < BODY_SIZE && !memcmp(buf, body, len),
+			"Truncated stream gave %zu bytes", len);
+    syslinux_assert_str(tcp_closes == 1, "Truncated: closed %d times",
+			tcp_closes);
+    free(PVT(&inode)->tftp_pktbuf);
+}
+
+/*
+ * With a cached copy the request is conditional, and a 304 reads the
+ * copy; a 200 brings the new validators.
+ */
+static void test_conditional(void)
+{
+    static char buf[BODY_SIZE];
+    struct inode inode;
+
+    serve(NULL, false, 0);
+    response_len = sprintf(response, "HTTP/1.0 304 Not Modified\r\n\r\n");
+    cached_etag = "\"v1\"";
+    served_cached = false;
+    open_it(&inode);
+
+    syslinux_assert_str(strstr(request, "\r\nIf-None-Match: \"v1\"\r\n\r\n"),
+			"No If-None-Match in the request");
+    syslinux_assert_str(served_cached && inode.size,
+			"304 did not read the cached copy");
+    syslinux_assert_str(tcp_closes == 1, "304: closed %d times", tcp_closes);
+
+    serve(NULL, false, 0);
+    served_cached = false;
+    fill_etag[0] = '\0';
+    open_it(&inode);
+    syslinux_assert_str(!served_cached && !strcmp(fill_etag, "\"v2\""),
+			"200 did not give the new ETag");
+    read_file(&inode, buf, sizeof buf);
+    cached_etag = NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    /* Compressible, but not trivially so */
+    for (i = 0; i < BODY_SIZE; i++)
+	body[i] = "syslinux"[(i * 7 + (i >> 10)) & 7] ^ (i >> 13);
+
+    http_bake_cookies();
+
+    test_gzip();
+    test_plain();
+    test_close();
+    test_conditional();
+
+    return 0;
+}
@@ -0,0 +1,736 @@
+/*
+ * TFTP and HTTP client benchmark.
+ *
+ * tftp.c and http.c, built for the host, fetch a file from server
+ * stand-ins in this program over a simulated link: a one-way latency,
+ * a line rate, an MTU, and packet loss drawn from a seeded generator,
+ * so that a run gives the same figures every time.  The clock is
+ * virtual and only moves while the client waits on the network.
+ *
+ * The figures are the throughput in virtual time, the time to the
+ * first byte of file data, the TFTP timeouts and retransmits from
+ * net_iostat, the packets lost each way, and the host CPU time the
+ * client took.  The file contents are checked as well.
+ *
+ * The TFTP server answers each ACK with the next block, and resends a
+ * block when its ACK comes again, as tftp-hpa does.  The TCP server
+ * is a simple Reno: a window of 10 segments growing up to the
+ * client's receive window, a loss costing a round trip while enough
+ * is in flight for a fast retransmit and the retransmit timer
+ * otherwise, and data handed to the client in order.
+ *
+ * Usage: netbench [-l latency_ms] [-b mbit] [-m mtu] [-p loss_pct]
+ *		   [-w window_kb] [-s size_kb] [-S seed] [tftp|http|gzip ...]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include <syslinux/sysappend.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h, fs.h and timer.h that tftp.c and
+ * http.c depend on; pxe.c does the rest of the job in the core, and
+ * here that is the read loop in fetch().
+ */
+#define PXE_H
+#define PKTBUF_SIZE	2048
+
+/* The TFTP opcodes are used as case labels, so these must be constant */
+#undef htons
+#undef ntohs
+#define htons(x)	((uint16_t)(((x) << 8) | ((uint16_t)(x) >> 8)))
+#define ntohs(x)	htons(x)
+
+struct inode;
+struct dirent;
+
+struct pxe_conn_ops {
+    void (*fill_buffer)(struct inode *inode);
+    void (*close)(struct inode *inode);
+    int (*readdir)(struct inode *inode, struct dirent *dirent);
+};
+
+struct pxe_pvt_inode {
+    uint16_t tftp_remoteport;
+    uint32_t tftp_filepos;
+    uint32_t tftp_blksize;
+    uint16_t tftp_bytesleft;
+    uint16_t tftp_lastpkt;
+    char    *tftp_dataptr;
+    uint8_t  tftp_goteof;
+    char    *tftp_pktbuf;
+    struct tftp_mcast *tftp_mc;
+    const struct pxe_conn_ops *ops;
+};
+
+struct inode {
+    uint64_t size;
+    struct pxe_pvt_inode pvt[1];
+};
+
+#define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
+
+/* The virtual clock, in ns; a jiffy is a BIOS timer tick */
+#define JIFFY_NS	54925439ULL
+
+static uint64_t now_ns;
+
+typedef uint32_t jiffies_t;
+
+static inline jiffies_t jiffies(void)
+{
+    return now_ns / JIFFY_NS;
+}
+
+static void kaboom(void)
+{
+    fprintf(stderr, "netbench: kaboom: transfer timed out\n");
+    exit(1);
+}
+
+static void *zalloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+static size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    memcpy(dst, src, len < size ? len : size);
+    dst[len < size ? len : size] = '\0';
+    return len;
+}
+
+char *url_unescape(char *buffer, char terminator)
+{
+    return buffer;
+}
+
+size_t url_escape_unsafe(char *output, const char *input, size_t bufsize)
+{
+    return strlcpy(output, input, bufsize);
+}
+
+const char *sysappend_strings[SYSAPPEND_MAX];
+
+int http_readdir(struct inode *inode, struct dirent *dirent)
+{
+    return -1;
+}
+
+bool filecache_validators(struct inode *inode,
+			  const char **etag, const char **lastmod)
+{
+    return false;
+}
+
+void filecache_fill_info(struct inode *inode, const char *etag,
+			 const char *lastmod, uint32_t length)
+{
+}
+
+void filecache_serve(struct inode *inode)
+{
+}
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg)
+{
+}
+
+void syslinux_trace_end(const char *name, uint32_t arg)
+{
+}
+
+void filecache_record(struct inode *inode)
+{
+}
+
+#include "../getc.c"
+
+struct net_iostat net_iostat;
+
+#include "../tftp.c"
+#include "../http.c"
+
+/*
+ * The link.  Each direction sends one packet at a time at the line
+ * rate; a lost packet still takes its turn on the wire.
+ */
+#define SERVER_IP	htonl(0x0a000001)
+#define SERVER_PORT	2000
+#define HDR_UDP		42	/* Ethernet, IP and UDP headers */
+#define HDR_TCP		54	/* Ethernet, IP and TCP headers */
+#define POLL_NS		1000000ULL	/* How often an idle client looks */
+#define RTO_MIN_NS	200000000ULL
+#define SYN_RTO_NS	1000000000ULL
+
+static uint64_t latency_ns = 500000;
+static uint32_t mbit = 100;
+static uint32_t mtu = 1500;
+static uint32_t loss_ppm;
+static uint32_t rwnd = 65535;
+static uint32_t seed = 1;
+
+struct link {
+    uint64_t busy;		/* The wire is free from here on */
+    uint32_t lost;
+};
+
+static struct link up, down;	/* To the server, and back */
+
+/* When a packet sent at t arrives at the other end */
+static uint64_t wire(struct link *l, uint64_t t, size_t bytes)
+{
+    if (l->busy > t)
+	t = l->busy;
+    l->busy = t + bytes * 8000 / mbit;
+    return l->busy + latency_ns;
+}
+
+static uint32_t rnd_state;
+
+static bool lost(struct link *l)
+{
+    /* xorshift32 */
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+
+    if (rnd_state % 1000000 >= loss_ppm)
+	return false;
+    l->lost++;
+    return true;
+}
+
+/*
+ * The file: two bits of noise a byte, so it compresses about as well
+ * as a kernel or an initramfs does.
+ */
+static char *file_data;
+static uint32_t file_size;
+
+static void make_file(uint32_t size)
+{
+    uint32_t i, x = 1;
+
+    file_size = size;
+    file_data = malloc(size);
+    for (i = 0; i < size; i++) {
+	x = x * 1103515245 + 12345;
+	file_data[i] = "syslinux"[(i * 7 + (i >> 10)) & 7] ^ (x >> 29);
+    }
+}
+
+/*
+ * The client's receive ring.  Packets arrive in order, since the link
+ * is a single queue; when the ring is full they are dropped.
+ */
+#define RX_RING		64
+
+struct packet {
+    uint64_t at;
+    uint16_t len;
+    char data[PKTBUF_SIZE];
+};
+
+static struct packet rx_ring[RX_RING];
+static unsigned int rx_head, rx_tail;
+
+static void server_send(const void *data, size_t len, uint64_t t)
+{
+    uint64_t at = wire(&down, t, len + HDR_UDP);
+    struct packet *pkt;
+
+    if (lost(&down))
+	return;
+    if (rx_tail - rx_head == RX_RING) {
+	down.lost++;
+	return;
+    }
+
+    pkt = &rx_ring[rx_tail++ % RX_RING];
+    pkt->at = at;
+    pkt->len = len;
+    memcpy(pkt->data, data, len);
+}
+
+/*
+ * The TFTP server.  A request is served at the time it arrives, which
+ * the client can't see before then anyway.
+ */
+static struct {
+    uint32_t blksize;
+    uint32_t nblocks;		/* Including the short last one */
+    uint32_t sent;		/* Highest block sent so far */
+    uint32_t resent;
+} tsrv;
+
+static void tftp_send_block(uint32_t blk, uint64_t t)
+{
+    char buf[PKTBUF_SIZE];
+    uint32_t pos = (blk - 1) * tsrv.blksize;
+    uint32_t len = file_size - pos < tsrv.blksize ?
+	file_size - pos : tsrv.blksize;
+
+    *(uint16_t *)buf = TFTP_DATA;
+    *(uint16_t *)(buf + 2) = htons((uint16_t)blk);
+    memcpy(buf + 4, file_data + pos, len);
+
+    if (blk <= tsrv.sent)
+	tsrv.resent++;
+    else
+	tsrv.sent = blk;
+
+    server_send(buf, len + 4, t);
+}
+
+static void tftp_server_rrq(const char *pkt, size_t len, uint64_t t)
+{
+    const char *end = pkt + len;
+    const char *p = pkt + 2;
+    char oack[128];
+    int n;
+
+    tsrv.blksize = TFTP_BLOCKSIZE;
+    tsrv.sent = 0;
+
+    /* The file name and mode, then option pairs */
+    p += strlen(p) + 1;
+    p += strlen(p) + 1;
+    while (p < end && p + strlen(p) + 1 < end) {
+	const char *val = p + strlen(p) + 1;
+
+	if (!strcasecmp(p, "blksize")) {
+	    tsrv.blksize = strtoul(val, NULL, 10);
+	    if (tsrv.blksize > mtu - 32)
+		tsrv.blksize = mtu - 32;
+	}
+	p = val + strlen(val) + 1;
+    }
+    tsrv.nblocks = file_size / tsrv.blksize + 1;
+
+    *(uint16_t *)oack = TFTP_OACK;
+    n = sprintf(oack + 2, "tsize%c%u%cblksize%c%u",
+		0, file_size, 0, 0, tsrv.blksize);
+    server_send(oack, n + 3, t);
+}
+
+static void tftp_server_ack(uint16_t ack, uint64_t t)
+{
+    /* The block being ACKed, counting back from the last one sent */
+    uint32_t blk = tsrv.sent - (uint16_t)((uint16_t)tsrv.sent - ack);
+
+    if (blk > tsrv.sent || blk + 8 < tsrv.sent)
+	return;			/* Stale */
+    if (blk < tsrv.nblocks)
+	tftp_send_block(blk + 1, t);
+}
+
+int core_udp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+int core_udp_open_group(struct pxe_pvt_inode *socket,
+			uint32_t group, uint16_t port)
+{
+    return -1;
+}
+
+void core_udp_close(struct pxe_pvt_inode *socket)
+{
+}
+
+void core_udp_connect(struct pxe_pvt_inode *socket,
+		      uint32_t ip, uint16_t port)
+{
+}
+
+void core_udp_disconnect(struct pxe_pvt_inode *socket)
+{
+}
+
+int core_udp_recv(struct pxe_pvt_inode *socket, void *buf, uint16_t *buf_len,
+		  uint32_t *src_ip, uint16_t *src_port)
+{
+    struct packet *pkt = &rx_ring[rx_head % RX_RING];
+
+    if (rx_head == rx_tail || pkt->at > now_ns) {
+	/* Nothing yet; time passes until the next look */
+	if (rx_head != rx_tail && pkt->at < now_ns + POLL_NS)
+	    now_ns = pkt->at;
+	else
+	    now_ns += POLL_NS;
+	return -1;
+    }
+
+    rx_head++;
+    memcpy(buf, pkt->data, pkt->len < *buf_len ? pkt->len : *buf_len);
+    *buf_len = pkt->len;
+    *src_ip = SERVER_IP;
+    *src_port = SERVER_PORT;
+    return 0;
+}
+
+void core_udp_send(struct pxe_pvt_inode *socket,
+		   const void *data, size_t len)
+{
+    const uint16_t *pkt = data;
+    uint64_t t = wire(&up, now_ns, len + HDR_UDP);
+
+    if (lost(&up))
+	return;
+    if (pkt[0] == TFTP_ACK)
+	tftp_server_ack(ntohs(pkt[1]), t);
+}
+
+void core_udp_sendto(struct pxe_pvt_inode *socket, const void *data,
+		     size_t len, uint32_t ip, uint16_t port)
+{
+    uint64_t t = wire(&up, now_ns, len + HDR_UDP);
+
+    if (lost(&up))
+	return;
+    if (*(const uint16_t *)data == TFTP_RRQ)
+	tftp_server_rrq(data, len, t);
+}
+
+/*
+ * The HTTP server, and TCP.  The response is scheduled segment by
+ * segment when the request arrives; seg_at is when each one can be
+ * handed to the client.
+ */
+static char *response;
+static size_t response_len;
+static uint64_t *seg_at;
+static uint32_t nsegs, seg_next, mss;
+static uint32_t segs_lost;
+static bool gzip_response;
+
+static void make_response(bool gzip)
+{
+    z_stream zs;
+    size_t max = file_size + 256;
+
+    free(response);
+    memset(&zs, 0, sizeof zs);
+    deflateInit2(&zs, 9, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    if (gzip)
+	max = deflateBound(&zs, file_size) + 256;
+    response = malloc(max);
+
+    response_len = sprintf(response, "HTTP/1.0 200 OK\r\n"
+			   "Content-Type: application/octet-stream\r\n");
+    if (gzip) {
+	response_len += sprintf(response + response_len,
+				"Content-Encoding: gzip\r\n\r\n");
+	zs.next_in = (Bytef *)file_data;
+	zs.avail_in = file_size;
+	zs.next_out = (Bytef *)response + response_len;
+	zs.avail_out = max - response_len;
+	deflate(&zs, Z_FINISH);
+	response_len += zs.total_out;
+    } else {
+	response_len += sprintf(response + response_len,
+				"Content-Length: %u\r\n\r\n", file_size);
+	memcpy(response + response_len, file_data, file_size);
+	response_len += file_size;
+    }
+    deflateEnd(&zs);
+    gzip_response = gzip;
+}
+
+static void tcp_schedule(uint64_t t)
+{
+    uint64_t rtt = 2 * latency_ns;
+    uint32_t wnd = rwnd / mss;
+    double cwnd = 10, ssthresh = wnd;
+    uint64_t at, depart, prev = 0;
+    uint32_t i, w, len;
+
+    nsegs = (response_len + mss - 1) / mss;
+    seg_at = realloc(seg_at, nsegs * sizeof *seg_at);
+    seg_next = 0;
+
+    for (i = 0; i < nsegs; i++) {
+	w = cwnd < wnd ? cwnd : wnd;
+	if (!w)
+	    w = 1;
+
+	/* Wait for the ACK that opens the window this far */
+	depart = t;
+	if (i >= w && seg_at[i - w] + latency_ns > depart)
+	    depart = seg_at[i - w] + latency_ns;
+
+	len = response_len - i * mss < mss ? response_len - i * mss : mss;
+	at = wire(&down, depart, len + HDR_TCP);
+
+	if (lost(&down)) {
+	    segs_lost++;
+	    if (w >= 4)
+		at += rtt;
+	    else
+		at += rtt * 2 > RTO_MIN_NS ? rtt * 2 : RTO_MIN_NS;
+	    ssthresh = cwnd / 2 > 2 ? cwnd / 2 : 2;
+	    cwnd = ssthresh;
+	} else if (cwnd < ssthresh) {
+	    cwnd += 1;
+	} else {
+	    cwnd += 1 / cwnd;
+	}
+
+	if (at < prev)
+	    at = prev;		/* Delivered in order */
+	seg_at[i] = prev = at;
+    }
+}
+
+int core_tcp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+int core_tcp_connect(struct pxe_pvt_inode *socket, uint32_t ip, uint16_t port)
+{
+    /* SYN, SYN-ACK; the ACK goes out with the request */
+    do
+	now_ns = wire(&up, now_ns, HDR_TCP);
+    while (lost(&up) && (now_ns += SYN_RTO_NS));
+    do
+	now_ns = wire(&down, now_ns, HDR_TCP);
+    while (lost(&down) && (now_ns += SYN_RTO_NS));
+
+    return 0;
+}
+
+int core_tcp_write(struct pxe_pvt_inode *socket, const void *data,
+		   size_t len, bool copy)
+{
+    uint64_t t = wire(&up, now_ns, len + HDR_TCP);
+
+    while (lost(&up))
+	t = wire(&up, t + RTO_MIN_NS, len + HDR_TCP);
+    tcp_schedule(t);
+    return 0;
+}
+
+void core_tcp_close_file(struct inode *inode)
+{
+}
+
+void core_tcp_fill_buffer(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    uint32_t len;
+
+    if (seg_next == nsegs) {
+	socket->tftp_goteof = 1;
+	if (inode->size == (uint64_t)-1)
+	    inode->size = socket->tftp_filepos;
+	socket->ops->close(inode);
+	return;
+    }
+
+    if (seg_at[seg_next] > now_ns) {
+	net_iostat.tcp_stall_ms += (seg_at[seg_next] - now_ns) / 1000000;
+	now_ns = seg_at[seg_next];
+    }
+
+    len = response_len - seg_next * mss;
+    if (len > mss)
+	len = mss;
+    socket->tftp_dataptr = response + seg_next * mss;
+    seg_next++;
+
+    net_iostat.tcp_bytes += len;
+    socket->tftp_filepos += len;
+    socket->tftp_bytesleft = len;
+}
+
+/*
+ * The client side: open the file and read it to the end, the way
+ * pxe_getfssec() does.
+ */
+static double cpu_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int fetch(const char *proto)
+{
+    static char path[] = "vmlinuz";
+    static char host[] = "boot.example.com";
+    struct url_info url = {
+	.host = host,
+	.path = path,
+	.ip = SERVER_IP,
+    };
+    struct inode inode;
+    struct pxe_pvt_inode *socket = PVT(&inode);
+    const char *redir = NULL;
+    uint64_t start, ttfb = 0;
+    uint32_t pos = 0, n;
+    double cpu, secs;
+    bool bad = false;
+
+    memset(&inode, 0, sizeof inode);
+    memset(&net_iostat, 0, sizeof net_iostat);
+    memset(&up, 0, sizeof up);
+    memset(&down, 0, sizeof down);
+    memset(&tsrv, 0, sizeof tsrv);
+    rx_head = rx_tail = 0;
+    segs_lost = 0;
+    rnd_state = seed;
+    now_ns = 0;
+
+    if (strcmp(proto, "tftp"))
+	make_response(!strcmp(proto, "gzip"));
+
+    cpu = cpu_time();
+    start = now_ns;
+
+    if (!strcmp(proto, "tftp")) {
+	url.type = URL_OLD_TFTP;
+	tftp_open(&url, 0, &inode, &redir);
+    } else {
+	url.type = URL_NORMAL;
+	http_open(&url, 0, &inode, &redir);
+    }
+    if (!inode.size) {
+	fprintf(stderr, "netbench: %s: open failed\n", proto);
+	return 1;
+    }
+
+    for (;;) {
+	n = socket->tftp_bytesleft;
+	if (!n) {
+	    if (socket->tftp_goteof)
+		break;
+	    pxe_fill_buffer(&inode);
+	    continue;
+	}
+	if (!pos)
+	    ttfb = now_ns - start;
+	if (pos + n > file_size ||
+	    memcmp(file_data + pos, socket->tftp_dataptr, n))
+	    bad = true;
+	pos += n;
+	socket->tftp_bytesleft = 0;
+    }
+
+    cpu = cpu_time() - cpu;
+    secs = (now_ns - start) / 1e9;
+
+    if (!strcmp(proto, "tftp"))
+	free(socket->tftp_pktbuf);
+    else if (gzip_response)
+	free(socket->tftp_pktbuf);
+
+    printf("  %-5s %10u bytes %9.3f s %8.2f MB/s  ttfb %8.2f ms  "
+	   "lost %u/%u", proto, pos, secs,
+	   secs > 0 ? pos / secs / 1e6 : 0.0, ttfb / 1e6,
+	   up.lost, down.lost);
+    if (!strcmp(proto, "tftp"))
+	printf("  blksize %u  timeouts %u  retransmits %u  resent %u",
+	       socket->tftp_blksize, net_iostat.tftp_timeouts,
+	       net_iostat.tftp_retransmits, tsrv.resent);
+    else
+	printf("  %u segments  stalled %u ms", nsegs,
+	       net_iostat.tcp_stall_ms);
+    printf("  cpu %.1f ms\n", cpu * 1000);
+
+    if (pos != file_size || bad) {
+	fprintf(stderr, "netbench: %s: read %u of %u bytes%s\n", proto,
+		pos, file_size, bad ? ", contents differ" : "");
+	return 1;
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: netbench [-l latency_ms] [-b mbit] [-m mtu] "
+	    "[-p loss_pct] [-w window_kb]\n"
+	    "\t\t[-s size_kb] [-S seed] [tftp|http|gzip ...]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *all[] = { "tftp", "http", "gzip" };
+    const char **protos = all;
+    uint32_t size = 4096 << 10;
+    int nprotos = 3;
+    int failed = 0;
+    int i, c;
+
+    while ((c = getopt(argc, argv, "l:b:m:p:w:s:S:")) != -1) {
+	switch (c) {
+	case 'l':
+	    latency_ns = strtod(optarg, NULL) * 1e6;
+	    break;
+	case 'b':
+	    mbit = strtoul(optarg, NULL, 0);
+	    break;
+	case 'm':
+	    mtu = strtoul(optarg, NULL, 0);
+	    break;
+	case 'p':
+	    loss_ppm = strtod(optarg, NULL) * 1e4;
+	    break;
+	case 'w':
+	    rwnd = strtoul(optarg, NULL, 0) << 10;
+	    break;
+	case 's':
+	    size = strtoul(optarg, NULL, 0) << 10;
+	    break;
+	case 'S':
+	    seed = strtoul(optarg, NULL, 0);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (!mbit || mtu < 576 || mtu > PKTBUF_SIZE || !seed ||
+	loss_ppm >= 1000000)
+	usage();
+    if (optind < argc) {
+	protos = (const char **)argv + optind;
+	nprotos = argc - optind;
+    }
+
+    mss = mtu - 40;
+    if (rwnd < mss)
+	rwnd = mss;
+
+    make_file(size);
+    http_bake_cookies();
+
+    printf("netbench: %.2f ms latency, %u Mbit/s, MTU %u, %.2f%% loss, "
+	   "seed %u\n", latency_ns / 1e6, mbit, mtu, loss_ppm / 1e4, seed);
+
+    for (i = 0; i < nprotos; i++) {
+	if (strcmp(protos[i], "tftp") && strcmp(protos[i], "http") &&
+	    strcmp(protos[i], "gzip"))
+	    usage();
+	failed += fetch(protos[i]);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,388 @@
+#define _GNU_SOURCE
+#include "unittest/unittest.h"
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+#include <klibc/compiler.h>
+#include <dprintf.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core_pxe.h, fs.h and timer.h that tftp.c
+ * depends on.
+ */
+#define PXE_H
+#define PKTBUF_SIZE	2048
+
+/* The TFTP opcodes are used as case labels, so these must be constant */
+#undef htons
+#undef ntohs
+#define htons(x)	((uint16_t)(((x) << 8) | ((uint16_t)(x) >> 8)))
+#define ntohs(x)	htons(x)
+
+struct inode;
+
+struct pxe_conn_ops {
+    void (*fill_buffer)(struct inode *inode);
+    void (*close)(struct inode *inode);
+    int (*readdir)(struct inode *inode, void *dirent);
+};
+
+struct pxe_pvt_inode {
+    uint16_t tftp_remoteport;
+    uint32_t tftp_filepos;
+    uint32_t tftp_blksize;
+    uint16_t tftp_bytesleft;
+    uint16_t tftp_lastpkt;
+    char    *tftp_dataptr;
+    uint8_t  tftp_goteof;
+    char    *tftp_pktbuf;
+    struct tftp_mcast *tftp_mc;
+    const struct pxe_conn_ops *ops;
+};
+
+struct inode {
+    uint32_t size;
+    struct pxe_pvt_inode pvt[1];
+};
+
+#define PVT(i) ((struct pxe_pvt_inode *)((i)->pvt))
+
+typedef uint32_t jiffies_t;
+static jiffies_t __jiffies;
+
+static inline jiffies_t jiffies(void)
+{
+    return __jiffies;
+}
+
+static void kaboom(void)
+{
+    fprintf(stderr, "kaboom: transfer timed out\n");
+    exit(1);
+}
+
+static void *zalloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+static size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    memcpy(dst, src, len < size ? len : size);
+    dst[len < size ? len : size] = '\0';
+    return len;
+}
+
+char *url_unescape(char *buffer, char terminator)
+{
+    return buffer;
+}
+
+struct net_iostat net_iostat;
+
+#include "../tftp.c"
+
+/*
+ * A multicast TFTP server stand-in.
+ *
+ * Another client is already the master when we join, so the blocks
+ * from LATE_START on arrive over the group first.  Once that transfer
+ * ends the server makes us the master client, and we must only ask for
+ * the blocks we haven't got.
+ */
+#define SERVER_IP	htonl(0x0a000001)
+#define SERVER_PORT	2000
+#define GROUP_IP	htonl(0xef010203)
+#define GROUP_PORT	1758
+#define BLKSIZE		512
+#define NBLOCKS		41
+#define FILE_SIZE	((NBLOCKS - 1) * BLKSIZE + 100)
+#define LATE_START	20
+#define LOST_GROUP	30	/* Lost before we become master */
+#define LOST_MASTER	5	/* Lost once, after we became master */
+
+struct packet {
+    uint16_t len;
+    char data[BLKSIZE + 4];
+};
+
+struct queue {
+    struct packet pkts[2 * NBLOCKS];
+    int head, tail;
+};
+
+static char file_data[FILE_SIZE];
+static struct queue unicast_q, group_q;
+static struct pxe_pvt_inode *group_sock;
+static bool group_left, master, lost_master_once;
+static bool offer_mcast;
+static int sent_count[NBLOCKS + 1];
+static uint16_t last_ack;
+
+static void queue_put(struct queue *q, const void *data, uint16_t len)
+{
+    struct packet *pkt = &q->pkts[q->tail++ % (2 * NBLOCKS)];
+
+    memcpy(pkt->data, data, len);
+    pkt->len = len;
+}
+
+static void queue_oack(const char *opts, size_t len)
+{
+    char buf[128];
+
+    *(uint16_t *)buf = TFTP_OACK;
+    memcpy(buf + 2, opts, len);
+    queue_put(&unicast_q, buf, 2 + len);
+}
+
+static void send_block(uint16_t blk)
+{
+    char buf[BLKSIZE + 4];
+    uint16_t len;
+
+    len = (blk < NBLOCKS) ? BLKSIZE : FILE_SIZE - (NBLOCKS - 1) * BLKSIZE;
+    *(uint16_t *)buf = TFTP_DATA;
+    *(uint16_t *)(buf + 2) = htons(blk);
+    memcpy(buf + 4, file_data + (blk - 1) * BLKSIZE, len);
+
+    if (master)
+	sent_count[blk]++;
+
+    if (blk == LOST_GROUP && !master)
+	return;
+    if (blk == LOST_MASTER && master && !lost_master_once) {
+	lost_master_once = true;
+	return;
+    }
+
+    queue_put(&group_q, buf, len + 4);
+}
+
+int core_udp_open(struct pxe_pvt_inode *socket)
+{
+    return 0;
+}
+
+int core_udp_open_group(struct pxe_pvt_inode *socket,
+			uint32_t group, uint16_t port)
+{
+    uint16_t blk;
+
+    syslinux_assert_str(group == GROUP_IP && port == GROUP_PORT,
+			"Joined the wrong group");
+    group_sock = socket;
+
+    /* The transfer to the other master client is already under way */
+    for (blk = LATE_START; blk <= NBLOCKS; blk++)
+	send_block(blk);
+
+    /* ... and now it's our turn */
+    queue_oack("multicast\0,,1", 14);
+    return 0;
+}
+
+void core_udp_close(struct pxe_pvt_inode *socket)
+{
+    if (socket == group_sock)
+	group_left = true;
+}
+
+void core_udp_connect(struct pxe_pvt_inode *socket,
+		      uint32_t ip, uint16_t port)
+{
+}
+
+void core_udp_disconnect(struct pxe_pvt_inode *socket)
+{
+}
+
+int core_udp_recv(struct pxe_pvt_inode *socket, void *buf, uint16_t *buf_len,
+		  uint32_t *src_ip, uint16_t *src_port)
+{
+    struct queue *q = (socket == group_sock) ? &group_q : &unicast_q;
+    struct packet *pkt;
+
+    if (q->head == q->tail) {
+	__jiffies++;		/* Nothing there; time passes */
+	return -1;
+    }
+
+    pkt = &q->pkts[q->head++ % (2 * NBLOCKS)];
+    memcpy(buf, pkt->data, pkt->len < *buf_len ? pkt->len : *buf_len);
+    *buf_len = pkt->len;
+    *src_ip = SERVER_IP;
+    *src_port = (socket == group_sock) ? GROUP_PORT : SERVER_PORT;
+    return 0;
+}
+
+void core_udp_send(struct pxe_pvt_inode *socket,
+		   const void *data, size_t len)
+{
+    const uint16_t *pkt = data;
+
+    if (pkt[0] != TFTP_ACK)
+	return;
+
+    last_ack = ntohs(pkt[1]);
+    master = true;		/* Only the master client ACKs blocks */
+    if (last_ack < NBLOCKS)
+	send_block(last_ack + 1);
+}
+
+void core_udp_sendto(struct pxe_pvt_inode *socket, const void *data,
+		     size_t len, uint32_t ip, uint16_t port)
+{
+    static const char opts[] =
+	"tsize\0" "20580\0" "blksize\0" "512\0" "multicast\0" "239.1.2.3,1758,0";
+    static const char opts_plain[] =
+	"tsize\0" "20580\0" "blksize\0" "512";
+    const char *p = data;
+    bool asked = false;
+
+    /* Opcode, file name, mode, then the options */
+    for (p += 2; p < (const char *)data + len; p += strlen(p) + 1)
+	if (!strcmp(p, "multicast"))
+	    asked = true;
+
+    syslinux_assert_str(asked, "No multicast option in the request");
+    if (offer_mcast)
+	queue_oack(opts, sizeof opts);
+    else
+	queue_oack(opts_plain, sizeof opts_plain);
+}
+
+static void reset(void)
+{
+    memset(&unicast_q, 0, sizeof unicast_q);
+    memset(&group_q, 0, sizeof group_q);
+    memset(sent_count, 0, sizeof sent_count);
+    group_sock = NULL;
+    group_left = master = lost_master_once = false;
+    last_ack = 0;
+}
+
+static void read_file(struct inode *inode, char *buf)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    uint32_t pos = 0;
+
+    while (!socket->tftp_goteof) {
+	socket->ops->fill_buffer(inode);
+	memcpy(buf + pos, socket->tftp_dataptr, socket->tftp_bytesleft);
+	pos += socket->tftp_bytesleft;
+	socket->tftp_bytesleft = 0;
+    }
+
+    syslinux_assert_str(pos == FILE_SIZE, "Read %u bytes", pos);
+}
+
+/*
+ * Join a transfer that is already in progress and finish it as the
+ * master client.
+ */
+static void test_late_join(void)
+{
+    static char url_path[] = "pxelinux.cfg/default";
+    struct url_info url = {
+	.ip = SERVER_IP,
+	.path = url_path,
+	.type = URL_OLD_TFTP,
+    };
+    struct inode inode;
+    static char buf[FILE_SIZE];
+    int blk;
+
+    reset();
+    offer_mcast = true;
+    memset(&inode, 0, sizeof inode);
+    tftp_open(&url, 0, &inode, NULL);
+
+    syslinux_assert_str(inode.size == FILE_SIZE, "Wrong file size");
+    syslinux_assert_str(PVT(&inode)->ops == &tftp_mcast_conn_ops,
+			"Multicast was not used");
+
+    read_file(&inode, buf);
+
+    syslinux_assert_str(!memcmp(buf, file_data, FILE_SIZE),
+			"File contents differ");
+    syslinux_assert_str(last_ack == NBLOCKS, "Final ACK was %u", last_ack);
+    syslinux_assert_str(group_left, "Did not leave the group");
+
+    for (blk = 1; blk <= NBLOCKS; blk++) {
+	int want = (blk < LATE_START || blk == LOST_GROUP) +
+	    (blk == LOST_MASTER);
+
+	syslinux_assert_str(sent_count[blk] == want,
+			    "Block %d sent %d times", blk, sent_count[blk]);
+    }
+
+    free(PVT(&inode)->tftp_pktbuf);
+}
+
+/*
+ * A server that ignores the multicast option gives a plain transfer.
+ */
+static void test_no_mcast(void)
+{
+    static char url_path[] = "pxelinux.cfg/default";
+    struct url_info url = {
+	.ip = SERVER_IP,
+	.path = url_path,
+	.type = URL_OLD_TFTP,
+    };
+    struct inode inode;
+
+    reset();
+    offer_mcast = false;
+    memset(&inode, 0, sizeof inode);
+    tftp_open(&url, 0, &inode, NULL);
+
+    syslinux_assert_str(PVT(&inode)->ops == &tftp_conn_ops,
+			"Expected a unicast transfer");
+    syslinux_assert_str(!PVT(&inode)->tftp_mc, "Multicast state left over");
+
+    free(PVT(&inode)->tftp_pktbuf);
+}
+
+static void test_parse(void)
+{
+    uint32_t ip;
+    uint16_t port;
+    bool m;
+
+    syslinux_assert_str(!tftp_parse_mcast("239.1.2.3,1758,1", &ip, &port, &m)
+			&& ip == GROUP_IP && port == 1758 && m,
+			"Full option");
+    syslinux_assert_str(!tftp_parse_mcast(",,0", &ip, &port, &m)
+			&& !ip && !port && !m, "Empty address and port");
+    syslinux_assert_str(tftp_parse_mcast("239.1.2,1758,1", &ip, &port, &m),
+			"Short address accepted");
+    syslinux_assert_str(tftp_parse_mcast("239.1.2.300,1758,1",
+					 &ip, &port, &m),
+			"Bad address accepted");
+    syslinux_assert_str(tftp_parse_mcast("239.1.2.3,1758,2", &ip, &port, &m),
+			"Bad master flag accepted");
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < FILE_SIZE; i++)
+	file_data[i] = i * 7 + (i >> 9);
+
+    TftpMulticast = 1;
+
+    test_parse();
+    test_no_mcast();
+    test_late_join();
+
+    return 0;
+}
@@ -14,15 +14,52 @@ struct tftp_packet {
     char data[];
 };
 
+/*
+ * Request multicast (RFC 2090) transfers; set by the TFTPMULTICAST
+ * configuration directive.
+ */
+__export uint8_t TftpMulticast = 0;
+
+/*
+ * Multicast receive state.  The whole file is collected in
+ * socket->tftp_pktbuf, in whatever order the blocks arrive, and handed
+ * out from there in order.
+ */
+struct tftp_mcast {
+    struct pxe_pvt_inode sock;	/* Socket joined to the multicast group */
+    uint32_t server_ip;		/* Only accept data from here */
+    uint16_t nblocks;		/* Blocks in the file, last one short */
+    uint16_t contig;		/* Blocks 1..contig have all been received */
+    uint16_t next;		/* Next block to hand out */
+    bool master;		/* We are the master client */
+    bool done;			/* The final ACK has been sent */
+    char *pkt;			/* Receive buffer */
+    uint32_t bitmap[];		/* Blocks received */
+};
+
 static void tftp_error(struct inode *file, uint16_t errnum,
 		       const char *errstr);
 
+static void tftp_mcast_free(struct pxe_pvt_inode *socket)
+{
+    struct tftp_mcast *mc = socket->tftp_mc;
+
+    if (!mc)
+	return;
+
+    core_udp_close(&mc->sock);
+    free(mc->pkt);
+    free(mc);
+    socket->tftp_mc = NULL;
+}
+
 static void tftp_close_file(struct inode *inode)
 {
     struct pxe_pvt_inode *socket = PVT(inode);
     if (!socket->tftp_goteof) {
 	tftp_error(inode, 0, "No error, file close");
     }
+    tftp_mcast_free(socket);
     core_udp_close(socket);
 }
 
@@ -109,6 +146,7 @@ static void tftp_get_packet(struct inode *inode)
 	    jiffies_t now = jiffies();
 
 	    if (now-oldtime >= timeout) {
+		net_iostat.tftp_timeouts++;
 		oldtime = now;
 		timeout = *timeout_ptr++;
 		if (!timeout)
@@ -142,6 +180,7 @@ static void tftp_get_packet(struct inode *inode)
          * This is presumably because the ACK got lost,
          * so the server just resent the previous packet.
          */
+	net_iostat.tftp_retransmits++;
 #if 0
 	printf("Wrong packet, wanted %04x, got %04x\n", \
                htons(last_pkt), htons(*(uint16_t *)(data+2)));
@@ -171,6 +210,259 @@ const struct pxe_conn_ops tftp_conn_ops = {
     .close		= tftp_close_file,
 };
 
+/*
+ * Parse the value of a multicast option, "addr,port,mc".  The address
+ * and port are only sent with the first OACK and may be empty.
+ */
+static int tftp_parse_mcast(const char *p, uint32_t *ip, uint16_t *port,
+			    bool *master)
+{
+    uint32_t addr = 0, n;
+    int i;
+
+    *ip = 0;
+    *port = 0;
+
+    if (*p != ',') {
+	for (i = 0; i < 4; i++) {
+	    if (*p < '0' || *p > '9')
+		return -1;
+	    for (n = 0; *p >= '0' && *p <= '9'; p++)
+		n = n * 10 + (*p - '0');
+	    if (n > 255)
+		return -1;
+	    addr = (addr << 8) | n;
+	    if (i < 3 && *p++ != '.')
+		return -1;
+	}
+	*ip = htonl(addr);
+    }
+    if (*p++ != ',')
+	return -1;
+
+    for (n = 0; *p >= '0' && *p <= '9'; p++)
+	n = n * 10 + (*p - '0');
+    if (n > 65535)
+	return -1;
+    *port = n;
+
+    if (*p++ != ',' || (*p != '0' && *p != '1'))
+	return -1;
+    *master = (*p == '1');
+
+    return 0;
+}
+
+static inline bool tftp_mcast_have(struct tftp_mcast *mc, uint16_t blk)
+{
+    return mc->bitmap[blk >> 5] & (1U << (blk & 31));
+}
+
+/*
+ * Acknowledge the last block before the first one we are missing.  As
+ * master client this makes the server continue with that block, so
+ * only what we don't have yet gets sent.
+ */
+static void tftp_mcast_ack(struct inode *inode)
+{
+    struct tftp_mcast *mc = PVT(inode)->tftp_mc;
+
+    ack_packet(inode, mc->contig);
+    if (mc->contig == mc->nblocks)
+	mc->done = true;
+}
+
+static void tftp_mcast_data(struct inode *inode, uint16_t len)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct tftp_mcast *mc = socket->tftp_mc;
+    struct tftp_packet *pkt = (struct tftp_packet *)mc->pkt;
+    uint16_t blk = ntohs(pkt->serial);
+    uint32_t blksize = socket->tftp_blksize;
+    uint32_t want;
+
+    if (blk == 0 || blk > mc->nblocks || tftp_mcast_have(mc, blk))
+	goto ack;
+
+    want = (blk < mc->nblocks) ? blksize :
+	inode->size - (uint32_t)(mc->nblocks - 1) * blksize;
+    if (len - 4 != want)
+	return;			/* Not a block of this file */
+
+    memcpy(socket->tftp_pktbuf + (uint32_t)(blk - 1) * blksize,
+	   pkt->data, want);
+    mc->bitmap[blk >> 5] |= 1U << (blk & 31);
+
+    while (mc->contig < mc->nblocks && tftp_mcast_have(mc, mc->contig + 1))
+	mc->contig++;
+
+ack:
+    /* The master client drives the transfer; tell the server when done */
+    if (mc->master || (mc->contig == mc->nblocks && !mc->done))
+	tftp_mcast_ack(inode);
+}
+
+/*
+ * An OACK on the unicast socket during the transfer: the server is
+ * making us the master client, or taking that away.
+ */
+static void tftp_mcast_oack(struct inode *inode, uint16_t len)
+{
+    struct tftp_mcast *mc = PVT(inode)->tftp_mc;
+    char *p = mc->pkt + 2, *end = mc->pkt + len;
+    const char *opt, *val;
+    uint32_t ip;
+    uint16_t port;
+    bool master;
+
+    while (p < end) {
+	opt = p;
+	while (p < end && *p)
+	    p++;
+	if (++p >= end)
+	    return;		/* Unterminated, or no value */
+	val = p;
+	while (p < end && *p)
+	    p++;
+	if (p++ >= end)
+	    return;		/* Unterminated value */
+
+	if (strcasecmp(opt, "multicast") ||
+	    tftp_parse_mcast(val, &ip, &port, &master))
+	    continue;
+
+	dprintf("tftp: %s master client\n", master ? "now" : "no longer");
+	mc->master = master;
+	if (master)
+	    tftp_mcast_ack(inode);
+    }
+}
+
+/*
+ * Wait until the next block in file order has been received, then
+ * hand it out.
+ */
+static void tftp_mcast_get_packet(struct inode *inode)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct tftp_mcast *mc = socket->tftp_mc;
+    const uint8_t *timeout_ptr = TimeoutTable;
+    jiffies_t timeout = *timeout_ptr++;
+    jiffies_t oldtime = jiffies();
+    struct tftp_packet *pkt = (struct tftp_packet *)mc->pkt;
+    uint16_t buf_len, src_port;
+    uint32_t src_ip, blksize = socket->tftp_blksize;
+    uint16_t blk;
+
+    while (!tftp_mcast_have(mc, mc->next)) {
+	/* Blocks come in on the group, OACKs on our own socket */
+	buf_len = blksize + 4;
+	if (!core_udp_recv(&mc->sock, mc->pkt, &buf_len,
+			   &src_ip, &src_port)) {
+	    if (src_ip == mc->server_ip && buf_len >= 4 &&
+		pkt->opcode == TFTP_DATA) {
+		tftp_mcast_data(inode, buf_len);
+		oldtime = jiffies();
+	    }
+	    continue;
+	}
+
+	buf_len = blksize + 4;
+	if (!core_udp_recv(socket, mc->pkt, &buf_len, &src_ip, &src_port)) {
+	    if (buf_len >= 4 && pkt->opcode == TFTP_DATA) {
+		tftp_mcast_data(inode, buf_len);
+		oldtime = jiffies();
+	    } else if (buf_len >= 2 && pkt->opcode == TFTP_OACK) {
+		tftp_mcast_oack(inode, buf_len);
+		oldtime = jiffies();
+	    }
+	    continue;
+	}
+
+	if (jiffies() - oldtime >= timeout) {
+	    net_iostat.tftp_timeouts++;
+	    oldtime = jiffies();
+	    timeout = *timeout_ptr++;
+	    if (!timeout)
+		kaboom();
+	    /*
+	     * Remind the server of where we are; as master this also
+	     * recovers from a lost block or ACK.
+	     */
+	    tftp_mcast_ack(inode);
+	}
+    }
+
+    blk = mc->next++;
+    socket->tftp_dataptr = socket->tftp_pktbuf + (uint32_t)(blk - 1) * blksize;
+    socket->tftp_bytesleft = (blk < mc->nblocks) ? blksize :
+	inode->size - (uint32_t)(blk - 1) * blksize;
+    socket->tftp_filepos += socket->tftp_bytesleft;
+    socket->tftp_lastpkt = blk;
+
+    if (blk == mc->nblocks) {
+	socket->tftp_goteof = 1;
+	tftp_close_file(inode);
+    }
+}
+
+const struct pxe_conn_ops tftp_mcast_conn_ops = {
+    .fill_buffer	= tftp_mcast_get_packet,
+    .close		= tftp_close_file,
+};
+
+/*
+ * Set up a multicast transfer once the server has accepted the
+ * multicast option.  The file size must be known, and the block
+ * numbers must not wrap.
+ */
+static int tftp_mcast_start(struct inode *inode, uint32_t server_ip,
+			    uint32_t group, uint16_t port, bool master)
+{
+    struct pxe_pvt_inode *socket = PVT(inode);
+    struct tftp_mcast *mc;
+    uint32_t nblocks;
+
+    if (inode->size == (uint32_t)-1 || !group || !port)
+	return -1;
+
+    nblocks = inode->size / socket->tftp_blksize + 1;
+    if (nblocks > 65535)
+	return -1;
+
+    mc = zalloc(sizeof *mc + (nblocks / 32 + 1) * sizeof(uint32_t));
+    if (!mc)
+	return -1;
+    socket->tftp_mc = mc;
+
+    mc->server_ip = server_ip;
+    mc->nblocks = nblocks;
+    mc->next = 1;
+    mc->master = master;
+    mc->pkt = malloc(socket->tftp_blksize + 4);
+    socket->tftp_pktbuf = malloc(inode->size + 1);
+    if (!mc->pkt || !socket->tftp_pktbuf)
+	goto err;
+
+    if (core_udp_open_group(&mc->sock, group, port))
+	goto err;
+
+    dprintf("tftp: multicast %08x:%u, %u blocks, %smaster\n",
+	    ntohl(group), port, nblocks, master ? "" : "not ");
+
+    socket->ops = &tftp_mcast_conn_ops;
+    if (master)
+	ack_packet(inode, 0);	/* Start the transfer */
+
+    return 0;
+
+err:
+    free(socket->tftp_pktbuf);
+    socket->tftp_pktbuf = NULL;
+    tftp_mcast_free(socket);
+    return -1;
+}
+
 /**
  * Open a TFTP connection to the server
  *
@@ -192,7 +484,8 @@ void tftp_open(struct url_info *url, int flags, struct inode *inode,
     char *options;
     char *data;
     static const char rrq_tail[] = "octet\0""tsize\0""0\0""blksize\0""1408";
-    char rrq_packet_buf[2+2*FILENAME_MAX+sizeof rrq_tail];
+    static const char mcast_tail[] = "multicast\0";
+    char rrq_packet_buf[2+2*FILENAME_MAX+sizeof rrq_tail+sizeof mcast_tail];
     char reply_packet_buf[PKTBUF_SIZE];
     int err;
     int buffersize;
@@ -205,6 +498,10 @@ void tftp_open(struct url_info *url, int flags, struct inode *inode,
     uint64_t opdata;
     uint16_t src_port;
     uint32_t src_ip;
+    bool mcast = TftpMulticast;
+    bool mcast_ok, mcast_master;
+    uint32_t mcast_ip;
+    uint16_t mcast_port;
 
     (void)redir;		/* TFTP does not redirect */
     (void)flags;
@@ -220,6 +517,8 @@ void tftp_open(struct url_info *url, int flags, struct inode *inode,
     if (!url->port)
 	url->port = TFTP_PORT;
 
+again:
+    mcast_ok = false;
     socket->ops = &tftp_conn_ops;
     if (core_udp_open(socket))
 	return;
@@ -234,6 +533,12 @@ void tftp_open(struct url_info *url, int flags, struct inode *inode,
     memcpy(buf, rrq_tail, sizeof rrq_tail);
     buf += sizeof rrq_tail;
 
+    if (mcast) {
+	/* The multicast option has an empty value */
+	memcpy(buf, mcast_tail, sizeof mcast_tail);
+	buf += sizeof mcast_tail;
+    }
+
     rrq_len = buf - rrq_packet_buf;
 
     timeout_ptr = TimeoutTable;   /* Reset timeout */
@@ -373,6 +678,25 @@ wait_pkt:
 	    if (!buffersize)
 		break;		/* No option data */
 
+	    if (mcast && !strcmp(opt, "multicast")) {
+		const char *val = p;
+
+		while (buffersize && *p) {
+		    p++;
+		    buffersize--;
+		}
+		if (!buffersize)
+		    goto err_reply;	/* Unterminated value */
+		p++;
+		buffersize--;
+
+		if (tftp_parse_mcast(val, &mcast_ip, &mcast_port,
+				     &mcast_master))
+		    goto err_reply;
+		mcast_ok = true;
+		continue;
+	    }
+
 	    opdata = 0;
 
             /* do convert a number-string to decimal number, just like atoi */
@@ -400,6 +724,18 @@ wait_pkt:
 	if (socket->tftp_blksize < 64 || socket->tftp_blksize > PKTBUF_SIZE)
 	    goto err_reply;
 
+	if (mcast_ok) {
+	    if (!tftp_mcast_start(inode, src_ip, mcast_ip, mcast_port,
+				  mcast_master))
+		goto done;
+
+	    /* Can't do it after all; ask again, without multicast */
+	    tftp_error(inode, TFTP_EOPTNEG, "Multicast not possible");
+	    core_udp_close(socket);
+	    mcast = false;
+	    goto again;
+	}
+
 	/* Parsing successful, allocate buffer */
 	socket->tftp_pktbuf = malloc(socket->tftp_blksize + 4);
 	if (!socket->tftp_pktbuf)
@@ -0,0 +1,411 @@
+/*
+ * Filesystem driver and block cache benchmark.
+ *
+ * The drivers in core/fs and the block cache in cache.c, built for the
+ * host, are mounted on a struct disk that reads an image file with
+ * pread().  A list of paths is then replayed: each is looked up with
+ * searchdir() and, unless it is only to be looked up, read to the end
+ * the way a loader would.  The figures are the disk calls and sectors
+ * it took, the block cache hit rate, and the wall time.
+ *
+ * The list has one path per line; a line "lookup <path>" only opens
+ * and closes the file, a line "preload <path>" is handed to
+ * fs_preload() once, after the mount, and lines starting with '#' are
+ * skipped.
+ *
+ * Usage: fsbench [-c cache_kb] [-r read_kb] [-s sector_size] [-p passes]
+ *		  fstype image [list]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <core.h>
+#include <fs.h>
+#include <disk.h>
+#include <syslinux/firmware.h>
+#include "../iso9660/iso9660_fs.h"
+
+#define MAX_PATHS	4096
+
+extern const struct fs_ops ext2_fs_ops, vfat_fs_ops, xfs_fs_ops,
+    btrfs_fs_ops, ntfs_fs_ops, ufs_fs_ops, iso_fs_ops;
+
+static const struct {
+    const char *name;
+    const struct fs_ops *ops;
+} filesystems[] = {
+    { "ext2",	 &ext2_fs_ops },
+    { "ext3",	 &ext2_fs_ops },
+    { "ext4",	 &ext2_fs_ops },
+    { "vfat",	 &vfat_fs_ops },
+    { "xfs",	 &xfs_fs_ops },
+    { "btrfs",	 &btrfs_fs_ops },
+    { "ntfs",	 &ntfs_fs_ops },
+    { "ufs",	 &ufs_fs_ops },
+    { "iso9660", &iso_fs_ops },
+};
+
+/*
+ * What the core expects to find elsewhere.
+ */
+char CurrentDirName[FILENAME_MAX] = "/";
+char SubvolName[FILENAME_MAX];
+const struct input_dev __file_dev;
+struct file_info __file_info[1];
+struct iso_boot_info iso_boot_info;
+
+struct output_dev;
+
+int opendev(const struct input_dev *idev, const struct output_dev *odev,
+	    int flags)
+{
+    return -1;
+}
+
+void sysappend_set_fs_uuid(void)
+{
+}
+
+void syslinux_trace_begin(const char *name, const char *detail, uint32_t arg)
+{
+}
+
+void syslinux_trace_end(const char *name, uint32_t arg)
+{
+}
+
+void *zalloc(size_t size)
+{
+    return calloc(1, size);
+}
+
+__noreturn _kaboom(void)
+{
+    fprintf(stderr, "fsbench: kaboom\n");
+    abort();
+}
+
+/*
+ * The disk: an image file, read with pread().
+ */
+static int image_fd;
+static uint64_t disk_calls, disk_sectors;
+
+static int image_rdwr_sectors(struct disk *disk, void *buf, sector_t lba,
+			      size_t count, bool is_write)
+{
+    size_t len = count << disk->sector_shift;
+    off_t pos = (lba + disk->part_start) << disk->sector_shift;
+    ssize_t n;
+
+    if (is_write)
+	return 0;
+
+    disk_calls++;
+    disk_sectors += count;
+
+    n = pread(image_fd, buf, len, pos);
+    if (n < 0)
+	return 0;
+
+    /* Past the end of the image reads as zero */
+    memset((char *)buf + n, 0, len - n);
+    return count;
+}
+
+static struct disk image_disk = {
+    .disk_number	= 0x80,
+    .sector_size	= 512,
+    .sector_shift	= 9,
+    .maxtransfer	= 127,
+    .rdwr_sectors	= image_rdwr_sectors,
+};
+
+static struct disk *image_disk_init(void *private)
+{
+    return &image_disk;
+}
+
+static struct firmware host_fw = {
+    .disk_init = image_disk_init,
+};
+
+struct firmware *firmware = &host_fw;
+
+/*
+ * The block cache size is fixed in device_init(); this is where it
+ * can be changed, before the driver sets the cache up.
+ */
+static uint32_t cache_size;
+
+struct device *__real_device_init(void *args);
+struct device *__wrap_device_init(void *args)
+{
+    struct device *dev = __real_device_init(args);
+
+    if (cache_size) {
+	free(dev->cache_data);
+	dev->cache_size = cache_size;
+	dev->cache_data = malloc(cache_size);
+    }
+    return dev;
+}
+
+/*
+ * Tried after the driver: it only gets here if the driver didn't
+ * recognize the image.
+ */
+static const char *fstype;
+
+static int nofs_init(struct fs_info *fs)
+{
+    fprintf(stderr, "fsbench: no %s filesystem found\n", fstype);
+    exit(1);
+}
+
+static const struct fs_ops nofs_ops = {
+    .fs_name	= "no",
+    .fs_flags	= FS_NODEV,
+    .fs_init	= nofs_init,
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct counts {
+    uint64_t calls, sectors;
+    uint64_t hits, misses;
+    double time;
+};
+
+static void snapshot(struct counts *c)
+{
+    struct device *dev = this_fs->fs_dev;
+
+    c->calls = disk_calls;
+    c->sectors = disk_sectors;
+    c->hits = dev ? dev->cache_hits : 0;
+    c->misses = dev ? dev->cache_misses : 0;
+    c->time = now();
+}
+
+static void report(const char *what, const struct counts *a,
+		   const struct counts *b, uint64_t bytes)
+{
+    uint64_t lookups = (b->hits - a->hits) + (b->misses - a->misses);
+    double secs = b->time - a->time;
+
+    printf("  %-8s %8llu calls %10llu sectors  cache %5.1f%% of %8llu"
+	   "  %9.3f ms", what,
+	   (unsigned long long)(b->calls - a->calls),
+	   (unsigned long long)(b->sectors - a->sectors),
+	   lookups ? 100.0 * (b->hits - a->hits) / lookups : 0.0,
+	   (unsigned long long)lookups, secs * 1000);
+    if (bytes)
+	printf("  %7.1f MB/s", secs > 0 ? bytes / secs / 1e6 : 0.0);
+    printf("\n");
+}
+
+static char *paths[MAX_PATHS];
+static bool lookup_only[MAX_PATHS];
+static int npaths;
+static char *preloads[MAX_PATHS];
+static int npreloads;
+
+static void read_list(FILE *f)
+{
+    char line[FILENAME_MAX + 16];
+    char *p, *e;
+
+    while (npaths < MAX_PATHS && fgets(line, sizeof line, f)) {
+	for (p = line; *p == ' ' || *p == '\t'; p++)
+	    ;
+	e = p + strlen(p);
+	while (e > p && (e[-1] == '\n' || e[-1] == ' ' || e[-1] == '\t'))
+	    *--e = '\0';
+	if (!*p || *p == '#')
+	    continue;
+
+	if (!strncmp(p, "preload ", 8)) {
+	    preloads[npreloads++] = strdup(p + 8);
+	    continue;
+	}
+	if (!strncmp(p, "lookup ", 7)) {
+	    lookup_only[npaths] = true;
+	    p += 7;
+	}
+	paths[npaths++] = strdup(p);
+    }
+}
+
+/* One pass over the list; returns the bytes read */
+static uint64_t replay(char *buf, size_t read_size, int *failed)
+{
+    struct com32_filedata fd;
+    uint64_t bytes = 0, len;
+    uint16_t handle;
+    size_t n;
+    int i, rv;
+
+    for (i = 0; i < npaths; i++) {
+	rv = open_file(paths[i], O_RDONLY, &fd);
+	if (rv < 0) {
+	    fprintf(stderr, "fsbench: %s: not found\n", paths[i]);
+	    (*failed)++;
+	    continue;
+	}
+
+	handle = rv;
+	if (lookup_only[i]) {
+	    close_file(handle);
+	    continue;
+	}
+
+	len = 0;
+	while (handle) {
+	    n = pmapi_read_file(&handle, buf, read_size >> fd.blocklg2);
+	    if (!n)
+		break;
+	    len += n;
+	}
+	close_file(handle);
+	bytes += len;
+
+	if (len < fd.size) {
+	    fprintf(stderr, "fsbench: %s: short read\n", paths[i]);
+	    (*failed)++;
+	}
+    }
+
+    return bytes;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: fsbench [-c cache_kb] [-r read_kb] "
+	    "[-s sector_size] [-p passes] fstype image [list]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct fs_ops *ops[3] = { NULL, &nofs_ops, NULL };
+    struct counts start, mounted, a, b;
+    size_t read_size = 64 << 10;
+    unsigned int sector_size = 0;
+    int passes = 2;
+    int failed = 0;
+    uint64_t bytes;
+    char *buf;
+    FILE *list;
+    int i, c;
+
+    while ((c = getopt(argc, argv, "c:r:s:p:")) != -1) {
+	switch (c) {
+	case 'c':
+	    cache_size = strtoul(optarg, NULL, 0) << 10;
+	    break;
+	case 'r':
+	    read_size = strtoul(optarg, NULL, 0) << 10;
+	    break;
+	case 's':
+	    sector_size = strtoul(optarg, NULL, 0);
+	    break;
+	case 'p':
+	    passes = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (argc - optind < 2)
+	usage();
+    fstype = argv[optind];
+
+    for (i = 0; i < sizeof filesystems / sizeof filesystems[0]; i++) {
+	if (!strcmp(fstype, filesystems[i].name))
+	    ops[0] = filesystems[i].ops;
+    }
+    if (!ops[0]) {
+	fprintf(stderr, "fsbench: unknown filesystem %s\n", fstype);
+	usage();
+    }
+
+    /* A CD image has 2K sectors unless told otherwise */
+    if (!sector_size && ops[0] == &iso_fs_ops)
+	sector_size = 2048;
+    if (sector_size) {
+	if (sector_size & (sector_size - 1) || sector_size < 512)
+	    usage();
+	image_disk.sector_size = sector_size;
+	image_disk.sector_shift = __builtin_ctz(sector_size);
+    }
+    if (read_size < image_disk.sector_size)
+	read_size = image_disk.sector_size;
+
+    image_fd = open(argv[optind + 1], O_RDONLY);
+    if (image_fd < 0) {
+	perror(argv[optind + 1]);
+	return 1;
+    }
+
+    if (argc - optind > 2) {
+	list = fopen(argv[optind + 2], "r");
+	if (!list) {
+	    perror(argv[optind + 2]);
+	    return 1;
+	}
+    } else {
+	list = stdin;
+    }
+    read_list(list);
+
+    buf = malloc(read_size);
+
+    start.calls = start.sectors = start.hits = start.misses = 0;
+    start.time = now();
+    fs_init(ops, NULL);
+    snapshot(&mounted);
+
+    printf("%s: %s, %d paths, %u byte sectors, %u byte blocks, "
+	   "%u cache blocks\n", fstype, argv[optind + 1], npaths,
+	   image_disk.sector_size, this_fs->block_size,
+	   this_fs->fs_dev ? this_fs->fs_dev->cache_entries : 0);
+    report("mount", &start, &mounted, 0);
+
+    a = mounted;
+    if (npreloads) {
+	for (i = 0; i < npreloads; i++) {
+	    if (fs_preload(preloads[i])) {
+		fprintf(stderr, "fsbench: %s: preload failed\n", preloads[i]);
+		failed++;
+	    }
+	}
+	snapshot(&b);
+	report("preload", &a, &b, 0);
+	printf("  %u of %u cache blocks locked\n",
+	       this_fs->fs_dev ? this_fs->fs_dev->cache_pinned : 0,
+	       this_fs->fs_dev ? this_fs->fs_dev->cache_entries : 0);
+	a = b;
+    }
+
+    /* The first pass starts cold; any later ones find a warm cache */
+    for (i = 0; i < passes; i++) {
+	bytes = replay(buf, read_size, &failed);
+	snapshot(&b);
+	report(i ? "warm" : "cold", &a, &b, bytes);
+	a = b;
+    }
+
+    return failed ? 1 : 0;
+}
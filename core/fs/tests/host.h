@@ -0,0 +1,25 @@
+/*
+ * Included ahead of every file built for the host.
+ *
+ * The core declares a few functions under the same names as the C
+ * library does, with other types; the library's declarations are seen
+ * first, and the core's get names of their own.
+ */
+#ifndef FSBENCH_HOST_H
+#define FSBENCH_HOST_H
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef FILENAME_MAX		/* The core has its own */
+
+#define getchar		core_getchar
+#define realpath	core_realpath
+
+#define __noreturn	void __attribute__((noreturn))
+#define __constfunc	__attribute__((const))
+#define __bss16
+
+#endif /* FSBENCH_HOST_H */
@@ -0,0 +1,21 @@
+/*
+ * The C library's byteswap.h, with the unaligned little-endian read
+ * the core's version also has.
+ */
+#ifndef FSBENCH_BYTESWAP_H
+#define FSBENCH_BYTESWAP_H
+
+#include_next <byteswap.h>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint32_t get_le32(const uint32_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof v);
+    return le32toh(v);
+}
+
+#endif /* FSBENCH_BYTESWAP_H */
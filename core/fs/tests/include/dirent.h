@@ -0,0 +1,2 @@
+/* The core's struct dirent, not the C library's */
+#include <sys/dirent.h>
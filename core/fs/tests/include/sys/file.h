@@ -0,0 +1,25 @@
+/*
+ * The parts of com32/lib/sys/file.h that fs.c uses; open_config() is
+ * never called here.
+ */
+#ifndef _COM32_SYS_FILE_H
+#define _COM32_SYS_FILE_H
+
+#include <stddef.h>
+#include <syslinux/pmapi.h>
+
+struct file_info {
+    struct {
+	struct com32_filedata fd;
+	size_t offset;
+	size_t nbytes;
+    } i;
+};
+
+struct input_dev {
+    int dummy;
+};
+extern const struct input_dev __file_dev;
+extern struct file_info __file_info[];
+
+#endif /* _COM32_SYS_FILE_H */
@@ -14,11 +14,16 @@ struct cache {
     void *data;
 };
 
+/* dev->cache_pin: lock blocks as they are read, while preloading */
+#define CACHE_PIN_META	1	/* Blocks read through get_cache() */
+#define CACHE_PIN_ALL	2	/* ... and file data, see cache_get_sectors() */
+
 /* functions defined in cache.c */
 void cache_init(struct device *, int);
 const void *get_cache(struct device *, block_t);
 struct cache *_get_cache_block(struct device *, block_t);
 void cache_lock_block(struct cache *);
 size_t cache_read(struct fs_info *, void *, uint64_t, size_t);
+bool cache_get_sectors(struct fs_info *, void *, sector_t, uint32_t);
 
 #endif /* cache.h */
@@ -34,6 +34,7 @@
 
 #define BOOTP_OPTION_MAGIC  htonl(0x63825363)
 #define MAC_MAX 32
+#define PREFETCH_MAX	16	/* Most files fetched by one pxe_prefetch() */
 
 /*
  * structures
@@ -108,6 +109,10 @@ struct bootp_t {
 struct netconn;
 struct netbuf;
 struct efi_binding;
+struct efi_rx_ring;
+struct tftp_mcast;
+struct filecache_entry;
+struct filecache_fill;
 
 /*
  * Our inode private information -- this includes the packet buffer!
@@ -122,6 +127,7 @@ union net_private {
     struct net_private_lwip {
 	struct netconn *conn;      /* lwip network connection */
 	struct netbuf *buf;	   /* lwip cached buffer */
+	uint32_t group;		   /* Multicast group joined, or 0 */
     } lwip;
     struct net_private_tftp {
 	uint32_t remoteip;  	  /* Remote IP address (0 = disconnected) */
@@ -130,6 +136,7 @@ union net_private {
     struct net_private_efi {
 	struct efi_binding *binding; /* EFI binding for protocol */
 	uint16_t localport;          /* Local port number (0=not in use) */
+	struct efi_rx_ring *rx;      /* Receive tokens kept posted */
     } efi;
 };
 
@@ -145,6 +152,9 @@ struct pxe_pvt_inode {
     uint8_t  tftp_unused[3];      /* Currently unused */
     char    *tftp_pktbuf;         /* Packet buffer */
     struct inode *ctl;	          /* Control connection (for FTP) */
+    struct tftp_mcast *tftp_mc;   /* Multicast receive state (TFTP) */
+    struct filecache_entry *fc_entry; /* Cached copy served or revalidated */
+    struct filecache_fill *fc_fill;   /* Copy being taken as the file is read */
     const struct pxe_conn_ops *ops;
 };
 
@@ -220,15 +230,36 @@ void pxe_init_isr(void);
 void pxe_start_isr(void);
 int reset_pxe(void);
 
+/*
+ * Receive counters, kept by lpxelinux's UNDI driver and by the EFI
+ * network code.  pxe_rx_stats counts up from boot; pxe_rx_rate holds
+ * the counts for the last full second.
+ */
+struct pxe_rx_stats {
+    uint32_t packets;		/* Frames handed to the stack (EFI: receive
+				   tokens completed) */
+    uint32_t bytes;		/* Bytes in them */
+    uint32_t thunks;		/* PXENV_UNDI_ISR calls (EFI: Poll() calls) */
+    uint32_t drops;		/* Frames lost for lack of memory */
+    uint32_t irqs;		/* Receive interrupts */
+    uint32_t polls;		/* Polls which found a frame waiting */
+};
+extern struct pxe_rx_stats pxe_rx_stats, pxe_rx_rate;
+
 /* pxe.c */
 struct url_info;
 bool ip_ok(uint32_t);
-int pxe_getc(struct inode *inode);
 void free_socket(struct inode *inode);
 
+/* getc.c */
+void pxe_fill_buffer(struct inode *inode);
+int pxe_getc(struct inode *inode);
+
 /* undiif.c */
 int undiif_start(uint32_t ip, uint32_t netmask, uint32_t gw);
-void undiif_input(t_PXENV_UNDI_ISR *isr);
+struct pbuf;
+struct pbuf *undiif_receive(t_PXENV_UNDI_ISR *isr, uint8_t *prot);
+int8_t undiif_deliver(struct pbuf *p, uint8_t prot);
 
 /* dhcp_options.c */
 void parse_dhcp_options(const void *, int, uint8_t);
@@ -238,6 +269,21 @@ void parse_dhcp(const void *, size_t, int);
 void pxe_idle_init(void);
 void pxe_idle_cleanup(void);
 
+/* filecache.c */
+extern const struct pxe_conn_ops filecache_conn_ops;
+bool filecache_open(struct inode *inode, const char *key);
+void filecache_serve(struct inode *inode);
+bool filecache_validators(struct inode *inode,
+			  const char **etag, const char **lastmod);
+void filecache_fill_info(struct inode *inode, const char *etag,
+			 const char *lastmod, uint32_t length);
+void filecache_fill_start(struct inode *inode);
+void filecache_record(struct inode *inode);
+void filecache_fill_end(struct inode *inode);
+void filecache_release(struct inode *inode);
+void filecache_move(struct inode *to, struct inode *from);
+void filecache_prefetch(bool on);
+
 /* tftp.c */
 void tftp_open(struct url_info *url, int flags, struct inode *inode,
 	       const char **redir);
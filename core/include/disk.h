@@ -30,7 +30,13 @@ struct disk {
 
     sector_t part_start;   /* the start address of this partition(in sectors) */
 
+    /* Returns the number of sectors transferred */
     int (*rdwr_sectors)(struct disk *, void *, sector_t, size_t, bool);
+
+    /* Counters for pmapi_iostat(), kept by the firmware drivers */
+    uint32_t io_calls;		/* rdwr_sectors() calls */
+    uint32_t io_errors;		/* Failed firmware requests, retried or not */
+    uint64_t io_sectors;	/* Sectors transferred */
 };
 
 extern void read_sectors(char *, sector_t, int);
@@ -40,4 +46,8 @@ extern void getoneblk(struct disk *, char *, block_t, int);
 struct disk *bios_disk_init(void *);
 struct device *device_init(void *);
 
+/* diskio_bios.c */
+unsigned int bios_disk_set_maxtransfer(unsigned int);
+unsigned int bios_disk_probe_maxtransfer(void);
+
 #endif /* DISK_H */
@@ -139,6 +139,12 @@ struct device {
     uint16_t cache_block_size;
     uint16_t cache_entries;
     uint32_t cache_size;
+    uint32_t cache_hits, cache_misses;	/* get_cache() lookups */
+    uint32_t cache_evictions;		/* Misses which replaced a block */
+    uint8_t cache_pin;			/* Lock what get_cache() returns */
+    uint16_t cache_pinned;		/* Blocks locked that way */
+    uint64_t cache_read_next;		/* Where the last cache_read() ended */
+    uint32_t cache_read_run;		/* Bytes cache_read() read up to there */
 };
 
 /*
@@ -213,6 +219,13 @@ char *fs_uuid(void);
 
 extern uint16_t SectorShift;
 
+/* iostat.c */
+struct syslinux_iostat;
+void pmapi_iostat(struct syslinux_iostat *);
+
+/* preload.c */
+int fs_preload(const char *name);
+
 /* chdir.c */
 void pm_realpath(com32sys_t *regs);
 size_t realpath(char *dst, const char *src, size_t bufsize);
@@ -5,12 +5,27 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+/*
+ * Transfer counters, for pmapi_iostat(); the receive path itself is
+ * counted in pxe_rx_stats.
+ */
+struct net_iostat {
+    uint32_t tftp_timeouts;	/* Waits for a TFTP packet that ran out */
+    uint32_t tftp_retransmits;	/* TFTP blocks the server sent again */
+    uint32_t tcp_stall_ms;	/* Time spent waiting for TCP data */
+    uint64_t tcp_bytes;		/* TCP data received */
+};
+extern struct net_iostat net_iostat;
+
 void net_core_init(void);
 void net_parse_dhcp(void);
+int net_core_parallel(void (*func)(void *), void **args, int count);
 
 struct pxe_pvt_inode;
 
 int core_udp_open(struct pxe_pvt_inode *socket);
+int core_udp_open_group(struct pxe_pvt_inode *socket,
+			uint32_t group, uint16_t port);
 void core_udp_close(struct pxe_pvt_inode *socket);
 
 void core_udp_connect(struct pxe_pvt_inode *socket,
@@ -5,4 +5,7 @@
 
 size_t pmapi_read_file(uint16_t *, void *, size_t);
 
+struct syslinux_iostat;
+void pmapi_iostat(struct syslinux_iostat *);
+
 #endif /* PMAPI_H */
@@ -69,15 +69,12 @@ static void mpool_dump(enum heap heap)
 }
 #endif
 
-uint16_t *bios_free_mem;
-void mem_init(void)
+/* Empty every heap; memory is then added with __inject_free_block() */
+void __init_malloc_heads(void)
 {
 	struct free_arena_header *fp;
 	int i;
 
-	//dprintf("enter");
-
-	/* Initialize the head nodes */
 	fp = &__core_malloc_head[0];
 	for (i = 0 ; i < NHEAP ; i++) {
 	fp->a.next = fp->a.prev = fp->next_free = fp->prev_free = fp;
@@ -85,6 +82,17 @@ void mem_init(void)
 	fp->a.tag = MALLOC_HEAD;
 	fp++;
 	}
+}
+
+uint16_t *bios_free_mem;
+void mem_init(void)
+{
+	struct free_arena_header *fp;
+
+	//dprintf("enter");
+
+	/* Initialize the head nodes */
+	__init_malloc_heads();
 	
 	//dprintf("__lowmem_heap = 0x%p bios_free = 0x%p",
 	//	__lowmem_heap, *bios_free_mem);
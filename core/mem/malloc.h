@@ -4,6 +4,9 @@
  * Internals for the memory allocator
  */
 
+#ifndef _MALLOC_H
+#define _MALLOC_H
+
 #include <stdint.h>
 #include <stddef.h>
 #include "core.h"
@@ -96,3 +99,6 @@ struct free_arena_header {
 
 extern struct free_arena_header __core_malloc_head[NHEAP];
 void __inject_free_block(struct free_arena_header *ah);
+void __init_malloc_heads(void);
+
+#endif /* _MALLOC_H */
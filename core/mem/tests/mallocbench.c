@@ -0,0 +1,606 @@
+/*
+ * Allocator benchmark and fragmentation stress test.
+ *
+ * The core's malloc (bios_malloc/bios_free/bios_realloc), built for
+ * the host on a heap of its own, replays allocation traces: either the
+ * built-in ones, which follow what config parsing, module loading and
+ * initramfs assembly ask of the allocator, or traces read from files.
+ *
+ * Each trace is replayed twice.  The first pass walks the free list
+ * the way bios_malloc() does before each allocation, to find the
+ * longest walk, tracks the heap in use and its high-water mark, and
+ * checks every block's contents survive realloc and are intact when
+ * freed.  At the end every block must be free and the heap back in one
+ * piece.  The second pass only times the trace.
+ *
+ * "frag" is how much of the heap below the high-water mark was never
+ * in use at the same time: what first fit lost to holes.
+ *
+ * A trace file has one operation per line, on numbered blocks:
+ *
+ *	m <id> <size>		malloc
+ *	r <id> <size>		realloc
+ *	f <id>			free
+ *
+ * Lines starting with '#' are skipped.  malloclog2trace turns the output
+ * of a DEBUG_MALLOC core into this form.
+ *
+ * Usage: mallocbench [-h heap_mb] [-n scale] [trace...]
+ */
+#include "unittest/unittest.h"
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * Fake data objects.
+ *
+ * These are the parts of core.h and thread.h the allocator uses; the
+ * core's malloc, realloc and free get names of their own, so that the
+ * C library's are left alone.
+ */
+struct semaphore {
+    int count;
+};
+#define DECLARE_INIT_SEMAPHORE(name, cnt) struct semaphore name = { cnt }
+#define sem_down(s, t)	((void)(s), 0)
+#define sem_up(s)	((void)(s))
+
+struct com32_sys_args {
+    unsigned long cs_memsize;
+} __com32;
+typedef struct { int unused; } com32sys_t;
+char __lowmem_heap[32];
+char free_high_memory[32];
+
+#define malloc	core_malloc
+#define lmalloc	core_lmalloc
+#define realloc	core_realloc
+#define free	core_free
+#define zalloc	core_zalloc
+
+void *core_malloc(size_t);
+void *core_realloc(void *, size_t);
+void core_free(void *);
+
+#include "../init.c"
+#include "../malloc.c"
+#include "../free.c"
+
+/* Before the names go back: struct mem_ops has members called malloc */
+static struct mem_ops bench_mem_ops = {
+    .malloc	= bios_malloc,
+    .realloc	= bios_realloc,
+    .free	= bios_free,
+};
+
+static struct firmware bench_firmware = {
+    .mem	= &bench_mem_ops,
+};
+
+struct firmware *firmware = &bench_firmware;
+
+#undef malloc
+#undef lmalloc
+#undef realloc
+#undef free
+#undef zalloc
+
+int syslinux_scan_memory(scan_memory_callback_t callback, void *data)
+{
+    return 0;
+}
+
+/*
+ * The heap: one block of anonymous memory.
+ */
+static char *heap_base;
+static size_t heap_size = 256 << 20;
+
+static void heap_init(void)
+{
+    struct free_arena_header *fp = (struct free_arena_header *)heap_base;
+
+    __init_malloc_heads();
+
+    fp->a.attrs = ARENA_TYPE_USED | (HEAP_MAIN << ARENA_HEAP_POS);
+    ARENA_SIZE_SET(fp->a.attrs, heap_size);
+    __inject_free_block(fp);
+}
+
+/*
+ * Traces.
+ */
+enum op_type { OP_MALLOC = 'm', OP_REALLOC = 'r', OP_FREE = 'f' };
+
+struct op {
+    char type;
+    uint32_t id;
+    size_t size;
+};
+
+struct trace {
+    const char *name;
+    struct op *ops;
+    size_t nops, alloc;
+    uint32_t nids;		/* Highest id + 1 */
+};
+
+static void add_op(struct trace *t, char type, uint32_t id, size_t size)
+{
+    if (t->nops >= t->alloc) {
+	t->alloc = t->alloc ? t->alloc * 2 : 4096;
+	t->ops = realloc(t->ops, t->alloc * sizeof *t->ops);
+	if (!t->ops) {
+	    perror("mallocbench");
+	    exit(1);
+	}
+    }
+    t->ops[t->nops].type = type;
+    t->ops[t->nops].id = id;
+    t->ops[t->nops].size = size;
+    t->nops++;
+    if (id >= t->nids)
+	t->nids = id + 1;
+}
+
+/* Deterministic, so that runs can be compared */
+static uint32_t seed;
+
+static uint32_t rnd(uint32_t n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static uint32_t rnd_range(uint32_t lo, uint32_t hi)
+{
+    return lo + rnd(hi - lo + 1);
+}
+
+/*
+ * Config parsing: a line buffer and a few temporary tokens per line,
+ * and the strings and menu entries that are kept.  All of it goes when
+ * the next config is parsed.
+ */
+static void gen_config(struct trace *t, int scale)
+{
+    uint32_t id = 0, line_buf, kept_from;
+    int cfg, line, tok, ntok;
+
+    for (cfg = 0; cfg < 4 * scale; cfg++) {
+	kept_from = id;
+	line_buf = id++;
+	add_op(t, OP_MALLOC, line_buf, 256);
+
+	for (line = 0; line < 500; line++) {
+	    ntok = rnd_range(1, 4);
+	    for (tok = 0; tok < ntok; tok++)
+		add_op(t, OP_MALLOC, id + tok, rnd_range(4, 64));
+	    for (tok = 0; tok < ntok; tok++) {
+		/* About a third of the strings are kept */
+		if (rnd(3))
+		    add_op(t, OP_FREE, id + tok, 0);
+	    }
+	    id += ntok;
+
+	    /* A LABEL line makes a menu entry */
+	    if (!rnd(8))
+		add_op(t, OP_MALLOC, id++, rnd_range(160, 256));
+
+	    /* Long APPEND lines grow the line buffer */
+	    if (!rnd(50))
+		add_op(t, OP_REALLOC, line_buf, rnd_range(256, 4096));
+	}
+
+	/* Everything still live from this config */
+	for (; kept_from < id; kept_from++)
+	    add_op(t, OP_FREE, kept_from, 0);
+    }
+}
+
+/*
+ * Module loading: the file image, the module's own memory, its symbol
+ * and string tables, with the image freed once relocated.  Modules are
+ * unloaded newest first, some of them early.
+ */
+static void gen_modules(struct trace *t, int scale)
+{
+    uint32_t id = 0;
+    uint32_t stack[32][3];
+    int depth = 0;
+    int round, n;
+    size_t size;
+
+    for (round = 0; round < 40 * scale; round++) {
+	n = rnd_range(1, 6);
+	while (n-- && depth < 32) {
+	    size = rnd_range(8, 256) << 10;
+	    add_op(t, OP_MALLOC, id, size);			/* Image */
+	    add_op(t, OP_MALLOC, id + 1, size + rnd(4096));	/* Module */
+	    add_op(t, OP_MALLOC, id + 2, rnd_range(1, 16) << 10); /* Tables */
+	    add_op(t, OP_MALLOC, id + 3, rnd_range(32, 128));	/* Name */
+	    add_op(t, OP_FREE, id, 0);
+	    stack[depth][0] = id + 1;
+	    stack[depth][1] = id + 2;
+	    stack[depth][2] = id + 3;
+	    depth++;
+	    id += 4;
+	}
+
+	n = rnd_range(1, depth);
+	while (n-- && depth) {
+	    depth--;
+	    add_op(t, OP_FREE, stack[depth][2], 0);
+	    add_op(t, OP_FREE, stack[depth][0], 0);
+	    add_op(t, OP_FREE, stack[depth][1], 0);
+	}
+    }
+
+    while (depth--) {
+	add_op(t, OP_FREE, stack[depth][2], 0);
+	add_op(t, OP_FREE, stack[depth][0], 0);
+	add_op(t, OP_FREE, stack[depth][1], 0);
+    }
+}
+
+/*
+ * Initramfs assembly: each file is read into a buffer grown as it
+ * comes in, with a small list entry per file; the archive is freed
+ * when the boot fails and the next entry is tried.
+ */
+static void gen_initramfs(struct trace *t, int scale)
+{
+    uint32_t id = 0, first;
+    int boot, file, nfiles;
+    size_t size, len, step;
+
+    for (boot = 0; boot < 2 * scale; boot++) {
+	first = id;
+	nfiles = rnd_range(2, 6);
+	for (file = 0; file < nfiles; file++) {
+	    add_op(t, OP_MALLOC, id++, rnd_range(48, 96));	/* Entry */
+	    size = rnd_range(256, 12 << 10) << 10;
+	    step = 64 << 10;
+	    add_op(t, OP_MALLOC, id, step);
+	    for (len = step; len < size; len += step) {
+		/* The read-ahead doubles up to a megabyte */
+		if (step < (1 << 20))
+		    step *= 2;
+		add_op(t, OP_REALLOC, id, len + step);
+	    }
+	    id++;
+	}
+	for (; first < id; first++)
+	    add_op(t, OP_FREE, first, 0);
+    }
+}
+
+/*
+ * Stress: a random mix of sizes and lifetimes, to find the corners.
+ */
+static void gen_stress(struct trace *t, int scale)
+{
+    uint32_t nlive = 0, *live, i, id = 0;
+    int n;
+
+    live = malloc(4096 * sizeof *live);
+
+    for (n = 0; n < 20000 * scale; n++) {
+	if (nlive && (nlive >= 4096 || rnd(5) < 2)) {
+	    i = rnd(nlive);
+	    if (rnd(4)) {
+		add_op(t, OP_FREE, live[i], 0);
+		live[i] = live[--nlive];
+	    } else {
+		add_op(t, OP_REALLOC, live[i], rnd(5) ? rnd_range(1, 512)
+						     : rnd_range(1, 256 << 10));
+	    }
+	} else {
+	    add_op(t, OP_MALLOC, id, rnd(8) ? rnd_range(1, 512)
+					    : rnd_range(1, 256 << 10));
+	    live[nlive++] = id++;
+	}
+    }
+    while (nlive)
+	add_op(t, OP_FREE, live[--nlive], 0);
+
+    free(live);
+}
+
+static const struct {
+    const char *name;
+    void (*gen)(struct trace *, int);
+} workloads[] = {
+    { "config",    gen_config },
+    { "modules",   gen_modules },
+    { "initramfs", gen_initramfs },
+    { "stress",    gen_stress },
+};
+
+static int read_trace(struct trace *t, const char *file)
+{
+    char line[128];
+    unsigned long id, size;
+    char type;
+    FILE *f;
+    int n;
+
+    f = fopen(file, "r");
+    if (!f) {
+	perror(file);
+	return -1;
+    }
+
+    while (fgets(line, sizeof line, f)) {
+	if (line[0] == '#' || line[0] == '\n')
+	    continue;
+	size = 0;
+	n = sscanf(line, " %c %lu %lu", &type, &id, &size);
+	if (n < 2 || (type != OP_FREE && n < 3) ||
+	    (type != OP_MALLOC && type != OP_REALLOC && type != OP_FREE)) {
+	    fprintf(stderr, "%s: bad line: %s", file, line);
+	    fclose(f);
+	    return -1;
+	}
+	add_op(t, type, id, size);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/*
+ * Replay.
+ */
+struct result {
+    double secs;
+    size_t ops;
+    size_t walk_max;		/* Free blocks looked at for one malloc */
+    double walk_sum;
+    size_t mallocs;
+    size_t in_use, peak;	/* Bytes in used blocks, headers included */
+    size_t high_water;		/* Top of the highest block ever used */
+    size_t free_blocks_max;
+    size_t failed;		/* Allocations which returned NULL */
+    size_t corrupt;		/* Blocks whose contents changed */
+};
+
+static size_t block_size(void *p)
+{
+    struct arena_header *ah = (struct arena_header *)p - 1;
+
+    return ARENA_SIZE_GET(ah->attrs);
+}
+
+/* Walk the free list the way bios_malloc() will */
+static size_t free_list_walk(size_t size, size_t *nfree)
+{
+    struct free_arena_header *head = &__core_malloc_head[HEAP_MAIN];
+    struct free_arena_header *fp;
+    size_t walk = 0, n = 0;
+    bool found = false;
+
+    size = (size + 2 * sizeof(struct arena_header) - 1) & ARENA_SIZE_MASK;
+
+    for (fp = head->next_free; fp != head; fp = fp->next_free) {
+	n++;
+	if (!found) {
+	    walk++;
+	    if (ARENA_SIZE_GET(fp->a.attrs) >= size)
+		found = true;
+	}
+    }
+
+    *nfree = n;
+    return walk;
+}
+
+/* The first and last bytes of a block say which one it is */
+static void mark(void *p, uint32_t id, size_t size)
+{
+    if (size) {
+	((uint8_t *)p)[0] = id;
+	if (size > 1)
+	    ((uint8_t *)p)[size - 1] = id >> 8;
+    }
+}
+
+/* The block was size bytes, and is still at least keep bytes */
+static bool kept(const void *p, uint32_t id, size_t size, size_t keep)
+{
+    const uint8_t *b = p;
+
+    if (!size)
+	return true;
+    if (b[0] != (uint8_t)id)
+	return false;
+    return size == 1 || keep < size || b[size - 1] == (uint8_t)(id >> 8);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void replay(const struct trace *t, bool check, struct result *r)
+{
+    void **ptr = calloc(t->nids, sizeof *ptr);
+    size_t *len = calloc(t->nids, sizeof *len);
+    const struct op *op;
+    size_t i, walk, nfree, top;
+    double start;
+    void *p;
+
+    memset(r, 0, sizeof *r);
+    heap_init();
+
+    start = now();
+    for (i = 0, op = t->ops; i < t->nops; i++, op++) {
+	p = ptr[op->id];
+
+	if (check && op->type != OP_FREE) {
+	    walk = free_list_walk(op->size, &nfree);
+	    r->walk_sum += walk;
+	    r->mallocs++;
+	    if (walk > r->walk_max)
+		r->walk_max = walk;
+	    if (nfree > r->free_blocks_max)
+		r->free_blocks_max = nfree;
+	}
+	if (check && p) {
+	    if (!kept(p, op->id, len[op->id], len[op->id]))
+		r->corrupt++;
+	    r->in_use -= block_size(p);
+	}
+
+	switch (op->type) {
+	case OP_MALLOC:
+	    if (p)
+		core_free(p);	/* A trace cut short; start afresh */
+	    p = core_malloc(op->size);
+	    break;
+	case OP_REALLOC:
+	    p = core_realloc(p, op->size);
+	    if (check && p && !kept(p, op->id, len[op->id], op->size))
+		r->corrupt++;
+	    break;
+	case OP_FREE:
+	    core_free(p);
+	    p = NULL;
+	    break;
+	}
+
+	if (op->type != OP_FREE && !p)
+	    r->failed++;
+	ptr[op->id] = p;
+	len[op->id] = p ? op->size : 0;
+
+	if (check && p) {
+	    mark(p, op->id, op->size);
+	    r->in_use += block_size(p);
+	    if (r->in_use > r->peak)
+		r->peak = r->in_use;
+	    top = (char *)p + block_size(p) - heap_base;
+	    if (top > r->high_water)
+		r->high_water = top;
+	}
+    }
+    r->secs = now() - start;
+    r->ops = t->nops;
+
+    /* Whatever the trace left behind */
+    for (i = 0; i < t->nids; i++)
+	core_free(ptr[i]);
+
+    free(ptr);
+    free(len);
+}
+
+/* After everything is freed, the heap must be one free block again */
+static bool heap_intact(void)
+{
+    struct free_arena_header *head = &__core_malloc_head[HEAP_MAIN];
+    struct free_arena_header *fp = head->a.next;
+
+    return fp != head && fp->a.next == head &&
+	head->next_free == fp && fp->next_free == head &&
+	ARENA_TYPE_GET(fp->a.attrs) == ARENA_TYPE_FREE &&
+	ARENA_SIZE_GET(fp->a.attrs) == heap_size;
+}
+
+static int run(const struct trace *t)
+{
+    struct result timed, checked;
+    bool intact;
+
+    /* Checked first, so the timed pass doesn't pay for page faults */
+    replay(t, true, &checked);
+    replay(t, false, &timed);
+    intact = heap_intact();
+
+    printf("  %-10s %8zu ops %9.0f ops/s  walk max %5zu avg %6.1f"
+	   "  peak %7zu KB  high %7zu KB  frag %4.1f%%  free max %5zu\n",
+	   t->name, timed.ops, timed.secs > 0 ? timed.ops / timed.secs : 0.0,
+	   checked.walk_max,
+	   checked.mallocs ? checked.walk_sum / checked.mallocs : 0.0,
+	   checked.peak >> 10, checked.high_water >> 10,
+	   checked.high_water ?
+	   100.0 * (checked.high_water - checked.peak) / checked.high_water :
+	   0.0, checked.free_blocks_max);
+
+    syslinux_assert_str(!checked.failed, "%s: %zu allocations failed",
+			t->name, checked.failed);
+    syslinux_assert_str(!checked.corrupt, "%s: %zu blocks corrupted",
+			t->name, checked.corrupt);
+    syslinux_assert_str(intact, "%s: heap not whole after freeing all",
+			t->name);
+
+    return checked.failed || checked.corrupt || !intact;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mallocbench [-h heap_mb] [-n scale] [trace...]\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    struct trace t;
+    int scale = 1;
+    int failed = 0;
+    int i, c;
+
+    while ((c = getopt(argc, argv, "h:n:")) != -1) {
+	switch (c) {
+	case 'h':
+	    heap_size = strtoul(optarg, NULL, 0) << 20;
+	    break;
+	case 'n':
+	    scale = atoi(optarg);
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (heap_size < (1 << 20) || scale < 1)
+	usage();
+
+    heap_base = mmap(NULL, heap_size, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (heap_base == MAP_FAILED) {
+	perror("mallocbench");
+	return 1;
+    }
+
+    printf("heap %zu MB, %zu byte headers\n", heap_size >> 20,
+	   sizeof(struct arena_header));
+
+    if (optind < argc) {
+	for (i = optind; i < argc; i++) {
+	    memset(&t, 0, sizeof t);
+	    t.name = argv[i];
+	    if (read_trace(&t, argv[i]))
+		return 1;
+	    failed |= run(&t);
+	    free(t.ops);
+	}
+    } else {
+	for (i = 0; i < sizeof workloads / sizeof workloads[0]; i++) {
+	    memset(&t, 0, sizeof t);
+	    t.name = workloads[i].name;
+	    seed = 1;
+	    workloads[i].gen(&t, scale);
+	    failed |= run(&t);
+	    free(t.ops);
+	}
+    }
+
+    return failed;
+}
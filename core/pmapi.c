@@ -43,4 +43,6 @@ const struct com32_pmapi pm_api_vector =
 
     .sysappend_count	= SYSAPPEND_MAX,
     .sysappend_strings	= sysappend_strings,
+
+    .iostat	= pmapi_iostat,
 };
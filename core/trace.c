@@ -0,0 +1,104 @@
+/*
+ * trace.c
+ *
+ * The boot timeline; see <syslinux/trace.h>.  The ring is allocated
+ * from the main heap on the first mark, and the clocks are read then
+ * for the first time.  Without a TSC, or without the memory, nothing
+ * is recorded.
+ */
+
+#include <string.h>
+#include <core.h>
+#include <x86/cpu.h>
+#include <syslinux/trace.h>
+
+#define TRACE_RING	16384		/* Events; 1 MB */
+
+static struct syslinux_trace_event *ring;
+static uint32_t written;
+static uint64_t start_tsc;
+static uint32_t start_ms;
+static int8_t trace_state;		/* 0 = not set up, < 0 = off */
+
+static bool trace_setup(void)
+{
+    if (trace_state)
+	return trace_state > 0;
+
+    trace_state = -1;
+
+    /* CPUID level 1, EDX bit 4: the TSC */
+    if (!cpu_has_eflag(EFLAGS_ID) || !(cpuid_edx(1) & (1 << 4)))
+	return false;
+
+    ring = malloc(TRACE_RING * sizeof *ring);
+    if (!ring)
+	return false;
+
+    start_ms = ms_timer();
+    start_tsc = rdtsc();
+    trace_state = 1;
+    return true;
+}
+
+static void copy_name(char *dst, const char *src, size_t size)
+{
+    size_t i = 0;
+
+    if (src) {
+	while (i < size - 1 && src[i]) {
+	    dst[i] = src[i];
+	    i++;
+	}
+    }
+    dst[i] = '\0';
+}
+
+static void trace_record(uint8_t type, const char *name, const char *detail,
+			 uint32_t arg)
+{
+    struct syslinux_trace_event *ev;
+    uint64_t tsc = rdtsc();
+
+    if (!trace_setup())
+	return;
+
+    ev = &ring[written++ % TRACE_RING];
+    ev->tsc = tsc;
+    ev->arg = arg;
+    ev->type = type;
+    copy_name(ev->name, name, sizeof ev->name);
+    copy_name(ev->detail, detail, sizeof ev->detail);
+}
+
+__export void syslinux_trace_begin(const char *name, const char *detail,
+				   uint32_t arg)
+{
+    trace_record(TRACE_BEGIN, name, detail, arg);
+}
+
+__export void syslinux_trace_end(const char *name, uint32_t arg)
+{
+    trace_record(TRACE_END, name, NULL, arg);
+}
+
+__export void syslinux_trace_mark(const char *name, const char *detail,
+				  uint32_t arg)
+{
+    trace_record(TRACE_MARK, name, detail, arg);
+}
+
+__export int syslinux_trace_info(struct syslinux_trace_info *ti)
+{
+    if (trace_state <= 0)
+	return -1;
+
+    ti->ring = ring;
+    ti->size = TRACE_RING;
+    ti->written = written;
+    ti->start_tsc = start_tsc;
+    ti->start_ms = start_ms;
+    ti->now_ms = ms_timer();
+    ti->now_tsc = rdtsc();
+    return 0;
+}
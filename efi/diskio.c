@@ -6,8 +6,62 @@
 #include <ilog2.h>
 #include <disk.h>
 #include <dprintf.h>
+#include <minmax.h>
 #include "efi.h"
 
+/*
+ * EFI_BLOCK_IO2_PROTOCOL, which not every gnu-efi has
+ */
+static EFI_GUID BlockIo2Protocol = {
+	0xa77b2472, 0xe282, 0x4e9f,
+	{ 0xa2, 0x45, 0xc2, 0xc0, 0xe2, 0x7b, 0xbc, 0xc1 }
+};
+
+struct efi_block_io2_token {
+	EFI_EVENT Event;
+	EFI_STATUS TransactionStatus;
+};
+
+struct efi_block_io2 {
+	EFI_BLOCK_IO_MEDIA *Media;
+	EFI_STATUS (EFIAPI *Reset)(struct efi_block_io2 *, BOOLEAN);
+	EFI_STATUS (EFIAPI *ReadBlocksEx)(struct efi_block_io2 *, UINT32,
+					  EFI_LBA, struct efi_block_io2_token *,
+					  UINTN, VOID *);
+	EFI_STATUS (EFIAPI *WriteBlocksEx)(struct efi_block_io2 *, UINT32,
+					   EFI_LBA, struct efi_block_io2_token *,
+					   UINTN, VOID *);
+	EFI_STATUS (EFIAPI *FlushBlocksEx)(struct efi_block_io2 *,
+					   struct efi_block_io2_token *);
+};
+
+/*
+ * Read-ahead for sequential reads, e.g. a kernel or initrd being
+ * loaded: once a read follows on from the one before, the sectors
+ * after it are asked for EFI_RA_BUFS reads at a time through
+ * BlockIo2, so the device is kept busy while the last read is copied
+ * out.  Anything else, and every write, goes straight to BlockIo.
+ */
+#define EFI_RA_BUFS	4
+#define EFI_RA_BYTES	(256 << 10)	/* Per read */
+
+struct efi_ra_buf {
+	struct efi_block_io2_token token;
+	char *data;			/* Aligned for the device */
+	sector_t lba;
+	size_t count;			/* Sectors; 0 if idle */
+	volatile bool done;
+};
+
+struct efi_readahead {
+	struct efi_ra_buf buf[EFI_RA_BUFS];
+	unsigned int head;		/* Oldest read */
+	sector_t next;			/* Sector after the last one read */
+	sector_t issued;		/* Sector after the last one asked for */
+	size_t chunk;			/* Sectors per read */
+	char *raw;			/* What the buffers were carved from */
+};
+
 static inline EFI_STATUS read_blocks(EFI_BLOCK_IO *bio, uint32_t id, 
 				     sector_t lba, UINTN bytes, void *buf)
 {
@@ -20,25 +74,227 @@ static inline EFI_STATUS write_blocks(EFI_BLOCK_IO *bio, uint32_t id,
 	return uefi_call_wrapper(bio->WriteBlocks, 5, bio, id, lba, bytes, buf);
 }
 
+static EFIAPI void ra_done(EFI_EVENT ev, void *context)
+{
+	struct efi_ra_buf *b = context;
+
+	(void)ev;
+
+	b->done = true;
+}
+
+/* Ask for the next chunk after the ones already asked for */
+static void ra_issue(struct disk *disk, struct efi_readahead *ra,
+		     struct efi_ra_buf *b)
+{
+	struct efi_disk_private *priv = disk->private;
+	struct efi_block_io2 *bio2 = priv->bio2;
+	sector_t last = bio2->Media->LastBlock;
+	EFI_STATUS status;
+
+	b->count = 0;
+	if (ra->issued > last)
+		return;		/* Nothing left on the device */
+
+	b->lba = ra->issued;
+	b->count = min(ra->chunk, last + 1 - ra->issued);
+	b->done = false;
+	ra->issued += b->count;
+
+	status = uefi_call_wrapper(bio2->ReadBlocksEx, 6, bio2,
+				   disk->disk_number, b->lba, &b->token,
+				   b->count << disk->sector_shift, b->data);
+	if (status != EFI_SUCCESS) {
+		b->token.TransactionStatus = status;
+		b->done = true;
+	}
+}
+
+/* Wait for every read in flight, and forget what they read */
+static void ra_reset(struct efi_readahead *ra)
+{
+	int i;
+
+	for (i = 0; i < EFI_RA_BUFS; i++) {
+		while (ra->buf[i].count && !ra->buf[i].done)
+			;
+		ra->buf[i].count = 0;
+	}
+	ra->head = 0;
+}
+
+/* Wait for every read in flight, then close the events and free it all */
+static void ra_free(struct efi_readahead *ra)
+{
+	int i;
+
+	ra_reset(ra);
+	for (i = 0; i < EFI_RA_BUFS; i++) {
+		if (ra->buf[i].token.Event)
+			uefi_call_wrapper(BS->CloseEvent, 1,
+					  ra->buf[i].token.Event);
+	}
+	free(ra->raw);
+	free(ra);
+}
+
+/*
+ * Copy out of the read-ahead what it has of the sectors from lba on,
+ * starting it if need be.  Returns the number of sectors copied.
+ */
+static size_t ra_read(struct disk *disk, char *buf, sector_t lba,
+		      size_t count)
+{
+	struct efi_disk_private *priv = disk->private;
+	struct efi_readahead *ra = priv->ra;
+	struct efi_ra_buf *b = &ra->buf[ra->head];
+	size_t done = 0, n;
+	int i;
+
+	if (!b->count || lba < b->lba || lba >= b->lba + b->count) {
+		ra_reset(ra);
+		ra->issued = lba;
+		for (i = 0; i < EFI_RA_BUFS; i++)
+			ra_issue(disk, ra, &ra->buf[i]);
+	}
+
+	while (count && b->count) {
+		while (!b->done)
+			;
+
+		if (b->token.TransactionStatus != EFI_SUCCESS) {
+			dprintf("BlockIo2 read failed: 0x%x, read-ahead off\n",
+				b->token.TransactionStatus);
+			ra_free(ra);
+			priv->ra = NULL;
+			break;
+		}
+
+		n = min(count, b->lba + b->count - lba);
+		memcpy(buf, b->data + ((lba - b->lba) << disk->sector_shift),
+		       n << disk->sector_shift);
+		buf += n << disk->sector_shift;
+		lba += n;
+		count -= n;
+		done += n;
+
+		if (lba == b->lba + b->count) {
+			/* All used; on to the next chunk */
+			ra_issue(disk, ra, b);
+			ra->head = (ra->head + 1) % EFI_RA_BUFS;
+			b = &ra->buf[ra->head];
+		}
+	}
+
+	return done;
+}
+
 static int efi_rdwr_sectors(struct disk *disk, void *buf,
 			    sector_t lba, size_t count, bool is_write)
 {
 	struct efi_disk_private *priv = (struct efi_disk_private *)disk->private;
+	struct efi_readahead *ra = priv->ra;
 	EFI_BLOCK_IO *bio = priv->bio;
 	EFI_STATUS status;
-	UINTN bytes = count * disk->sector_size;
+	size_t total = count;
+	size_t done;
+	UINTN bytes;
+
+	disk->io_calls++;
+
+	if (ra) {
+		if (is_write) {
+			ra_reset(ra);
+			ra->next = -1;
+		} else if (lba == ra->next) {
+			done = ra_read(disk, buf, lba, count);
+			disk->io_sectors += done;
+			buf = (char *)buf + (done << disk->sector_shift);
+			lba += done;
+			count -= done;
+			if (priv->ra)	/* Not if ra_read() gave up on it */
+				ra->next = lba;
+		} else {
+			ra->next = lba + count;
+		}
+	}
+
+	if (!count)
+		return total;
+
+	bytes = count * disk->sector_size;
 
 	if (is_write)
 		status = write_blocks(bio, disk->disk_number, lba, bytes, buf);
 	else
 		status = read_blocks(bio, disk->disk_number, lba, bytes, buf);
 
-	if (status != EFI_SUCCESS)
+	if (status != EFI_SUCCESS) {
 		Print(L"Failed to %s blocks: 0x%x\n",
 			is_write ? L"write" : L"read",
 			status);
+		disk->io_errors++;
+		return total - count;
+	}
 
-	return count << disk->sector_shift;
+	disk->io_sectors += count;
+	return total;
+}
+
+/*
+ * Set up read-ahead if the device has BlockIo2
+ */
+static void efi_ra_init(struct disk *disk, struct efi_disk_private *priv)
+{
+	struct efi_readahead *ra;
+	struct efi_block_io2 *bio2;
+	EFI_STATUS status;
+	uintptr_t align;
+	char *mem;
+	int i;
+
+	status = uefi_call_wrapper(BS->HandleProtocol, 3, priv->dev_handle,
+				   &BlockIo2Protocol, (void **)&bio2);
+	if (status != EFI_SUCCESS)
+		return;
+
+	ra = zalloc(sizeof(*ra));
+	if (!ra)
+		return;
+
+	ra->chunk = EFI_RA_BYTES >> disk->sector_shift;
+	if (!ra->chunk)
+		ra->chunk = 1;
+
+	align = bio2->Media->IoAlign > 1 ? bio2->Media->IoAlign : 1;
+	ra->raw = malloc(EFI_RA_BUFS * (ra->chunk << disk->sector_shift) + align);
+	if (!ra->raw)
+		goto bail;
+	mem = (char *)(((uintptr_t)ra->raw + align - 1) & ~(align - 1));
+
+	for (i = 0; i < EFI_RA_BUFS; i++) {
+		ra->buf[i].data = mem + i * (ra->chunk << disk->sector_shift);
+		status = efi_setup_event(&ra->buf[i].token.Event,
+					 (EFI_EVENT_NOTIFY)ra_done,
+					 &ra->buf[i]);
+		if (status != EFI_SUCCESS) {
+			ra->buf[i].token.Event = NULL;	/* Nothing to close */
+			goto bail;
+		}
+	}
+
+	/* Nothing is read ahead until a read follows on from another */
+	ra->next = -1;
+
+	priv->bio2 = bio2;
+	priv->ra = ra;
+
+	dprintf("BlockIo2: %d reads of %u sectors ahead\n",
+		EFI_RA_BUFS, (unsigned int)ra->chunk);
+	return;
+
+bail:
+	ra_free(ra);
 }
 
 struct disk *efi_disk_init(void *private)
@@ -75,6 +331,8 @@ struct disk *efi_disk_init(void *private)
     priv->bio = bio;
     priv->dio = dio;
     disk.private = private;
+
+    efi_ra_init(&disk, priv);
 #if 0
 
     disk.part_start    = part_start;
@@ -29,10 +29,43 @@
 /* We should keep EFI_NOMAP_PRINT_COUNT at 10 to limit flooding the console */
 #define EFI_NOMAP_PRINT_COUNT	10
 
+/*
+ * Receive tokens kept posted on each UDP or TCP socket, so that the
+ * firmware always has somewhere to put the next datagram or segment
+ * while the last one is being dealt with.  Tokens complete in the
+ * order they were posted.
+ */
+#define EFI_RX_TOKENS		8
+#define EFI_TCP_RX_BUF		32768	/* Per TCP token; fits tftp_bytesleft */
+
+struct efi_rx_slot {
+    union {
+	EFI_UDP4_COMPLETION_TOKEN udp;
+	EFI_TCP4_IO_TOKEN tcp;
+    } token;
+    EFI_TCP4_RECEIVE_DATA rxdata;	/* TCP only */
+    volatile bool done;		/* Set by the completion event */
+};
+
+struct efi_rx_ring {
+    struct efi_rx_slot slot[EFI_RX_TOKENS];
+    unsigned int head;		/* Next slot to complete */
+    int held;			/* Slot the caller is reading, or -1 */
+    char *buf;			/* TCP receive buffers */
+};
+
+EFIAPI void efi_rx_done(EFI_EVENT ev, void *context);
+void efi_rx_tick(void);
+
+struct efi_block_io2;
+struct efi_readahead;
+
 struct efi_disk_private {
 	EFI_HANDLE dev_handle;
 	EFI_BLOCK_IO *bio;
 	EFI_DISK_IO *dio;
+	struct efi_block_io2 *bio2;	/* NULL if the device has none */
+	struct efi_readahead *ra;	/* Reads in flight on bio2 */
 };
 
 struct efi_binding {
@@ -53,6 +86,7 @@ enum heap;
 extern void *efi_malloc(size_t, enum heap, size_t);
 extern void *efi_realloc(void *, size_t);
 extern void efi_free(void *);
+extern void efi_mem_init(void);
 
 extern struct efi_binding *efi_create_binding(EFI_GUID *, EFI_GUID *);
 extern void efi_destroy_binding(struct efi_binding *, EFI_GUID *);
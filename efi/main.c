@@ -390,13 +390,11 @@ static struct syslinux_memscan efi_memscan = {
     .func = efi_scan_memory,
 };
 
-extern uint16_t *bios_free_mem;
 void efi_init(void)
 {
 	/* XXX timer */
-	*bios_free_mem = 0;
 	syslinux_memscan_add(&efi_memscan);
-	mem_init();
+	efi_mem_init();
 }
 
 char efi_getchar(char *hi)
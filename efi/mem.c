@@ -2,26 +2,93 @@
  * Copyright 2012-2014 Intel Corporation - All Rights Reserved
  */
 
+/*
+ * The core heap on EFI.  Memory is taken from the firmware in large
+ * page-granular arenas and handed out by the core/mem allocator, so
+ * that only arena growth costs a call into the firmware.  Arenas are
+ * never given back; they are EfiLoaderData and so never reported as
+ * free memory to whatever we load.
+ */
+
 #include <mem/malloc.h>
-#include <string.h>
+#include <minmax.h>
+#include <stdbool.h>
+#include <dprintf.h>
 #include "efi.h"
 
+#define EFI_ARENA_MIN	(1 << 20)	/* Size of the first arena */
+#define EFI_ARENA_MAX	(16 << 20)	/* Arenas stop doubling here */
+
+extern void *bios_malloc(size_t, enum heap, malloc_tag_t);
+extern void *bios_realloc(void *, size_t);
+extern void bios_free(void *);
+
+static size_t arena_size = EFI_ARENA_MIN;
+
+/*
+ * Add an arena with room for at least _size_ bytes to the heap.
+ */
+static bool efi_grow_heap(size_t size)
+{
+	struct free_arena_header *fp;
+	EFI_PHYSICAL_ADDRESS addr;
+	EFI_STATUS status;
+	UINTN pages;
+	size_t bytes;
+
+	/* The arena's own header, and the block's, must fit as well */
+	bytes = max(size + 4 * sizeof(struct arena_header), arena_size);
+	pages = (bytes + EFI_PAGE_SIZE - 1) / EFI_PAGE_SIZE;
+	bytes = pages * EFI_PAGE_SIZE;
+
+	status = uefi_call_wrapper(BS->AllocatePages, 4, AllocateAnyPages,
+				   EfiLoaderData, pages, &addr);
+	if (status != EFI_SUCCESS) {
+		dprintf("efi_grow_heap: %zu bytes: status %lx\n",
+			bytes, (unsigned long)status);
+		return false;
+	}
+
+	if (arena_size < EFI_ARENA_MAX)
+		arena_size <<= 1;
+
+	fp = (struct free_arena_header *)(uintptr_t)addr;
+	fp->a.attrs = ARENA_TYPE_USED | (HEAP_MAIN << ARENA_HEAP_POS);
+#ifdef DEBUG_MALLOC
+	fp->a.magic = ARENA_MAGIC;
+#endif
+	ARENA_SIZE_SET(fp->a.attrs, bytes);
+	__inject_free_block(fp);
+
+	return true;
+}
+
+/*
+ * There is no low memory heap here; everything comes from the main one.
+ */
 void *efi_malloc(size_t size, enum heap heap, malloc_tag_t tag)
 {
-	return AllocatePool(size);
+	void *p;
+
+	p = bios_malloc(size, HEAP_MAIN, tag);
+	if (!p && size && efi_grow_heap(size))
+		p = bios_malloc(size, HEAP_MAIN, tag);
+
+	return p;
 }
 
 void *efi_realloc(void *ptr, size_t size)
 {
-	void *newptr;
-
-	newptr = AllocatePool(size);
-	memcpy(newptr, ptr, size);
-	FreePool(ptr);
-	return newptr;
+	return bios_realloc(ptr, size);
 }
 
 void efi_free(void *ptr)
 {
-	FreePool(ptr);
+	bios_free(ptr);
+}
+
+void efi_mem_init(void)
+{
+	__init_malloc_heads();
+	efi_grow_heap(0);
 }
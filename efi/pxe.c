@@ -23,28 +23,65 @@ void net_core_init(void)
     http_bake_cookies();
 }
 
-void pxe_init_isr(void) {}
-void gpxe_init(void) {}
-void pxe_idle_init(void) {}
+struct pxe_rx_stats pxe_rx_stats, pxe_rx_rate;
 
-int reset_pxe(void)
+/*
+ * The completion event of a posted receive token
+ */
+EFIAPI void efi_rx_done(EFI_EVENT ev, void *context)
 {
-    return 0;
+    struct efi_rx_slot *slot = context;
+
+    (void)ev;
+
+    slot->done = true;
 }
 
-#define DNS_MAX_SERVERS 4		/* Max no of DNS servers */
-uint32_t dns_server[DNS_MAX_SERVERS] = {0, };
+/*
+ * Roll the receive counters over into pxe_rx_rate once a second;
+ * called while waiting on the network.
+ */
+void efi_rx_tick(void)
+{
+    static struct pxe_rx_stats last;
+    static mstime_t last_ms;
+    mstime_t now = ms_timer();
+
+    if (now - last_ms < 1000)
+	return;
+    last_ms = now;
+
+    pxe_rx_rate.packets = pxe_rx_stats.packets - last.packets;
+    pxe_rx_rate.bytes   = pxe_rx_stats.bytes - last.bytes;
+    pxe_rx_rate.thunks  = pxe_rx_stats.thunks - last.thunks;
+    pxe_rx_rate.drops   = pxe_rx_stats.drops - last.drops;
+    pxe_rx_rate.polls   = pxe_rx_stats.polls - last.polls;
+    last = pxe_rx_stats;
+
+    if (pxe_rx_rate.packets)
+	dprintf("EFI rx/s: %u packets, %u bytes, %u polls, %u drops, "
+		"%u found\n",
+		pxe_rx_rate.packets, pxe_rx_rate.bytes, pxe_rx_rate.thunks,
+		pxe_rx_rate.drops, pxe_rx_rate.polls);
+}
 
-__export uint32_t pxe_dns(const char *name)
+/**
+ * Run func on each of args concurrently
+ *
+ * @out: -1, as there are no threads to run them on; nothing is run.
+ */
+int net_core_parallel(void (*func)(void *) __unused, void **args __unused,
+		      int count __unused)
 {
-    /*
-     * Return failure on an empty input... this can happen during
-     * some types of URL parsing, and this is the easiest place to
-     * check for it.
-     */
-    if (!name || !*name)
-	return 0;
+    return -1;
+}
 
+void pxe_init_isr(void) {}
+void gpxe_init(void) {}
+void pxe_idle_init(void) {}
+
+int reset_pxe(void)
+{
     return 0;
 }
 
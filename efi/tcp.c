@@ -173,6 +173,87 @@ out:
     return rv;
 }
 
+/*
+ * Post a slot's receive token, into the slot's own buffer.  A token
+ * the firmware won't take is marked done with the error, so that it
+ * is seen in its turn.
+ */
+static void tcp_rx_post(EFI_TCP4 *tcp, struct efi_rx_ring *ring, int i)
+{
+    struct efi_rx_slot *slot = &ring->slot[i];
+    EFI_TCP4_FRAGMENT_DATA *frag = &slot->rxdata.FragmentTable[0];
+    EFI_STATUS status;
+
+    slot->done = false;
+    slot->rxdata.UrgentFlag = FALSE;
+    slot->rxdata.DataLength = EFI_TCP_RX_BUF;
+    slot->rxdata.FragmentCount = 1;
+    frag->FragmentLength = EFI_TCP_RX_BUF;
+    frag->FragmentBuffer = ring->buf + i * EFI_TCP_RX_BUF;
+    slot->token.tcp.Packet.RxData = &slot->rxdata;
+
+    status = uefi_call_wrapper(tcp->Receive, 2, tcp, &slot->token.tcp);
+    if (status != EFI_SUCCESS) {
+	slot->token.tcp.CompletionToken.Status = status;
+	slot->done = true;
+    }
+}
+
+static void tcp_rx_free(struct efi_rx_ring *ring)
+{
+    int i;
+
+    for (i = 0; i < EFI_RX_TOKENS; i++) {
+	if (ring->slot[i].token.tcp.CompletionToken.Event)
+	    uefi_call_wrapper(BS->CloseEvent, 1,
+			      ring->slot[i].token.tcp.CompletionToken.Event);
+    }
+
+    free(ring->buf);
+    free(ring);
+}
+
+/*
+ * Post the connection's receive tokens, if they aren't already
+ */
+static struct efi_rx_ring *tcp_rx_start(struct pxe_pvt_inode *socket)
+{
+    struct efi_rx_ring *ring = socket->net.efi.rx;
+    EFI_TCP4 *tcp = (EFI_TCP4 *)socket->net.efi.binding->this;
+    EFI_STATUS status;
+    int i;
+
+    if (ring)
+	return ring;
+
+    ring = zalloc(sizeof(*ring));
+    if (!ring)
+	return NULL;
+
+    ring->buf = malloc(EFI_RX_TOKENS * EFI_TCP_RX_BUF);
+    if (!ring->buf)
+	goto bail;
+
+    for (i = 0; i < EFI_RX_TOKENS; i++) {
+	status = efi_setup_event(&ring->slot[i].token.tcp.CompletionToken.Event,
+				 (EFI_EVENT_NOTIFY)efi_rx_done,
+				 &ring->slot[i]);
+	if (status != EFI_SUCCESS)
+	    goto bail;
+    }
+
+    for (i = 0; i < EFI_RX_TOKENS; i++)
+	tcp_rx_post(tcp, ring, i);
+
+    ring->held = -1;
+    socket->net.efi.rx = ring;
+    return ring;
+
+bail:
+    tcp_rx_free(ring);
+    return NULL;
+}
+
 void core_tcp_close_file(struct inode *inode)
 {
     struct pxe_pvt_inode *socket = PVT(inode);
@@ -197,60 +278,68 @@ void core_tcp_close_file(struct inode *inode)
 
     efi_destroy_binding(b, &Tcp4ServiceBindingProtocol);
     socket->net.efi.binding = NULL;
-}
 
-static char databuf[8192];
+    /* Destroying the child has aborted any tokens still posted */
+    if (socket->net.efi.rx) {
+	tcp_rx_free(socket->net.efi.rx);
+	socket->net.efi.rx = NULL;
+    }
+}
 
 void core_tcp_fill_buffer(struct inode *inode)
 {
     struct pxe_pvt_inode *socket = PVT(inode);
     struct efi_binding *b = socket->net.efi.binding;
-    EFI_TCP4_IO_TOKEN iotoken;
-    EFI_TCP4_RECEIVE_DATA rxdata;
-    EFI_TCP4_FRAGMENT_DATA *frag;
-    EFI_STATUS status;
     EFI_TCP4 *tcp = (EFI_TCP4 *)b->this;
-    void *data;
+    EFI_TCP4_FRAGMENT_DATA *frag;
+    struct efi_rx_ring *ring;
+    struct efi_rx_slot *slot;
+    mstime_t t0;
     size_t len;
 
-    memset(&iotoken, 0, sizeof(iotoken));
-    memset(&rxdata, 0, sizeof(rxdata));
+    ring = tcp_rx_start(socket);
+    if (!ring)
+	goto eof;
 
-    status = efi_setup_event(&iotoken.CompletionToken.Event,
-		      (EFI_EVENT_NOTIFY)tcp_cb, &iotoken.CompletionToken);
-    if (status != EFI_SUCCESS)
-	return;
-
-    iotoken.Packet.RxData = &rxdata;
-    rxdata.FragmentCount = 1;
-    rxdata.DataLength = sizeof(databuf);
-    frag = &rxdata.FragmentTable[0];
-    frag->FragmentBuffer = databuf;
-    frag->FragmentLength = sizeof(databuf);
-
-    status = uefi_call_wrapper(tcp->Receive, 2, tcp, &iotoken);
-    if (status == EFI_CONNECTION_FIN) {
-	socket->tftp_goteof = 1;
-	if (inode->size == (uint64_t)-1)
-	    inode->size = socket->tftp_filepos;
-	socket->ops->close(inode);
-	goto out;
+    /* The caller is done with the last buffer; it can go back */
+    if (ring->held >= 0) {
+	tcp_rx_post(tcp, ring, ring->held);
+	ring->held = -1;
     }
 
-    while (cb_status == -1)
+    slot = &ring->slot[ring->head];
+    t0 = ms_timer();
+    while (!slot->done) {
 	uefi_call_wrapper(tcp->Poll, 1, tcp);
+	pxe_rx_stats.thunks++;
+	if (slot->done)
+	    pxe_rx_stats.polls++;
+	efi_rx_tick();
+    }
+    net_iostat.tcp_stall_ms += ms_timer() - t0;
 
-    /* Reset */
-    cb_status = -1;
+    /* EFI_CONNECTION_FIN, or the connection has failed */
+    if (slot->token.tcp.CompletionToken.Status != EFI_SUCCESS)
+	goto eof;
 
+    frag = &slot->rxdata.FragmentTable[0];
     len = frag->FragmentLength;
-    memcpy(databuf, frag->FragmentBuffer, len);
-    data = databuf;
 
-    socket->tftp_dataptr = data;
+    pxe_rx_stats.packets++;
+    pxe_rx_stats.bytes += len;
+    net_iostat.tcp_bytes += len;
+
+    ring->held = ring->head;
+    ring->head = (ring->head + 1) % EFI_RX_TOKENS;
+
+    socket->tftp_dataptr = frag->FragmentBuffer;
     socket->tftp_filepos += len;
     socket->tftp_bytesleft = len;
+    return;
 
-out:
-    uefi_call_wrapper(BS->CloseEvent, 1, iotoken.CompletionToken.Event);
+eof:
+    socket->tftp_goteof = 1;
+    if (inode->size == (uint64_t)-1)
+	inode->size = socket->tftp_filepos;
+    socket->ops->close(inode);
 }
@@ -103,6 +103,106 @@ bail:
     return -1;
 }
 
+/**
+ * Open a socket receiving from a multicast group
+ *
+ * @param:socket, the socket to open
+ * @param:group, the multicast group address
+ * @param:port, the port number to receive on, host-byte order
+ *
+ * @out: error code, 0 on success, -1 on failure
+ *
+ * Multicast reception is not supported by the EFI UDP binding; callers fall back to unicast.
+ */
+int core_udp_open_group(struct pxe_pvt_inode *socket __unused,
+			uint32_t group __unused, uint16_t port __unused)
+{
+    return -1;
+}
+
+/*
+ * Post a slot's receive token.  A token the firmware won't take is
+ * marked done with the error, so that it is seen in its turn.
+ */
+static void udp_rx_post(EFI_UDP4 *udp, struct efi_rx_slot *slot)
+{
+    EFI_STATUS status;
+
+    slot->done = false;
+    slot->token.udp.Packet.RxData = NULL;
+
+    status = uefi_call_wrapper(udp->Receive, 2, udp, &slot->token.udp);
+    if (status != EFI_SUCCESS) {
+	slot->token.udp.Status = status;
+	slot->done = true;
+    }
+}
+
+/*
+ * Post the socket's receive tokens, if they aren't already
+ */
+static struct efi_rx_ring *udp_rx_start(struct pxe_pvt_inode *socket)
+{
+    struct efi_rx_ring *ring = socket->net.efi.rx;
+    EFI_UDP4 *udp = (EFI_UDP4 *)socket->net.efi.binding->this;
+    EFI_STATUS status;
+    int i;
+
+    if (ring)
+	return ring;
+
+    ring = zalloc(sizeof(*ring));
+    if (!ring)
+	return NULL;
+
+    for (i = 0; i < EFI_RX_TOKENS; i++) {
+	status = efi_setup_event(&ring->slot[i].token.udp.Event,
+				 (EFI_EVENT_NOTIFY)efi_rx_done,
+				 &ring->slot[i]);
+	if (status != EFI_SUCCESS) {
+	    while (i--)
+		uefi_call_wrapper(BS->CloseEvent, 1,
+				  ring->slot[i].token.udp.Event);
+	    free(ring);
+	    return NULL;
+	}
+    }
+
+    for (i = 0; i < EFI_RX_TOKENS; i++)
+	udp_rx_post(udp, &ring->slot[i]);
+
+    ring->held = -1;
+    socket->net.efi.rx = ring;
+    return ring;
+}
+
+/*
+ * Take back the socket's receive tokens, before it is reconfigured
+ * or closed.  Datagrams received and not read are dropped.
+ */
+static void udp_rx_stop(struct pxe_pvt_inode *socket)
+{
+    struct efi_rx_ring *ring = socket->net.efi.rx;
+    EFI_UDP4 *udp = (EFI_UDP4 *)socket->net.efi.binding->this;
+    EFI_UDP4_RECEIVE_DATA *rxdata;
+    int i;
+
+    if (!ring)
+	return;
+
+    uefi_call_wrapper(udp->Cancel, 2, udp, NULL);
+
+    for (i = 0; i < EFI_RX_TOKENS; i++) {
+	rxdata = ring->slot[i].token.udp.Packet.RxData;
+	if (ring->slot[i].done && rxdata)
+	    uefi_call_wrapper(BS->SignalEvent, 1, rxdata->RecycleSignal);
+	uefi_call_wrapper(BS->CloseEvent, 1, ring->slot[i].token.udp.Event);
+    }
+
+    free(ring);
+    socket->net.efi.rx = NULL;
+}
+
 /**
  * Close a socket
  *
@@ -113,6 +213,7 @@ void core_udp_close(struct pxe_pvt_inode *socket)
     if (!socket->net.efi.binding)
 	return;
 
+    udp_rx_stop(socket);
     efi_destroy_binding(socket->net.efi.binding, &Udp4ServiceBindingProtocol);
     socket->net.efi.binding = NULL;
 }
@@ -132,6 +233,7 @@ void core_udp_connect(struct pxe_pvt_inode *socket, uint32_t ip,
     EFI_UDP4 *udp;
 
     udp = (EFI_UDP4 *)socket->net.efi.binding->this;
+    udp_rx_stop(socket);
 
     memset(&udata, 0, sizeof(udata));
 
@@ -173,6 +275,7 @@ void core_udp_disconnect(struct pxe_pvt_inode *socket)
     EFI_UDP4 *udp;
 
     udp = (EFI_UDP4 *)socket->net.efi.binding->this;
+    udp_rx_stop(socket);
 
     /* Reset */
     status = uefi_call_wrapper(udp->Configure, 2, udp, NULL);
@@ -207,62 +310,53 @@ static EFIAPI void udp4_cb(EFI_EVENT event, void *context)
 int core_udp_recv(struct pxe_pvt_inode *socket, void *buf, uint16_t *buf_len,
 		  uint32_t *src_ip, uint16_t *src_port)
 {
-    EFI_UDP4_COMPLETION_TOKEN token;
     EFI_UDP4_FRAGMENT_DATA *frag;
     EFI_UDP4_RECEIVE_DATA *rxdata;
-    struct efi_binding *b;
-    EFI_STATUS status;
+    struct efi_rx_ring *ring;
+    struct efi_rx_slot *slot;
     EFI_UDP4 *udp;
     size_t size;
-    int rv = -1;
     jiffies_t start;
 
-    (void)socket;
-
-    b = socket->net.efi.binding;
-    udp = (EFI_UDP4 *)b->this;
-    memset(&token, 0, sizeof(token));
+    udp = (EFI_UDP4 *)socket->net.efi.binding->this;
 
-    status = efi_setup_event(&token.Event, (EFI_EVENT_NOTIFY)udp4_cb,
-			     &token);
-    if (status != EFI_SUCCESS)
+    ring = udp_rx_start(socket);
+    if (!ring)
 	return -1;
 
-    status = uefi_call_wrapper(udp->Receive, 2, udp, &token);
-    if (status != EFI_SUCCESS)
-	goto bail;
+    slot = &ring->slot[ring->head];
 
     start = jiffies();
-    while (cb_status == -1) {
-	/* 15ms receive timeout... */
+    while (!slot->done) {
+	/* 15ms receive timeout; the token stays posted for next time */
 	if (jiffies() - start >= 15) {
-	    if (jiffies() - start >= 30)
-		dprintf("Failed to cancel UDP\n");
-
-	    uefi_call_wrapper(udp->Cancel, 2, udp, &token);
 	    dprintf("core_udp_recv: timed out\n");
 	    if (!efi_udp_has_recv && (efi_net_def_addr == 1)) {
 		efi_net_def_addr = 0;
 		Print(L"disable UseDefaultAddress\n");
 	    }
+	    return -1;
 	}
 
 	uefi_call_wrapper(udp->Poll, 1, udp);
+	pxe_rx_stats.thunks++;
+	if (slot->done)
+	    pxe_rx_stats.polls++;
+	efi_rx_tick();
     }
 
-    if (cb_status == 0)
-	rv = 0;
+    ring->head = (ring->head + 1) % EFI_RX_TOKENS;
 
-    /* Reset */
-    cb_status = -1;
-
-    if (rv)
-	goto bail;
+    if (slot->token.udp.Status != EFI_SUCCESS) {
+	pxe_rx_stats.drops++;
+	udp_rx_post(udp, slot);
+	return -1;
+    }
 
     if (!efi_udp_has_recv)
 	efi_udp_has_recv = 1;
 
-    rxdata = token.Packet.RxData;
+    rxdata = slot->token.udp.Packet.RxData;
     frag = &rxdata->FragmentTable[0];
 
     size = min(frag->FragmentLength, *buf_len);
@@ -272,11 +366,13 @@ int core_udp_recv(struct pxe_pvt_inode *socket, void *buf, uint16_t *buf_len,
     memcpy(src_port, &rxdata->UdpSession.SourcePort, sizeof(*src_port));
     memcpy(src_ip, &rxdata->UdpSession.SourceAddress, sizeof(*src_ip));
 
+    pxe_rx_stats.packets++;
+    pxe_rx_stats.bytes += rxdata->DataLength;
+
     uefi_call_wrapper(BS->SignalEvent, 1, rxdata->RecycleSignal);
+    udp_rx_post(udp, slot);
 
-bail:
-    uefi_call_wrapper(BS->CloseEvent, 1, token.Event);
-    return rv;
+    return 0;
 }
 
 /**
@@ -13,53 +13,174 @@
 /*
  * cache.c
  *
- * Simple sector cache
+ * Sector cache: at most LIBFAT_CACHE_SECTORS sectors, hashed by sector
+ * number and reused least recently used first.  A miss reads ahead up
+ * to LIBFAT_READAHEAD sectors in one call, since FAT, directory and
+ * file data are mostly walked in order.
+ *
+ * The sectors returned by the last few calls stay valid; older ones
+ * may have been reused.
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "libfatint.h"
 
-void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n)
+static inline struct libfat_sector **hash_bucket(struct libfat_filesystem *fs,
+						 libfat_sector_t n)
+{
+    return &fs->hash[n & (LIBFAT_HASH_SIZE - 1)];
+}
+
+static struct libfat_sector *lookup(struct libfat_filesystem *fs,
+				    libfat_sector_t n)
 {
     struct libfat_sector *ls;
 
-    for (ls = fs->sectors; ls; ls = ls->next) {
+    for (ls = *hash_bucket(fs, n); ls; ls = ls->next) {
 	if (ls->n == n)
-	    return ls->data;	/* Found in cache */
+	    return ls;
     }
+    return NULL;
+}
+
+static void lru_unlink(struct libfat_filesystem *fs, struct libfat_sector *ls)
+{
+    if (ls->prev_lru)
+	ls->prev_lru->next_lru = ls->next_lru;
+    else
+	fs->lru = ls->next_lru;
 
-    /* Not found in cache */
-    ls = malloc(sizeof(struct libfat_sector));
-    if (!ls) {
-	libfat_flush(fs);
+    if (ls->next_lru)
+	ls->next_lru->prev_lru = ls->prev_lru;
+    else
+	fs->lru_tail = ls->prev_lru;
+}
+
+static void lru_push(struct libfat_filesystem *fs, struct libfat_sector *ls)
+{
+    ls->prev_lru = NULL;
+    ls->next_lru = fs->lru;
+    if (fs->lru)
+	fs->lru->prev_lru = ls;
+    else
+	fs->lru_tail = ls;
+    fs->lru = ls;
+}
+
+/* A free sector buffer: a new one while within budget, else the oldest */
+static struct libfat_sector *get_buffer(struct libfat_filesystem *fs)
+{
+    struct libfat_sector *ls, **lsp;
+
+    if (fs->nsectors < LIBFAT_CACHE_SECTORS) {
 	ls = malloc(sizeof(struct libfat_sector));
+	if (ls) {
+	    fs->nsectors++;
+	    return ls;
+	}
+    }
+
+    ls = fs->lru_tail;
+    if (!ls)
+	return NULL;		/* Can't allocate memory */
 
-	if (!ls)
-	    return NULL;	/* Can't allocate memory */
+    lru_unlink(fs, ls);
+    for (lsp = hash_bucket(fs, ls->n); *lsp != ls; lsp = &(*lsp)->next)
+	;
+    *lsp = ls->next;
+
+    return ls;
+}
+
+static void put_buffer(struct libfat_filesystem *fs, struct libfat_sector *ls)
+{
+    free(ls);
+    fs->nsectors--;
+}
+
+void *libfat_get_sector(struct libfat_filesystem *fs, libfat_sector_t n)
+{
+    struct libfat_sector *batch[LIBFAT_READAHEAD];
+    struct libfat_sector *ls, **lsp;
+    unsigned int count, i;
+    size_t bytes;
+    char *buf;
+
+    ls = lookup(fs, n);
+    if (ls) {
+	if (ls != fs->lru) {
+	    lru_unlink(fs, ls);
+	    lru_push(fs, ls);
+	}
+	return ls->data;	/* Found in cache */
     }
 
-    if (fs->read(fs->readptr, ls->data, LIBFAT_SECTOR_SIZE, n)
-	!= LIBFAT_SECTOR_SIZE) {
-	free(ls);
+    /*
+     * Not found in cache: read ahead up to the next cached sector or
+     * the end of the filesystem, which isn't known until it's open.
+     */
+    count = 1;
+    while (count < LIBFAT_READAHEAD && n + count < fs->end &&
+	   !lookup(fs, n + count))
+	count++;
+
+    for (i = 0; i < count; i++) {
+	batch[i] = get_buffer(fs);
+	if (!batch[i])
+	    break;
+    }
+    count = i;
+    if (!count)
+	return NULL;		/* Can't allocate memory */
+
+    buf = NULL;
+    if (count > 1) {
+	buf = malloc(count << LIBFAT_SECTOR_SHIFT);
+	if (!buf) {
+	    while (count > 1)
+		put_buffer(fs, batch[--count]);
+	}
+    }
+
+    bytes = count << LIBFAT_SECTOR_SHIFT;
+    if (fs->read(fs->readptr, buf ? buf : batch[0]->data, bytes, n)
+	!= (int)bytes) {
+	free(buf);
+	for (i = 0; i < count; i++)
+	    put_buffer(fs, batch[i]);
 	return NULL;		/* I/O error */
     }
 
-    ls->n = n;
-    ls->next = fs->sectors;
-    fs->sectors = ls;
+    /* Backwards, so that sector n ends up the newest */
+    for (i = count; i--;) {
+	ls = batch[i];
+	if (buf)
+	    memcpy(ls->data, buf + (i << LIBFAT_SECTOR_SHIFT),
+		   LIBFAT_SECTOR_SIZE);
+
+	ls->n = n + i;
+	lsp = hash_bucket(fs, ls->n);
+	ls->next = *lsp;
+	*lsp = ls;
+	lru_push(fs, ls);
+    }
+    free(buf);
 
-    return ls->data;
+    return batch[0]->data;
 }
 
 void libfat_flush(struct libfat_filesystem *fs)
 {
     struct libfat_sector *ls, *lsnext;
 
-    lsnext = fs->sectors;
-    fs->sectors = NULL;
+    lsnext = fs->lru;
+    fs->lru = fs->lru_tail = NULL;
+    memset(fs->hash, 0, sizeof fs->hash);
+    fs->nsectors = 0;
 
     for (ls = lsnext; ls; ls = lsnext) {
-	lsnext = ls->next;
+	lsnext = ls->next_lru;
 	free(ls);
     }
 }
@@ -22,9 +22,15 @@
 #include "libfat.h"
 #include "fat.h"
 
+/* The sector cache: at most this many sectors, reused in LRU order */
+#define LIBFAT_CACHE_SECTORS	128
+#define LIBFAT_HASH_SIZE	64	/* Hash buckets, a power of 2 */
+#define LIBFAT_READAHEAD	8	/* Most sectors read in one go */
+
 struct libfat_sector {
     libfat_sector_t n;		/* Sector number */
-    struct libfat_sector *next;	/* Next in list */
+    struct libfat_sector *next;	/* Next in hash bucket */
+    struct libfat_sector *prev_lru, *next_lru;	/* Newest first */
     char data[LIBFAT_SECTOR_SIZE];
 };
 
@@ -49,7 +55,9 @@ struct libfat_filesystem {
     libfat_sector_t data;	/* Start of data area */
     libfat_sector_t end;	/* End of filesystem */
 
-    struct libfat_sector *sectors;
+    struct libfat_sector *hash[LIBFAT_HASH_SIZE];
+    struct libfat_sector *lru, *lru_tail;	/* Newest, oldest */
+    unsigned int nsectors;	/* Sectors allocated */
 };
 
 #endif /* LIBFATINT_H */
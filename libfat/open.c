@@ -18,6 +18,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "libfatint.h"
 #include "ulint.h"
 
@@ -35,7 +36,7 @@ libfat_open(int (*readfunc) (intptr_t, void *, size_t, libfat_sector_t),
     if (!fs)
 	goto barf;
 
-    fs->sectors = NULL;
+    memset(fs, 0, sizeof *fs);	/* fs->end = 0: no read-ahead yet */
     fs->read = readfunc;
     fs->readptr = readptr;
 
@@ -106,7 +107,7 @@ libfat_open(int (*readfunc) (intptr_t, void *, size_t, libfat_sector_t),
 
 barf:
     if (fs)
-	free(fs);
+	libfat_close(fs);
     return NULL;
 }
 
@@ -168,7 +168,7 @@ LIBLOAD_OBJS = \
 LIBMODULE_OBJS = \
 	sys/module/common.o sys/module/$(ARCH)/elf_module.o		\
 	sys/module/elfutils.o	\
-	sys/module/exec.o sys/module/elf_module.o
+	sys/module/exec.o sys/module/elf_module.o sys/module/bundle.o
 
 # ZIP library object files
 LIBZLIB_OBJS = \
@@ -198,6 +198,8 @@ CORELIBOBJS = \
 	sys/stdcon_write.o						\
 	syslinux/memscan.o strrchr.o strcat.o				\
 	syslinux/debug.o						\
+	zlib/adler32.o zlib/crc32.o zlib/zutil.o			\
+	zlib/inflate.o zlib/inftrees.o zlib/inffast.o			\
 	$(LIBGCC_OBJS) \
 	$(LIBENTRY_OBJS) \
 	$(LIBMODULE_OBJS)
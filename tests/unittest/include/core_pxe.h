@@ -0,0 +1 @@
+#include <../../../core/include/core_pxe.h>
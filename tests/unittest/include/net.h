@@ -0,0 +1 @@
+#include <../../../core/include/net.h>
@@ -0,0 +1 @@
+#include <../../../com32/include/syslinux/sysappend.h>